@@ -39,6 +39,11 @@
 #include "readwrite.h"
 #include "matrix.h"
 #include "emufile.h"
+#include "utils/task.h"
+
+#if defined(ENABLE_AVX2_DISPATCH) && defined(__GNUC__)
+	#include <cpuid.h>
+#endif
 
 #ifdef FASTBUILD
 	#undef FORCEINLINE
@@ -75,6 +80,13 @@ static CACHE_ALIGN size_t _gpuDstLineIndex[GPU_FRAMEBUFFER_NATIVE_HEIGHT];	// Ke
 static CACHE_ALIGN size_t _gpuCaptureLineCount[GPU_VRAM_BLOCK_LINES + 1];	// Key: Source line index / Value: Number of destination lines for the source line
 static CACHE_ALIGN size_t _gpuCaptureLineIndex[GPU_VRAM_BLOCK_LINES + 1];	// Key: Source line index / Value: First destination line that maps to the source line
 
+#ifdef ENABLE_AVX2_DISPATCH
+static bool _gpuHostHasAVX2 = false;	// Set by _gpuDetectHostSIMD(). Selects the AVX2 paths over the SSE2 ones.
+#endif
+#ifdef ENABLE_AVX512_DISPATCH
+static bool _gpuHostHasAVX512 = false;	// Set by _gpuDetectHostSIMD(). Selects the AVX-512 paths where they exist.
+#endif
+
 const CACHE_ALIGN SpriteSize GPUEngineBase::_sprSizeTab[4][4] = {
      {{8, 8}, {16, 8}, {8, 16}, {8, 8}},
      {{16, 16}, {32, 8}, {8, 32}, {8, 8}},
@@ -250,6 +262,45 @@ bool gpu_loadstate(EMUFILE* is, int size)
 /*****************************************************************************/
 //			INITIALIZATION
 /*****************************************************************************/
+static void _gpuDetectHostSIMD()
+{
+#ifdef ENABLE_AVX2_DISPATCH
+#if defined(__GNUC__)
+	unsigned int eax, ebx, ecx, edx;
+	
+	// The OS must have enabled OSXSAVE, and must be saving the XMM and YMM registers
+	// on context switches, before any AVX instruction can be used.
+	if ( !__get_cpuid(1, &eax, &ebx, &ecx, &edx) || ((ecx & (1 << 27)) == 0) || (__get_cpuid_max(0, NULL) < 7) )
+	{
+		return;
+	}
+	
+	unsigned int xcr0Lo, xcr0Hi;
+	__asm__ __volatile__ ("xgetbv" : "=a"(xcr0Lo), "=d"(xcr0Hi) : "c"(0));
+	if ((xcr0Lo & 0x06) != 0x06)
+	{
+		return;
+	}
+	
+	__cpuid_count(7, 0, eax, ebx, ecx, edx);
+	_gpuHostHasAVX2 = ((ebx & (1 << 5)) != 0);
+	
+#ifdef ENABLE_AVX512_DISPATCH
+	// AVX-512 additionally needs the opmask and ZMM register state (XCR0 bits 5-7),
+	// plus AVX512F and AVX512BW.
+	_gpuHostHasAVX512 = _gpuHostHasAVX2 && ((xcr0Lo & 0xE0) == 0xE0) && ((ebx & (1 << 16)) != 0) && ((ebx & (1 << 30)) != 0);
+#endif
+#else
+	// Without function-level targeting, these paths only exist when the whole build
+	// already requires them.
+	_gpuHostHasAVX2 = true;
+#ifdef ENABLE_AVX512_DISPATCH
+	_gpuHostHasAVX512 = true;
+#endif
+#endif
+#endif // ENABLE_AVX2_DISPATCH
+}
+
 void GPUEngineBase::_InitLUTs()
 {
 	static bool didInit = false;
@@ -1116,6 +1167,289 @@ FORCEINLINE __m128i GPUEngineBase::_ColorEffectBlend3D(const __m128i &colA_Lo, c
 
 #endif
 
+#ifdef ENABLE_AVX2_DISPATCH
+
+// The AVX2 compositor keeps its pixels in order across both 128-bit lanes of each
+// vector. The unpack instructions used by the SSE2 compositor work within each lane,
+// which would mix up the pixel order, so the 8-bit masks are sign-extended instead.
+static FUNCTARGET_AVX2 FORCEINLINE void _gpuExpandMask8To16_AVX2(const __m256i &mask8, __m256i *mask16)
+{
+	mask16[0] = _mm256_cvtepi8_epi16( _mm256_castsi256_si128(mask8) );
+	mask16[1] = _mm256_cvtepi8_epi16( _mm256_extracti128_si256(mask8, 1) );
+}
+
+static FUNCTARGET_AVX2 FORCEINLINE void _gpuExpandMask8To32_AVX2(const __m256i &mask8, __m256i *mask32)
+{
+	const __m128i maskLo = _mm256_castsi256_si128(mask8);
+	const __m128i maskHi = _mm256_extracti128_si256(mask8, 1);
+	
+	mask32[0] = _mm256_cvtepi8_epi32(maskLo);
+	mask32[1] = _mm256_cvtepi8_epi32( _mm_srli_si128(maskLo, 8) );
+	mask32[2] = _mm256_cvtepi8_epi32(maskHi);
+	mask32[3] = _mm256_cvtepi8_epi32( _mm_srli_si128(maskHi, 8) );
+}
+
+// Converts 8 RGB555 colors to opaque RGB666 or RGB888, in pixel order.
+template <NDSColorFormat OUTPUTFORMAT>
+static FUNCTARGET_AVX2 FORCEINLINE __m256i _gpuConvertColor555To32Opaque_AVX2(const __m128i &src16)
+{
+	const __m256i src32 = _mm256_cvtepu16_epi32(src16);
+	__m256i dst;
+	
+	if (OUTPUTFORMAT == NDSColorFormat_BGR666_Rev)
+	{
+		dst = _mm256_and_si256( _mm256_or_si256(_mm256_slli_epi32(src32, 1), _mm256_slli_epi32(src32, 7)), _mm256_set1_epi32(0x003E003E) );
+		dst = _mm256_or_si256( dst, _mm256_and_si256(_mm256_slli_epi32(src32, 4), _mm256_set1_epi32(0x00003E00)) );
+		dst = _mm256_or_si256( dst, _mm256_and_si256(_mm256_srli_epi32(dst, 5), _mm256_set1_epi32(0x00010101)) );
+		dst = _mm256_or_si256( dst, _mm256_set1_epi32(0x1F000000) );
+	}
+	else
+	{
+		dst = _mm256_and_si256( _mm256_or_si256(_mm256_slli_epi32(src32, 3), _mm256_slli_epi32(src32, 9)), _mm256_set1_epi32(0x00F800F8) );
+		dst = _mm256_or_si256( dst, _mm256_and_si256(_mm256_slli_epi32(src32, 6), _mm256_set1_epi32(0x0000F800)) );
+		dst = _mm256_or_si256( dst, _mm256_and_si256(_mm256_srli_epi32(dst, 5), _mm256_set1_epi32(0x00070707)) );
+		dst = _mm256_or_si256( dst, _mm256_set1_epi32(0xFF000000) );
+	}
+	
+	return dst;
+}
+
+template <NDSColorFormat COLORFORMAT>
+FUNCTARGET_AVX2 FORCEINLINE __m256i GPUEngineBase::_ColorEffectBlend(const __m256i &colA, const __m256i &colB, const __m256i &blendEVA, const __m256i &blendEVB)
+{
+	const __m256i blendAB = _mm256_or_si256(blendEVA, _mm256_slli_epi16(blendEVB, 8));
+	
+	if (COLORFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		const __m256i colorBitMask = _mm256_set1_epi16(0x001F);
+		
+		__m256i ra = _mm256_or_si256( _mm256_and_si256(                  colA,      colorBitMask), _mm256_and_si256(_mm256_slli_epi16(colB, 8), _mm256_set1_epi16(0x1F00)) );
+		__m256i ga = _mm256_or_si256( _mm256_and_si256(_mm256_srli_epi16(colA,  5), colorBitMask), _mm256_and_si256(_mm256_slli_epi16(colB, 3), _mm256_set1_epi16(0x1F00)) );
+		__m256i ba = _mm256_or_si256( _mm256_and_si256(_mm256_srli_epi16(colA, 10), colorBitMask), _mm256_and_si256(_mm256_srli_epi16(colB, 2), _mm256_set1_epi16(0x1F00)) );
+		
+		ra = _mm256_srli_epi16( _mm256_maddubs_epi16(ra, blendAB), 4 );
+		ga = _mm256_srli_epi16( _mm256_maddubs_epi16(ga, blendAB), 4 );
+		ba = _mm256_srli_epi16( _mm256_maddubs_epi16(ba, blendAB), 4 );
+		
+		ra = _mm256_min_epi16(ra, colorBitMask);
+		ga = _mm256_min_epi16(ga, colorBitMask);
+		ba = _mm256_min_epi16(ba, colorBitMask);
+		
+		return _mm256_or_si256(ra, _mm256_or_si256( _mm256_slli_epi16(ga, 5), _mm256_slli_epi16(ba, 10)) );
+	}
+	else
+	{
+		// Like the brightness functions below, the unpacks and the pack all stay within
+		// each 128-bit lane, so the pixel order is preserved.
+		__m256i outColorLo = _mm256_maddubs_epi16( _mm256_unpacklo_epi8(colA, colB), blendAB );
+		__m256i outColorHi = _mm256_maddubs_epi16( _mm256_unpackhi_epi8(colA, colB), blendAB );
+		__m256i outColor = _mm256_packus_epi16( _mm256_srli_epi16(outColorLo, 4), _mm256_srli_epi16(outColorHi, 4) );
+		
+		if (COLORFORMAT == NDSColorFormat_BGR666_Rev)
+		{
+			outColor = _mm256_min_epu8(outColor, _mm256_set1_epi8(63));
+		}
+		
+		return _mm256_and_si256(outColor, _mm256_set1_epi32(0x00FFFFFF));
+	}
+}
+
+template <NDSColorFormat COLORFORMATB>
+FUNCTARGET_AVX2 FORCEINLINE __m256i GPUEngineBase::_ColorEffectBlend3D(const __m256i &colA_Lo, const __m256i &colA_Hi, const __m256i &colB)
+{
+	if (COLORFORMATB == NDSColorFormat_BGR555_Rev)
+	{
+		// If the color format of B is 555, then the colA_Hi parameter is required.
+		// The color format of A is assumed to be RGB666. The 32-bit to 16-bit packs
+		// work within each 128-bit lane, so the 64-bit blocks are put back in order.
+		__m256i ra = _mm256_packs_epi32( _mm256_and_si256(                  colA_Lo,      _mm256_set1_epi32(0x000000FF)), _mm256_and_si256(                  colA_Hi,      _mm256_set1_epi32(0x000000FF)) );
+		__m256i ga = _mm256_packs_epi32( _mm256_and_si256(_mm256_srli_epi32(colA_Lo,  8), _mm256_set1_epi32(0x000000FF)), _mm256_and_si256(_mm256_srli_epi32(colA_Hi,  8), _mm256_set1_epi32(0x000000FF)) );
+		__m256i ba = _mm256_packs_epi32( _mm256_and_si256(_mm256_srli_epi32(colA_Lo, 16), _mm256_set1_epi32(0x000000FF)), _mm256_and_si256(_mm256_srli_epi32(colA_Hi, 16), _mm256_set1_epi32(0x000000FF)) );
+		__m256i aa = _mm256_packs_epi32( _mm256_srli_epi32(colA_Lo, 24), _mm256_srli_epi32(colA_Hi, 24) );
+		
+		ra = _mm256_permute4x64_epi64(ra, 0xD8);
+		ga = _mm256_permute4x64_epi64(ga, 0xD8);
+		ba = _mm256_permute4x64_epi64(ba, 0xD8);
+		aa = _mm256_permute4x64_epi64(aa, 0xD8);
+		
+		ra = _mm256_or_si256( ra, _mm256_and_si256(_mm256_slli_epi16(colB, 9), _mm256_set1_epi16(0x3E00)) );
+		ga = _mm256_or_si256( ga, _mm256_and_si256(_mm256_slli_epi16(colB, 4), _mm256_set1_epi16(0x3E00)) );
+		ba = _mm256_or_si256( ba, _mm256_and_si256(_mm256_srli_epi16(colB, 1), _mm256_set1_epi16(0x3E00)) );
+		
+		aa = _mm256_adds_epu8(aa, _mm256_set1_epi16(1));
+		aa = _mm256_or_si256( aa, _mm256_slli_epi16(_mm256_subs_epu16(_mm256_set1_epi8(32), aa), 8) );
+		
+		ra = _mm256_srli_epi16( _mm256_maddubs_epi16(ra, aa), 6 );
+		ga = _mm256_srli_epi16( _mm256_maddubs_epi16(ga, aa), 6 );
+		ba = _mm256_srli_epi16( _mm256_maddubs_epi16(ba, aa), 6 );
+		
+		return _mm256_or_si256( _mm256_or_si256(ra, _mm256_slli_epi16(ga, 5)), _mm256_slli_epi16(ba, 10) );
+	}
+	else
+	{
+		// If the color format of B is 666 or 888, then the colA_Hi parameter is ignored.
+		// The color format of A is assumed to match the color format of B.
+		__m256i rgbALo;
+		__m256i rgbAHi;
+		
+		if (COLORFORMATB == NDSColorFormat_BGR666_Rev)
+		{
+			// pmaddubsw only works here for RGB666. See the SSE2 version for details.
+			rgbALo = _mm256_unpacklo_epi8(colA_Lo, colB);
+			rgbAHi = _mm256_unpackhi_epi8(colA_Lo, colB);
+			
+			__m256i alpha = _mm256_and_si256( _mm256_srli_epi32(colA_Lo, 24), _mm256_set1_epi32(0x0000001F) );
+			alpha = _mm256_or_si256( alpha, _mm256_or_si256(_mm256_slli_epi32(alpha, 8), _mm256_slli_epi32(alpha, 16)) );
+			alpha = _mm256_adds_epu8(alpha, _mm256_set1_epi8(1));
+			
+			const __m256i invAlpha = _mm256_subs_epu8(_mm256_set1_epi8(32), alpha);
+			
+			rgbALo = _mm256_maddubs_epi16( rgbALo, _mm256_unpacklo_epi8(alpha, invAlpha) );
+			rgbAHi = _mm256_maddubs_epi16( rgbAHi, _mm256_unpackhi_epi8(alpha, invAlpha) );
+			
+			rgbALo = _mm256_srli_epi16(rgbALo, 5);
+			rgbAHi = _mm256_srli_epi16(rgbAHi, 5);
+		}
+		else
+		{
+			rgbALo = _mm256_unpacklo_epi8(colA_Lo, _mm256_setzero_si256());
+			rgbAHi = _mm256_unpackhi_epi8(colA_Lo, _mm256_setzero_si256());
+			const __m256i rgbBLo = _mm256_unpacklo_epi8(colB, _mm256_setzero_si256());
+			const __m256i rgbBHi = _mm256_unpackhi_epi8(colB, _mm256_setzero_si256());
+			
+			__m256i alpha = _mm256_and_si256( _mm256_srli_epi32(colA_Lo, 24), _mm256_set1_epi32(0x000000FF) );
+			alpha = _mm256_or_si256( alpha, _mm256_or_si256(_mm256_slli_epi32(alpha, 8), _mm256_slli_epi32(alpha, 16)) );
+			
+			const __m256i alphaLo = _mm256_add_epi16( _mm256_unpacklo_epi8(alpha, _mm256_setzero_si256()), _mm256_set1_epi16(1) );
+			const __m256i alphaHi = _mm256_add_epi16( _mm256_unpackhi_epi8(alpha, _mm256_setzero_si256()), _mm256_set1_epi16(1) );
+			
+			rgbALo = _mm256_add_epi16( _mm256_mullo_epi16(rgbALo, alphaLo), _mm256_mullo_epi16(rgbBLo, _mm256_sub_epi16(_mm256_set1_epi16(256), alphaLo)) );
+			rgbAHi = _mm256_add_epi16( _mm256_mullo_epi16(rgbAHi, alphaHi), _mm256_mullo_epi16(rgbBHi, _mm256_sub_epi16(_mm256_set1_epi16(256), alphaHi)) );
+			
+			rgbALo = _mm256_srli_epi16(rgbALo, 8);
+			rgbAHi = _mm256_srli_epi16(rgbAHi, 8);
+		}
+		
+		return _mm256_and_si256( _mm256_packus_epi16(rgbALo, rgbAHi), _mm256_set1_epi32(0x00FFFFFF) );
+	}
+}
+
+template <NDSColorFormat COLORFORMAT>
+FUNCTARGET_AVX2 FORCEINLINE __m256i GPUEngineBase::_ColorEffectIncreaseBrightness(const __m256i &col, const __m256i &blendEVY)
+{
+	if (COLORFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		__m256i r_vec256 = _mm256_and_si256(                   col,      _mm256_set1_epi16(0x001F) );
+		__m256i g_vec256 = _mm256_and_si256( _mm256_srli_epi16(col,  5), _mm256_set1_epi16(0x001F) );
+		__m256i b_vec256 = _mm256_and_si256( _mm256_srli_epi16(col, 10), _mm256_set1_epi16(0x001F) );
+		
+		r_vec256 = _mm256_add_epi16( r_vec256, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16(31), r_vec256), blendEVY), 4) );
+		g_vec256 = _mm256_add_epi16( g_vec256, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16(31), g_vec256), blendEVY), 4) );
+		b_vec256 = _mm256_add_epi16( b_vec256, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16(31), b_vec256), blendEVY), 4) );
+		
+		return _mm256_or_si256(r_vec256, _mm256_or_si256( _mm256_slli_epi16(g_vec256, 5), _mm256_slli_epi16(b_vec256, 10)) );
+	}
+	else
+	{
+		// The unpack and pack instructions both work within each 128-bit lane, so the
+		// pixel order is preserved without any additional lane permutes.
+		__m256i rgbLo = _mm256_unpacklo_epi8(col, _mm256_setzero_si256());
+		__m256i rgbHi = _mm256_unpackhi_epi8(col, _mm256_setzero_si256());
+		
+		rgbLo = _mm256_add_epi16( rgbLo, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16((COLORFORMAT == NDSColorFormat_BGR666_Rev) ? 63 : 255), rgbLo), blendEVY), 4) );
+		rgbHi = _mm256_add_epi16( rgbHi, _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_sub_epi16(_mm256_set1_epi16((COLORFORMAT == NDSColorFormat_BGR666_Rev) ? 63 : 255), rgbHi), blendEVY), 4) );
+		
+		return _mm256_and_si256( _mm256_packus_epi16(rgbLo, rgbHi), _mm256_set1_epi32(0x00FFFFFF) );
+	}
+}
+
+template <NDSColorFormat COLORFORMAT>
+FUNCTARGET_AVX2 FORCEINLINE __m256i GPUEngineBase::_ColorEffectDecreaseBrightness(const __m256i &col, const __m256i &blendEVY)
+{
+	if (COLORFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		__m256i r_vec256 = _mm256_and_si256(                   col,      _mm256_set1_epi16(0x001F) );
+		__m256i g_vec256 = _mm256_and_si256( _mm256_srli_epi16(col,  5), _mm256_set1_epi16(0x001F) );
+		__m256i b_vec256 = _mm256_and_si256( _mm256_srli_epi16(col, 10), _mm256_set1_epi16(0x001F) );
+		
+		r_vec256 = _mm256_sub_epi16( r_vec256, _mm256_srli_epi16(_mm256_mullo_epi16(r_vec256, blendEVY), 4) );
+		g_vec256 = _mm256_sub_epi16( g_vec256, _mm256_srli_epi16(_mm256_mullo_epi16(g_vec256, blendEVY), 4) );
+		b_vec256 = _mm256_sub_epi16( b_vec256, _mm256_srli_epi16(_mm256_mullo_epi16(b_vec256, blendEVY), 4) );
+		
+		return _mm256_or_si256(r_vec256, _mm256_or_si256( _mm256_slli_epi16(g_vec256, 5), _mm256_slli_epi16(b_vec256, 10)) );
+	}
+	else
+	{
+		__m256i rgbLo = _mm256_unpacklo_epi8(col, _mm256_setzero_si256());
+		__m256i rgbHi = _mm256_unpackhi_epi8(col, _mm256_setzero_si256());
+		
+		rgbLo = _mm256_sub_epi16( rgbLo, _mm256_srli_epi16(_mm256_mullo_epi16(rgbLo, blendEVY), 4) );
+		rgbHi = _mm256_sub_epi16( rgbHi, _mm256_srli_epi16(_mm256_mullo_epi16(rgbHi, blendEVY), 4) );
+		
+		return _mm256_and_si256( _mm256_packus_epi16(rgbLo, rgbHi), _mm256_set1_epi32(0x00FFFFFF) );
+	}
+}
+
+#endif
+
+#ifdef ENABLE_AVX512_DISPATCH
+
+template <NDSColorFormat COLORFORMAT>
+FUNCTARGET_AVX512 FORCEINLINE __m512i GPUEngineBase::_ColorEffectIncreaseBrightness(const __m512i &col, const __m512i &blendEVY)
+{
+	if (COLORFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		__m512i r_vec512 = _mm512_and_si512(                   col,      _mm512_set1_epi16(0x001F) );
+		__m512i g_vec512 = _mm512_and_si512( _mm512_srli_epi16(col,  5), _mm512_set1_epi16(0x001F) );
+		__m512i b_vec512 = _mm512_and_si512( _mm512_srli_epi16(col, 10), _mm512_set1_epi16(0x001F) );
+		
+		r_vec512 = _mm512_add_epi16( r_vec512, _mm512_srli_epi16(_mm512_mullo_epi16(_mm512_sub_epi16(_mm512_set1_epi16(31), r_vec512), blendEVY), 4) );
+		g_vec512 = _mm512_add_epi16( g_vec512, _mm512_srli_epi16(_mm512_mullo_epi16(_mm512_sub_epi16(_mm512_set1_epi16(31), g_vec512), blendEVY), 4) );
+		b_vec512 = _mm512_add_epi16( b_vec512, _mm512_srli_epi16(_mm512_mullo_epi16(_mm512_sub_epi16(_mm512_set1_epi16(31), b_vec512), blendEVY), 4) );
+		
+		return _mm512_or_si512(r_vec512, _mm512_or_si512( _mm512_slli_epi16(g_vec512, 5), _mm512_slli_epi16(b_vec512, 10)) );
+	}
+	else
+	{
+		__m512i rgbLo = _mm512_unpacklo_epi8(col, _mm512_setzero_si512());
+		__m512i rgbHi = _mm512_unpackhi_epi8(col, _mm512_setzero_si512());
+		
+		rgbLo = _mm512_add_epi16( rgbLo, _mm512_srli_epi16(_mm512_mullo_epi16(_mm512_sub_epi16(_mm512_set1_epi16((COLORFORMAT == NDSColorFormat_BGR666_Rev) ? 63 : 255), rgbLo), blendEVY), 4) );
+		rgbHi = _mm512_add_epi16( rgbHi, _mm512_srli_epi16(_mm512_mullo_epi16(_mm512_sub_epi16(_mm512_set1_epi16((COLORFORMAT == NDSColorFormat_BGR666_Rev) ? 63 : 255), rgbHi), blendEVY), 4) );
+		
+		return _mm512_and_si512( _mm512_packus_epi16(rgbLo, rgbHi), _mm512_set1_epi32(0x00FFFFFF) );
+	}
+}
+
+template <NDSColorFormat COLORFORMAT>
+FUNCTARGET_AVX512 FORCEINLINE __m512i GPUEngineBase::_ColorEffectDecreaseBrightness(const __m512i &col, const __m512i &blendEVY)
+{
+	if (COLORFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		__m512i r_vec512 = _mm512_and_si512(                   col,      _mm512_set1_epi16(0x001F) );
+		__m512i g_vec512 = _mm512_and_si512( _mm512_srli_epi16(col,  5), _mm512_set1_epi16(0x001F) );
+		__m512i b_vec512 = _mm512_and_si512( _mm512_srli_epi16(col, 10), _mm512_set1_epi16(0x001F) );
+		
+		r_vec512 = _mm512_sub_epi16( r_vec512, _mm512_srli_epi16(_mm512_mullo_epi16(r_vec512, blendEVY), 4) );
+		g_vec512 = _mm512_sub_epi16( g_vec512, _mm512_srli_epi16(_mm512_mullo_epi16(g_vec512, blendEVY), 4) );
+		b_vec512 = _mm512_sub_epi16( b_vec512, _mm512_srli_epi16(_mm512_mullo_epi16(b_vec512, blendEVY), 4) );
+		
+		return _mm512_or_si512(r_vec512, _mm512_or_si512( _mm512_slli_epi16(g_vec512, 5), _mm512_slli_epi16(b_vec512, 10)) );
+	}
+	else
+	{
+		__m512i rgbLo = _mm512_unpacklo_epi8(col, _mm512_setzero_si512());
+		__m512i rgbHi = _mm512_unpackhi_epi8(col, _mm512_setzero_si512());
+		
+		rgbLo = _mm512_sub_epi16( rgbLo, _mm512_srli_epi16(_mm512_mullo_epi16(rgbLo, blendEVY), 4) );
+		rgbHi = _mm512_sub_epi16( rgbHi, _mm512_srli_epi16(_mm512_mullo_epi16(rgbHi, blendEVY), 4) );
+		
+		return _mm512_and_si512( _mm512_packus_epi16(rgbLo, rgbHi), _mm512_set1_epi32(0x00FFFFFF) );
+	}
+}
+
+#endif
+
 void GPUEngineBase::ParseReg_MASTER_BRIGHT()
 {
 	if (!nds.isInVblank())
@@ -1841,6 +2175,10 @@ FORCEINLINE void GPUEngineBase::_RenderPixel16_SSE2(GPUEngineCompositorInfo &com
 		passMask8 = _mm_and_si128(passMask8, didPassWindowTest);
 		passMask16[0] = _mm_unpacklo_epi8(passMask8, passMask8);
 		passMask16[1] = _mm_unpackhi_epi8(passMask8, passMask8);
+		passMask32[0] = _mm_unpacklo_epi16(passMask16[0], passMask16[0]);
+		passMask32[1] = _mm_unpackhi_epi16(passMask16[0], passMask16[0]);
+		passMask32[2] = _mm_unpacklo_epi16(passMask16[1], passMask16[1]);
+		passMask32[3] = _mm_unpackhi_epi16(passMask16[1], passMask16[1]);
 		
 		enableColorEffectMask = _mm_cmpeq_epi8( _mm_load_si128((__m128i *)(this->_enableColorEffectCustom[compInfo.renderState.selectedLayerID] + compInfo.target.xCustom)), _mm_set1_epi8(1) );
 	}
@@ -2016,6 +2354,162 @@ FORCEINLINE void GPUEngineBase::_RenderPixel16_SSE2(GPUEngineCompositorInfo &com
 
 #endif
 
+#ifdef ENABLE_AVX2_DISPATCH
+
+// AVX2 version of _RenderPixel16_SSE2(), for 32 pixels at a time. 16-bit colors are passed
+// in dst0-dst1 and src0-src1, 32-bit colors in dst0-dst3 and src0-src3, all in pixel order.
+// This is only used for BG layers at custom resolutions, so the OBJ handling is left out.
+template <NDSColorFormat OUTPUTFORMAT, bool ISDEBUGRENDER, bool WILLPERFORMWINDOWTEST, bool COLOREFFECTDISABLEDHINT>
+FUNCTARGET_AVX2 FORCEINLINE void GPUEngineBase::_RenderPixel32_AVX2(GPUEngineCompositorInfo &compInfo,
+																	const __m256i &src3, const __m256i &src2, const __m256i &src1, const __m256i &src0,
+																	const __m256i &srcEffectEnableMask,
+																	__m256i &dst3, __m256i &dst2, __m256i &dst1, __m256i &dst0,
+																	__m256i &dstLayerID,
+																	__m256i &passMask8)
+{
+	const __m256i srcLayerID_vec256 = _mm256_set1_epi8(compInfo.renderState.selectedLayerID);
+	__m256i enableColorEffectMask = _mm256_set1_epi8(0xFF);
+	
+	if (!ISDEBUGRENDER && WILLPERFORMWINDOWTEST)
+	{
+		// Do the window test.
+		const __m256i didPassWindowTest = _mm256_cmpeq_epi8( _mm256_loadu_si256((__m256i *)(this->_didPassWindowTestCustom[compInfo.renderState.selectedLayerID] + compInfo.target.xCustom)), _mm256_set1_epi8(1) );
+		passMask8 = _mm256_and_si256(passMask8, didPassWindowTest);
+		
+		enableColorEffectMask = _mm256_cmpeq_epi8( _mm256_loadu_si256((__m256i *)(this->_enableColorEffectCustom[compInfo.renderState.selectedLayerID] + compInfo.target.xCustom)), _mm256_set1_epi8(1) );
+	}
+	
+	__m256i passMask16[2];
+	__m256i passMask32[4];
+	
+	if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		_gpuExpandMask8To16_AVX2(passMask8, passMask16);
+	}
+	else
+	{
+		_gpuExpandMask8To32_AVX2(passMask8, passMask32);
+	}
+	
+	// If we're rendering pixels to a debugging context, then assume that the pixel
+	// always passes the window test and that the color effect is always disabled.
+	if ( ISDEBUGRENDER || COLOREFFECTDISABLEDHINT || (_mm256_movemask_epi8(srcEffectEnableMask) == 0) )
+	{
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+		{
+			const __m256i alphaBits = _mm256_set1_epi16(0x8000);
+			dst0 = _mm256_blendv_epi8(dst0, _mm256_or_si256(src0, alphaBits), passMask16[0]);
+			dst1 = _mm256_blendv_epi8(dst1, _mm256_or_si256(src1, alphaBits), passMask16[1]);
+		}
+		else
+		{
+			const __m256i alphaBits = _mm256_set1_epi32((OUTPUTFORMAT == NDSColorFormat_BGR666_Rev) ? 0x1F000000 : 0xFF000000);
+			dst0 = _mm256_blendv_epi8(dst0, _mm256_or_si256(src0, alphaBits), passMask32[0]);
+			dst1 = _mm256_blendv_epi8(dst1, _mm256_or_si256(src1, alphaBits), passMask32[1]);
+			dst2 = _mm256_blendv_epi8(dst2, _mm256_or_si256(src2, alphaBits), passMask32[2]);
+			dst3 = _mm256_blendv_epi8(dst3, _mm256_or_si256(src3, alphaBits), passMask32[3]);
+		}
+		
+		if (!ISDEBUGRENDER)
+		{
+			dstLayerID = _mm256_blendv_epi8(dstLayerID, srcLayerID_vec256, passMask8);
+		}
+		
+		return;
+	}
+	
+	__m256i dstEffectEnableMask;
+	
+#ifdef ENABLE_SSSE3
+	// pshufb looks up each 128-bit lane separately, so give both lanes the same table.
+	dstEffectEnableMask = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSSE3), dstLayerID);
+	dstEffectEnableMask = _mm256_xor_si256( _mm256_cmpeq_epi8(dstEffectEnableMask, _mm256_setzero_si256()), _mm256_set1_epi32(0xFFFFFFFF) );
+#else
+	dstEffectEnableMask =                                      _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG0)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_BG0]));
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG1)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_BG1])) );
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG2)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_BG2])) );
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG3)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_BG3])) );
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_OBJ)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_OBJ])) );
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_Backdrop)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_Backdrop])) );
+#endif
+	
+	dstEffectEnableMask = _mm256_andnot_si256( _mm256_cmpeq_epi8(dstLayerID, srcLayerID_vec256), dstEffectEnableMask );
+	
+	// Select the color effect based on the BLDCNT target flags.
+	const __m256i colorEffect_vec256 = (WILLPERFORMWINDOWTEST) ? _mm256_blendv_epi8(_mm256_set1_epi8(ColorEffect_Disable), _mm256_set1_epi8(compInfo.renderState.colorEffect), enableColorEffectMask) : _mm256_set1_epi8(compInfo.renderState.colorEffect);
+	const __m256i eva_vec256 = _mm256_set1_epi16(compInfo.renderState.blendEVA);
+	const __m256i evb_vec256 = _mm256_set1_epi16(compInfo.renderState.blendEVB);
+	const __m256i evy_vec256 = _mm256_set1_epi16(compInfo.renderState.blendEVY);
+	
+	__m256i tmpSrc[4] = {src0, src1, src2, src3};
+	
+	if ( (compInfo.renderState.colorEffect == ColorEffect_IncreaseBrightness) || (compInfo.renderState.colorEffect == ColorEffect_DecreaseBrightness) )
+	{
+		const __m256i brightnessMask8 = _mm256_and_si256( srcEffectEnableMask, _mm256_cmpeq_epi8(colorEffect_vec256, _mm256_set1_epi8(compInfo.renderState.colorEffect)) );
+		const bool isIncrease = (compInfo.renderState.colorEffect == ColorEffect_IncreaseBrightness);
+		
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+		{
+			__m256i brightnessMask16[2];
+			_gpuExpandMask8To16_AVX2(brightnessMask8, brightnessMask16);
+			
+			for (size_t i = 0; i < 2; i++)
+			{
+				const __m256i brightSrc = (isIncrease) ? this->_ColorEffectIncreaseBrightness<OUTPUTFORMAT>(tmpSrc[i], evy_vec256) : this->_ColorEffectDecreaseBrightness<OUTPUTFORMAT>(tmpSrc[i], evy_vec256);
+				tmpSrc[i] = _mm256_blendv_epi8(tmpSrc[i], brightSrc, brightnessMask16[i]);
+			}
+		}
+		else
+		{
+			__m256i brightnessMask32[4];
+			_gpuExpandMask8To32_AVX2(brightnessMask8, brightnessMask32);
+			
+			for (size_t i = 0; i < 4; i++)
+			{
+				const __m256i brightSrc = (isIncrease) ? this->_ColorEffectIncreaseBrightness<OUTPUTFORMAT>(tmpSrc[i], evy_vec256) : this->_ColorEffectDecreaseBrightness<OUTPUTFORMAT>(tmpSrc[i], evy_vec256);
+				tmpSrc[i] = _mm256_blendv_epi8(tmpSrc[i], brightSrc, brightnessMask32[i]);
+			}
+		}
+	}
+	
+	// Render the pixel using the selected color effect.
+	const __m256i blendMask8 = _mm256_and_si256( _mm256_and_si256(srcEffectEnableMask, dstEffectEnableMask), _mm256_cmpeq_epi8(colorEffect_vec256, _mm256_set1_epi8(ColorEffect_Blend)) );
+	
+	if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		__m256i blendMask16[2];
+		_gpuExpandMask8To16_AVX2(blendMask8, blendMask16);
+		
+		tmpSrc[0] = _mm256_blendv_epi8(tmpSrc[0], this->_ColorEffectBlend<OUTPUTFORMAT>(tmpSrc[0], dst0, eva_vec256, evb_vec256), blendMask16[0]);
+		tmpSrc[1] = _mm256_blendv_epi8(tmpSrc[1], this->_ColorEffectBlend<OUTPUTFORMAT>(tmpSrc[1], dst1, eva_vec256, evb_vec256), blendMask16[1]);
+		
+		// Combine the final colors.
+		dst0 = _mm256_blendv_epi8(dst0, _mm256_or_si256(tmpSrc[0], _mm256_set1_epi16(0x8000)), passMask16[0]);
+		dst1 = _mm256_blendv_epi8(dst1, _mm256_or_si256(tmpSrc[1], _mm256_set1_epi16(0x8000)), passMask16[1]);
+	}
+	else
+	{
+		__m256i blendMask32[4];
+		_gpuExpandMask8To32_AVX2(blendMask8, blendMask32);
+		
+		const __m256i alphaBits = _mm256_set1_epi32((OUTPUTFORMAT == NDSColorFormat_BGR666_Rev) ? 0x1F000000 : 0xFF000000);
+		
+		tmpSrc[0] = _mm256_blendv_epi8(tmpSrc[0], this->_ColorEffectBlend<OUTPUTFORMAT>(tmpSrc[0], dst0, eva_vec256, evb_vec256), blendMask32[0]);
+		tmpSrc[1] = _mm256_blendv_epi8(tmpSrc[1], this->_ColorEffectBlend<OUTPUTFORMAT>(tmpSrc[1], dst1, eva_vec256, evb_vec256), blendMask32[1]);
+		tmpSrc[2] = _mm256_blendv_epi8(tmpSrc[2], this->_ColorEffectBlend<OUTPUTFORMAT>(tmpSrc[2], dst2, eva_vec256, evb_vec256), blendMask32[2]);
+		tmpSrc[3] = _mm256_blendv_epi8(tmpSrc[3], this->_ColorEffectBlend<OUTPUTFORMAT>(tmpSrc[3], dst3, eva_vec256, evb_vec256), blendMask32[3]);
+		
+		dst0 = _mm256_blendv_epi8(dst0, _mm256_or_si256(tmpSrc[0], alphaBits), passMask32[0]);
+		dst1 = _mm256_blendv_epi8(dst1, _mm256_or_si256(tmpSrc[1], alphaBits), passMask32[1]);
+		dst2 = _mm256_blendv_epi8(dst2, _mm256_or_si256(tmpSrc[2], alphaBits), passMask32[2]);
+		dst3 = _mm256_blendv_epi8(dst3, _mm256_or_si256(tmpSrc[3], alphaBits), passMask32[3]);
+	}
+	
+	dstLayerID = _mm256_blendv_epi8(dstLayerID, srcLayerID_vec256, passMask8);
+}
+
+#endif
+
 // TODO: Unify this method with GPUEngineBase::_RenderPixel().
 // We can't unify this yet because the output framebuffer is in RGBA5551, but the 3D source pixels are in RGBA6665.
 // However, GPUEngineBase::_RenderPixel() takes source pixels in RGB555. In order to unify the methods, all pixels
@@ -2140,17 +2634,20 @@ FORCEINLINE void GPUEngineBase::_RenderPixel3D_SSE2(GPUEngineCompositorInfo &com
 	
 	if (_mm_movemask_epi8(enableColorEffectMask) == 0)
 	{
+		// Like the other paths, the final colors must always be written out as opaque.
 		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
 		{
-			dst0 = _mm_blendv_epi8(dst0, dst2, passMask16[0]);
-			dst1 = _mm_blendv_epi8(dst1, dst3, passMask16[1]);
+			dst0 = _mm_blendv_epi8(dst0, _mm_or_si128(dst2, _mm_set1_epi16(0x8000)), passMask16[0]);
+			dst1 = _mm_blendv_epi8(dst1, _mm_or_si128(dst3, _mm_set1_epi16(0x8000)), passMask16[1]);
 		}
 		else
 		{
-			dst0 = _mm_blendv_epi8(dst0, src0, passMask32[0]);
-			dst1 = _mm_blendv_epi8(dst1, src1, passMask32[1]);
-			dst2 = _mm_blendv_epi8(dst2, src2, passMask32[2]);
-			dst3 = _mm_blendv_epi8(dst3, src3, passMask32[3]);
+			const __m128i alphaBits = _mm_set1_epi32((OUTPUTFORMAT == NDSColorFormat_BGR666_Rev) ? 0x1F000000 : 0xFF000000);
+			
+			dst0 = _mm_blendv_epi8(dst0, _mm_or_si128(src0, alphaBits), passMask32[0]);
+			dst1 = _mm_blendv_epi8(dst1, _mm_or_si128(src1, alphaBits), passMask32[1]);
+			dst2 = _mm_blendv_epi8(dst2, _mm_or_si128(src2, alphaBits), passMask32[2]);
+			dst3 = _mm_blendv_epi8(dst3, _mm_or_si128(src3, alphaBits), passMask32[3]);
 		}
 		
 		dstLayerID = _mm_blendv_epi8(dstLayerID, _mm_set1_epi8(GPULayerID_BG0), passMask8);
@@ -2304,6 +2801,158 @@ FORCEINLINE void GPUEngineBase::_RenderPixel3D_SSE2(GPUEngineCompositorInfo &com
 
 #endif
 
+#ifdef ENABLE_AVX2_DISPATCH
+
+// AVX2 version of _RenderPixel3D_SSE2(), for 32 pixels at a time, all in pixel order.
+// As with the SSE2 version, when the output format is 555, dst2-dst3 carry the source
+// colors already converted to 16-bit.
+template <NDSColorFormat OUTPUTFORMAT>
+FUNCTARGET_AVX2 FORCEINLINE void GPUEngineBase::_RenderPixel3D_AVX2(GPUEngineCompositorInfo &compInfo,
+																	const __m256i &passMask8,
+																	const __m256i &enableColorEffectMask,
+																	const __m256i &src3, const __m256i &src2, const __m256i &src1, const __m256i &src0,
+																	__m256i &dst3, __m256i &dst2, __m256i &dst1, __m256i &dst0,
+																	__m256i &dstLayerID)
+{
+	__m256i passMask16[2];
+	__m256i passMask32[4];
+	
+	if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		_gpuExpandMask8To16_AVX2(passMask8, passMask16);
+	}
+	else
+	{
+		_gpuExpandMask8To32_AVX2(passMask8, passMask32);
+	}
+	
+	if (_mm256_movemask_epi8(enableColorEffectMask) == 0)
+	{
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+		{
+			dst0 = _mm256_blendv_epi8(dst0, _mm256_or_si256(dst2, _mm256_set1_epi16(0x8000)), passMask16[0]);
+			dst1 = _mm256_blendv_epi8(dst1, _mm256_or_si256(dst3, _mm256_set1_epi16(0x8000)), passMask16[1]);
+		}
+		else
+		{
+			const __m256i alphaBits = _mm256_set1_epi32((OUTPUTFORMAT == NDSColorFormat_BGR666_Rev) ? 0x1F000000 : 0xFF000000);
+			
+			dst0 = _mm256_blendv_epi8(dst0, _mm256_or_si256(src0, alphaBits), passMask32[0]);
+			dst1 = _mm256_blendv_epi8(dst1, _mm256_or_si256(src1, alphaBits), passMask32[1]);
+			dst2 = _mm256_blendv_epi8(dst2, _mm256_or_si256(src2, alphaBits), passMask32[2]);
+			dst3 = _mm256_blendv_epi8(dst3, _mm256_or_si256(src3, alphaBits), passMask32[3]);
+		}
+		
+		dstLayerID = _mm256_blendv_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG0), passMask8);
+		return;
+	}
+	
+	__m256i tmpSrc[4];
+	if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		// Rename our converted 16-bit src colors to reflect what they actually are.
+		tmpSrc[0] = dst2;
+		tmpSrc[1] = dst3;
+		tmpSrc[2] = _mm256_setzero_si256();
+		tmpSrc[3] = _mm256_setzero_si256();
+	}
+	else
+	{
+		tmpSrc[0] = src0;
+		tmpSrc[1] = src1;
+		tmpSrc[2] = src2;
+		tmpSrc[3] = src3;
+	}
+	
+	const __m256i srcEffectEnableMask = _mm256_broadcastsi128_si256(compInfo.renderState.srcBlendEnable_SSE2[GPULayerID_BG0]);
+	__m256i dstEffectEnableMask;
+	
+#ifdef ENABLE_SSSE3
+	dstEffectEnableMask = _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSSE3), dstLayerID);
+	dstEffectEnableMask = _mm256_xor_si256( _mm256_cmpeq_epi8(dstEffectEnableMask, _mm256_setzero_si256()), _mm256_set1_epi32(0xFFFFFFFF) );
+#else
+	dstEffectEnableMask =                                      _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG0)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_BG0]));
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG1)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_BG1])) );
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG2)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_BG2])) );
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG3)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_BG3])) );
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_OBJ)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_OBJ])) );
+	dstEffectEnableMask = _mm256_or_si256(dstEffectEnableMask, _mm256_and_si256(_mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_Backdrop)), _mm256_broadcastsi128_si256(compInfo.renderState.dstBlendEnable_SSE2[GPULayerID_Backdrop])) );
+#endif
+	
+	dstEffectEnableMask = _mm256_andnot_si256( _mm256_cmpeq_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG0)), dstEffectEnableMask );
+	
+	// Select the color effect based on the BLDCNT target flags.
+	const __m256i colorEffect_vec256 = _mm256_blendv_epi8(_mm256_set1_epi8(ColorEffect_Disable), _mm256_set1_epi8(compInfo.renderState.colorEffect), enableColorEffectMask);
+	const __m256i forceBlendEffectMask = _mm256_and_si256(enableColorEffectMask, dstEffectEnableMask);
+	const __m256i evy_vec256 = _mm256_set1_epi16(compInfo.renderState.blendEVY);
+	
+	if ( (compInfo.renderState.colorEffect == ColorEffect_IncreaseBrightness) || (compInfo.renderState.colorEffect == ColorEffect_DecreaseBrightness) )
+	{
+		const __m256i brightnessMask8 = _mm256_andnot_si256( forceBlendEffectMask, _mm256_and_si256(srcEffectEnableMask, _mm256_cmpeq_epi8(colorEffect_vec256, _mm256_set1_epi8(compInfo.renderState.colorEffect))) );
+		const bool isIncrease = (compInfo.renderState.colorEffect == ColorEffect_IncreaseBrightness);
+		
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+		{
+			__m256i brightnessMask16[2];
+			_gpuExpandMask8To16_AVX2(brightnessMask8, brightnessMask16);
+			
+			for (size_t i = 0; i < 2; i++)
+			{
+				const __m256i brightSrc = (isIncrease) ? this->_ColorEffectIncreaseBrightness<OUTPUTFORMAT>(tmpSrc[i], evy_vec256) : this->_ColorEffectDecreaseBrightness<OUTPUTFORMAT>(tmpSrc[i], evy_vec256);
+				tmpSrc[i] = _mm256_blendv_epi8(tmpSrc[i], brightSrc, brightnessMask16[i]);
+			}
+		}
+		else
+		{
+			__m256i brightnessMask32[4];
+			_gpuExpandMask8To32_AVX2(brightnessMask8, brightnessMask32);
+			
+			for (size_t i = 0; i < 4; i++)
+			{
+				const __m256i brightSrc = (isIncrease) ? this->_ColorEffectIncreaseBrightness<OUTPUTFORMAT>(tmpSrc[i], evy_vec256) : this->_ColorEffectDecreaseBrightness<OUTPUTFORMAT>(tmpSrc[i], evy_vec256);
+				tmpSrc[i] = _mm256_blendv_epi8(tmpSrc[i], brightSrc, brightnessMask32[i]);
+			}
+		}
+	}
+	
+	// Render the pixel using the selected color effect.
+	const __m256i blendMask8 = _mm256_or_si256( forceBlendEffectMask, _mm256_and_si256(_mm256_and_si256(srcEffectEnableMask, dstEffectEnableMask), _mm256_cmpeq_epi8(colorEffect_vec256, _mm256_set1_epi8(ColorEffect_Blend))) );
+	
+	if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		__m256i blendMask16[2];
+		_gpuExpandMask8To16_AVX2(blendMask8, blendMask16);
+		
+		tmpSrc[0] = _mm256_blendv_epi8(tmpSrc[0], this->_ColorEffectBlend3D<OUTPUTFORMAT>(src0, src1, dst0), blendMask16[0]);
+		tmpSrc[1] = _mm256_blendv_epi8(tmpSrc[1], this->_ColorEffectBlend3D<OUTPUTFORMAT>(src2, src3, dst1), blendMask16[1]);
+		
+		// Combine the final colors.
+		dst0 = _mm256_blendv_epi8(dst0, _mm256_or_si256(tmpSrc[0], _mm256_set1_epi16(0x8000)), passMask16[0]);
+		dst1 = _mm256_blendv_epi8(dst1, _mm256_or_si256(tmpSrc[1], _mm256_set1_epi16(0x8000)), passMask16[1]);
+	}
+	else
+	{
+		__m256i blendMask32[4];
+		_gpuExpandMask8To32_AVX2(blendMask8, blendMask32);
+		
+		const __m256i alphaBits = _mm256_set1_epi32((OUTPUTFORMAT == NDSColorFormat_BGR666_Rev) ? 0x1F000000 : 0xFF000000);
+		
+		tmpSrc[0] = _mm256_blendv_epi8(tmpSrc[0], this->_ColorEffectBlend3D<OUTPUTFORMAT>(src0, src0, dst0), blendMask32[0]);
+		tmpSrc[1] = _mm256_blendv_epi8(tmpSrc[1], this->_ColorEffectBlend3D<OUTPUTFORMAT>(src1, src1, dst1), blendMask32[1]);
+		tmpSrc[2] = _mm256_blendv_epi8(tmpSrc[2], this->_ColorEffectBlend3D<OUTPUTFORMAT>(src2, src2, dst2), blendMask32[2]);
+		tmpSrc[3] = _mm256_blendv_epi8(tmpSrc[3], this->_ColorEffectBlend3D<OUTPUTFORMAT>(src3, src3, dst3), blendMask32[3]);
+		
+		dst0 = _mm256_blendv_epi8(dst0, _mm256_or_si256(tmpSrc[0], alphaBits), passMask32[0]);
+		dst1 = _mm256_blendv_epi8(dst1, _mm256_or_si256(tmpSrc[1], alphaBits), passMask32[1]);
+		dst2 = _mm256_blendv_epi8(dst2, _mm256_or_si256(tmpSrc[2], alphaBits), passMask32[2]);
+		dst3 = _mm256_blendv_epi8(dst3, _mm256_or_si256(tmpSrc[3], alphaBits), passMask32[3]);
+	}
+	
+	dstLayerID = _mm256_blendv_epi8(dstLayerID, _mm256_set1_epi8(GPULayerID_BG0), passMask8);
+}
+
+#endif
+
 //this is fantastically inaccurate.
 //we do the early return even though it reduces the resulting accuracy
 //because we need the speed, and because it is inaccurate anyway
@@ -2473,32 +3122,173 @@ FORCEINLINE void GPUEngineBase::_RenderPixelSingle(GPUEngineCompositorInfo &comp
 	compInfo.target.lineColor16 = (u16 *)compInfo.target.lineColorHeadNative + srcX;
 	compInfo.target.lineColor32 = (FragmentColor *)compInfo.target.lineColorHeadNative + srcX;
 	
-	if (MOSAIC)
+	if (MOSAIC)
+	{
+		//due to this early out, we will get incorrect behavior in cases where
+		//we enable mosaic in the middle of a frame. this is deemed unlikely.
+		
+		if (!opaque) srcColor16 = 0xFFFF;
+		else srcColor16 &= 0x7FFF;
+		
+		if (!compInfo.renderState.mosaicWidthBG[srcX].begin || !compInfo.renderState.mosaicHeightBG[compInfo.line.indexNative].begin)
+		{
+			srcColor16 = this->_mosaicColors.bg[compInfo.renderState.selectedLayerID][compInfo.renderState.mosaicWidthBG[srcX].trunc];
+		}
+		
+		this->_mosaicColors.bg[compInfo.renderState.selectedLayerID][srcX] = srcColor16;
+		
+		willRenderColor = (srcColor16 != 0xFFFF);
+	}
+	
+	if (willRenderColor)
+	{
+		this->_RenderPixel<OUTPUTFORMAT, false, ISDEBUGRENDER, WILLPERFORMWINDOWTEST, COLOREFFECTDISABLEDHINT>(compInfo,
+																											   srcColor16,
+																											   0);
+	}
+}
+
+#ifdef ENABLE_AVX2_DISPATCH
+
+// Composites the current line from compInfo.target.xCustom up to avxPixCount, 32 pixels at a
+// time, and leaves compInfo.target pointing at the first pixel that is still left to do.
+template<NDSColorFormat OUTPUTFORMAT, bool ISDEBUGRENDER, bool WILLPERFORMWINDOWTEST, bool COLOREFFECTDISABLEDHINT>
+FUNCTARGET_AVX2 void GPUEngineBase::_RenderPixelsCustom_AVX2(GPUEngineCompositorInfo &compInfo, const size_t avxPixCount)
+{
+	const __m256i srcEffectEnableMask = _mm256_broadcastsi128_si256(compInfo.renderState.srcBlendEnable_SSE2[compInfo.renderState.selectedLayerID]);
+	
+	for (; compInfo.target.xCustom < avxPixCount; compInfo.target.xCustom+=32, compInfo.target.xNative = _gpuDstToSrcIndex[compInfo.target.xCustom], compInfo.target.lineColor16+=32, compInfo.target.lineColor32+=32, compInfo.target.lineLayerID+=32)
+	{
+		const __m256i src16[2] = { _mm256_loadu_si256((__m256i *)(this->_bgLayerColorCustom + compInfo.target.xCustom +  0)),
+		                           _mm256_loadu_si256((__m256i *)(this->_bgLayerColorCustom + compInfo.target.xCustom + 16)) };
+		__m256i src[4];
+		
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+		{
+			src[0] = src16[0];
+			src[1] = src16[1];
+			src[2] = _mm256_setzero_si256();
+			src[3] = _mm256_setzero_si256();
+		}
+		else
+		{
+			src[0] = _gpuConvertColor555To32Opaque_AVX2<OUTPUTFORMAT>( _mm256_castsi256_si128(src16[0]) );
+			src[1] = _gpuConvertColor555To32Opaque_AVX2<OUTPUTFORMAT>( _mm256_extracti128_si256(src16[0], 1) );
+			src[2] = _gpuConvertColor555To32Opaque_AVX2<OUTPUTFORMAT>( _mm256_castsi256_si128(src16[1]) );
+			src[3] = _gpuConvertColor555To32Opaque_AVX2<OUTPUTFORMAT>( _mm256_extracti128_si256(src16[1], 1) );
+		}
+		
+		__m256i dstLayerID_vec256 = _mm256_loadu_si256((__m256i *)compInfo.target.lineLayerID);
+		__m256i passMask8 = _mm256_xor_si256( _mm256_cmpeq_epi8(_mm256_loadu_si256((__m256i *)(this->_bgLayerIndexCustom + compInfo.target.xCustom)), _mm256_setzero_si256()), _mm256_set1_epi32(0xFFFFFFFF) );
+		
+		__m256i dst[4];
+		dst[0] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 0);
+		dst[1] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 1);
+		
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+		{
+			dst[2] = _mm256_setzero_si256();
+			dst[3] = _mm256_setzero_si256();
+		}
+		else
+		{
+			dst[2] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 2);
+			dst[3] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 3);
+		}
+		
+		this->_RenderPixel32_AVX2<OUTPUTFORMAT, ISDEBUGRENDER, WILLPERFORMWINDOWTEST, COLOREFFECTDISABLEDHINT>(compInfo,
+																											  src[3], src[2], src[1], src[0],
+																											  srcEffectEnableMask,
+																											  dst[3], dst[2], dst[1], dst[0],
+																											  dstLayerID_vec256,
+																											  passMask8);
+		_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 0, dst[0]);
+		_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 1, dst[1]);
+		
+		if (OUTPUTFORMAT != NDSColorFormat_BGR555_Rev)
+		{
+			_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 2, dst[2]);
+			_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 3, dst[3]);
+		}
+		
+		_mm256_storeu_si256((__m256i *)compInfo.target.lineLayerID, dstLayerID_vec256);
+	}
+}
+
+// Same as _RenderPixelsCustom_AVX2(), but reads directly from a custom VRAM line. Returns the
+// number of pixels that were composited.
+template<NDSColorFormat OUTPUTFORMAT, bool ISDEBUGRENDER, bool WILLPERFORMWINDOWTEST, bool COLOREFFECTDISABLEDHINT>
+FUNCTARGET_AVX2 size_t GPUEngineBase::_RenderPixelsCustomVRAM_AVX2(GPUEngineCompositorInfo &compInfo, const u16 *__restrict srcLine, const size_t avxPixCount)
+{
+	const __m256i srcEffectEnableMask = _mm256_broadcastsi128_si256(compInfo.renderState.srcBlendEnable_SSE2[compInfo.renderState.selectedLayerID]);
+	size_t i = 0;
+	
+	for (; i < avxPixCount; i+=32, compInfo.target.xCustom+=32, compInfo.target.xNative = _gpuDstToSrcIndex[compInfo.target.xCustom], compInfo.target.lineColor16+=32, compInfo.target.lineColor32+=32, compInfo.target.lineLayerID+=32)
 	{
-		//due to this early out, we will get incorrect behavior in cases where
-		//we enable mosaic in the middle of a frame. this is deemed unlikely.
+		const __m256i src16[2] = { _mm256_loadu_si256((__m256i *)(srcLine + i +  0)),
+		                           _mm256_loadu_si256((__m256i *)(srcLine + i + 16)) };
+		__m256i src[4];
 		
-		if (!opaque) srcColor16 = 0xFFFF;
-		else srcColor16 &= 0x7FFF;
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+		{
+			src[0] = src16[0];
+			src[1] = src16[1];
+			src[2] = _mm256_setzero_si256();
+			src[3] = _mm256_setzero_si256();
+		}
+		else
+		{
+			src[0] = _gpuConvertColor555To32Opaque_AVX2<OUTPUTFORMAT>( _mm256_castsi256_si128(src16[0]) );
+			src[1] = _gpuConvertColor555To32Opaque_AVX2<OUTPUTFORMAT>( _mm256_extracti128_si256(src16[0], 1) );
+			src[2] = _gpuConvertColor555To32Opaque_AVX2<OUTPUTFORMAT>( _mm256_castsi256_si128(src16[1]) );
+			src[3] = _gpuConvertColor555To32Opaque_AVX2<OUTPUTFORMAT>( _mm256_extracti128_si256(src16[1], 1) );
+		}
 		
-		if (!compInfo.renderState.mosaicWidthBG[srcX].begin || !compInfo.renderState.mosaicHeightBG[compInfo.line.indexNative].begin)
+		__m256i dstLayerID_vec256 = _mm256_loadu_si256((__m256i *)compInfo.target.lineLayerID);
+		
+		// packsswb works within each 128-bit lane, so put the 64-bit blocks back in pixel order.
+		__m256i passMask8 = _mm256_packs_epi16( _mm256_srli_epi16(src16[0], 15), _mm256_srli_epi16(src16[1], 15) );
+		passMask8 = _mm256_permute4x64_epi64(passMask8, 0xD8);
+		passMask8 = _mm256_cmpeq_epi8(passMask8, _mm256_set1_epi8(1));
+		
+		__m256i dst[4];
+		dst[0] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 0);
+		dst[1] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 1);
+		
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
 		{
-			srcColor16 = this->_mosaicColors.bg[compInfo.renderState.selectedLayerID][compInfo.renderState.mosaicWidthBG[srcX].trunc];
+			dst[2] = _mm256_setzero_si256();
+			dst[3] = _mm256_setzero_si256();
+		}
+		else
+		{
+			dst[2] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 2);
+			dst[3] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 3);
 		}
 		
-		this->_mosaicColors.bg[compInfo.renderState.selectedLayerID][srcX] = srcColor16;
+		this->_RenderPixel32_AVX2<OUTPUTFORMAT, ISDEBUGRENDER, WILLPERFORMWINDOWTEST, COLOREFFECTDISABLEDHINT>(compInfo,
+																											  src[3], src[2], src[1], src[0],
+																											  srcEffectEnableMask,
+																											  dst[3], dst[2], dst[1], dst[0],
+																											  dstLayerID_vec256,
+																											  passMask8);
+		_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 0, dst[0]);
+		_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 1, dst[1]);
 		
-		willRenderColor = (srcColor16 != 0xFFFF);
+		if (OUTPUTFORMAT != NDSColorFormat_BGR555_Rev)
+		{
+			_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 2, dst[2]);
+			_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 3, dst[3]);
+		}
+		
+		_mm256_storeu_si256((__m256i *)compInfo.target.lineLayerID, dstLayerID_vec256);
 	}
 	
-	if (willRenderColor)
-	{
-		this->_RenderPixel<OUTPUTFORMAT, false, ISDEBUGRENDER, WILLPERFORMWINDOWTEST, COLOREFFECTDISABLEDHINT>(compInfo,
-																											   srcColor16,
-																											   0);
-	}
+	return i;
 }
 
+#endif
+
 template<NDSColorFormat OUTPUTFORMAT, bool ISDEBUGRENDER, bool MOSAIC, bool WILLPERFORMWINDOWTEST, bool COLOREFFECTDISABLEDHINT>
 void GPUEngineBase::_RenderPixelsCustom(GPUEngineCompositorInfo &compInfo)
 {
@@ -2615,6 +3405,13 @@ void GPUEngineBase::_RenderPixelsCustom(GPUEngineCompositorInfo &compInfo)
 		compInfo.target.xNative = 0;
 		compInfo.target.xCustom = 0;
 		
+#ifdef ENABLE_AVX2_DISPATCH
+		if (_gpuHostHasAVX2)
+		{
+			this->_RenderPixelsCustom_AVX2<OUTPUTFORMAT, ISDEBUGRENDER, WILLPERFORMWINDOWTEST, COLOREFFECTDISABLEDHINT>(compInfo, compInfo.line.widthCustom - (compInfo.line.widthCustom % 32));
+		}
+#endif
+		
 #ifdef ENABLE_SSE2
 		for (; compInfo.target.xCustom < ssePixCount; compInfo.target.xCustom+=16, compInfo.target.xNative = _gpuDstToSrcIndex[compInfo.target.xCustom], compInfo.target.lineColor16+=16, compInfo.target.lineColor32+=16, compInfo.target.lineLayerID+=16)
 		{
@@ -2714,6 +3511,13 @@ void GPUEngineBase::_RenderPixelsCustomVRAM(GPUEngineCompositorInfo &compInfo)
 	
 	size_t i = 0;
 	
+#ifdef ENABLE_AVX2_DISPATCH
+	if (_gpuHostHasAVX2)
+	{
+		i = this->_RenderPixelsCustomVRAM_AVX2<OUTPUTFORMAT, ISDEBUGRENDER, WILLPERFORMWINDOWTEST, COLOREFFECTDISABLEDHINT>(compInfo, srcLine, compInfo.line.pixelCount - (compInfo.line.pixelCount % 32));
+	}
+#endif
+	
 #ifdef ENABLE_SSE2
 	const __m128i srcEffectEnableMask = compInfo.renderState.srcBlendEnable_SSE2[compInfo.renderState.selectedLayerID];
 	
@@ -4036,6 +4840,80 @@ void GPUEngineBase::_RenderLine_LayerOBJ(GPUEngineCompositorInfo &compInfo, item
 	}
 }
 
+#ifdef ENABLE_AVX2_DISPATCH
+
+// Applies master brightness to as many whole vectors of the framebuffer as it can, and returns
+// the number of pixels that were processed so that the caller can finish the rest.
+template <NDSColorFormat OUTPUTFORMAT, GPUMasterBrightMode MODE>
+FUNCTARGET_AVX2 size_t GPUEngineBase::_ApplyMasterBrightness_AVX2(void *dst, const size_t pixCount, const u16 intensity)
+{
+	const __m256i intensity_vec256 = _mm256_set1_epi16(intensity);
+	size_t i = 0;
+	
+	if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		const size_t avxPixCount = pixCount - (pixCount % 16);
+		for (; i < avxPixCount; i += 16)
+		{
+			__m256i dstColor_vec256 = _mm256_loadu_si256((__m256i *)((u16 *)dst + i));
+			dstColor_vec256 = (MODE == GPUMasterBrightMode_Up) ? this->_ColorEffectIncreaseBrightness<OUTPUTFORMAT>(dstColor_vec256, intensity_vec256) : this->_ColorEffectDecreaseBrightness<OUTPUTFORMAT>(dstColor_vec256, intensity_vec256);
+			dstColor_vec256 = _mm256_or_si256(dstColor_vec256, _mm256_set1_epi16(0x8000));
+			_mm256_storeu_si256((__m256i *)((u16 *)dst + i), dstColor_vec256);
+		}
+	}
+	else
+	{
+		const size_t avxPixCount = pixCount - (pixCount % 8);
+		for (; i < avxPixCount; i += 8)
+		{
+			__m256i dstColor_vec256 = _mm256_loadu_si256((__m256i *)((FragmentColor *)dst + i));
+			dstColor_vec256 = (MODE == GPUMasterBrightMode_Up) ? this->_ColorEffectIncreaseBrightness<OUTPUTFORMAT>(dstColor_vec256, intensity_vec256) : this->_ColorEffectDecreaseBrightness<OUTPUTFORMAT>(dstColor_vec256, intensity_vec256);
+			dstColor_vec256 = _mm256_or_si256(dstColor_vec256, _mm256_set1_epi32((OUTPUTFORMAT == NDSColorFormat_BGR666_Rev) ? 0x1F000000 : 0xFF000000));
+			_mm256_storeu_si256((__m256i *)((FragmentColor *)dst + i), dstColor_vec256);
+		}
+	}
+	
+	return i;
+}
+
+#endif
+
+#ifdef ENABLE_AVX512_DISPATCH
+
+template <NDSColorFormat OUTPUTFORMAT, GPUMasterBrightMode MODE>
+FUNCTARGET_AVX512 size_t GPUEngineBase::_ApplyMasterBrightness_AVX512(void *dst, const size_t pixCount, const u16 intensity)
+{
+	const __m512i intensity_vec512 = _mm512_set1_epi16(intensity);
+	size_t i = 0;
+	
+	if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+	{
+		const size_t avxPixCount = pixCount - (pixCount % 32);
+		for (; i < avxPixCount; i += 32)
+		{
+			__m512i dstColor_vec512 = _mm512_loadu_si512((__m512i *)((u16 *)dst + i));
+			dstColor_vec512 = (MODE == GPUMasterBrightMode_Up) ? this->_ColorEffectIncreaseBrightness<OUTPUTFORMAT>(dstColor_vec512, intensity_vec512) : this->_ColorEffectDecreaseBrightness<OUTPUTFORMAT>(dstColor_vec512, intensity_vec512);
+			dstColor_vec512 = _mm512_or_si512(dstColor_vec512, _mm512_set1_epi16(0x8000));
+			_mm512_storeu_si512((__m512i *)((u16 *)dst + i), dstColor_vec512);
+		}
+	}
+	else
+	{
+		const size_t avxPixCount = pixCount - (pixCount % 16);
+		for (; i < avxPixCount; i += 16)
+		{
+			__m512i dstColor_vec512 = _mm512_loadu_si512((__m512i *)((FragmentColor *)dst + i));
+			dstColor_vec512 = (MODE == GPUMasterBrightMode_Up) ? this->_ColorEffectIncreaseBrightness<OUTPUTFORMAT>(dstColor_vec512, intensity_vec512) : this->_ColorEffectDecreaseBrightness<OUTPUTFORMAT>(dstColor_vec512, intensity_vec512);
+			dstColor_vec512 = _mm512_or_si512(dstColor_vec512, _mm512_set1_epi32((OUTPUTFORMAT == NDSColorFormat_BGR666_Rev) ? 0x1F000000 : 0xFF000000));
+			_mm512_storeu_si512((__m512i *)((FragmentColor *)dst + i), dstColor_vec512);
+		}
+	}
+	
+	return i;
+}
+
+#endif
+
 template <NDSColorFormat OUTPUTFORMAT, bool ISFULLINTENSITYHINT>
 void GPUEngineBase::ApplyMasterBrightness()
 {
@@ -4058,6 +4936,20 @@ void GPUEngineBase::ApplyMasterBrightness()
 			{
 				size_t i = 0;
 				
+#ifdef ENABLE_AVX512_DISPATCH
+				if (_gpuHostHasAVX512)
+				{
+					i = this->_ApplyMasterBrightness_AVX512<OUTPUTFORMAT, GPUMasterBrightMode_Up>(dst, pixCount, intensity);
+				}
+				else
+#endif
+#ifdef ENABLE_AVX2_DISPATCH
+				if (_gpuHostHasAVX2)
+				{
+					i = this->_ApplyMasterBrightness_AVX2<OUTPUTFORMAT, GPUMasterBrightMode_Up>(dst, pixCount, intensity);
+				}
+#endif
+				
 				switch (OUTPUTFORMAT)
 				{
 					case NDSColorFormat_BGR555_Rev:
@@ -4146,6 +5038,20 @@ void GPUEngineBase::ApplyMasterBrightness()
 			{
 				size_t i = 0;
 				
+#ifdef ENABLE_AVX512_DISPATCH
+				if (_gpuHostHasAVX512)
+				{
+					i = this->_ApplyMasterBrightness_AVX512<OUTPUTFORMAT, GPUMasterBrightMode_Down>(dst, pixCount, intensity);
+				}
+				else
+#endif
+#ifdef ENABLE_AVX2_DISPATCH
+				if (_gpuHostHasAVX2)
+				{
+					i = this->_ApplyMasterBrightness_AVX2<OUTPUTFORMAT, GPUMasterBrightMode_Down>(dst, pixCount, intensity);
+				}
+#endif
+				
 				switch (OUTPUTFORMAT)
 				{
 					case NDSColorFormat_BGR555_Rev:
@@ -4291,6 +5197,144 @@ void GPUEngineBase::_UpdateWINH(GPUEngineCompositorInfo &compInfo)
 	}
 }
 
+#ifdef ENABLE_AVX2_DISPATCH
+
+// Computes the window test results of one layer for the whole native line. Returns the number
+// of pixels that were processed.
+FUNCTARGET_AVX2 size_t GPUEngineBase::_PerformWindowTesting_AVX2(GPUEngineCompositorInfo &compInfo, const size_t layerID)
+{
+	const __m256i win0Enable_vec256 = _mm256_broadcastsi128_si256(compInfo.renderState.WIN0_enable_SSE2[layerID]);
+	const __m256i win0EffectEnable_vec256 = _mm256_broadcastsi128_si256(compInfo.renderState.WIN0_enable_SSE2[WINDOWCONTROL_EFFECTFLAG]);
+	const __m256i win1Enable_vec256 = _mm256_broadcastsi128_si256(compInfo.renderState.WIN1_enable_SSE2[layerID]);
+	const __m256i win1EffectEnable_vec256 = _mm256_broadcastsi128_si256(compInfo.renderState.WIN1_enable_SSE2[WINDOWCONTROL_EFFECTFLAG]);
+	const __m256i winOBJEnable_vec256 = _mm256_broadcastsi128_si256(compInfo.renderState.WINOBJ_enable_SSE2[layerID]);
+	const __m256i winOBJEffectEnable_vec256 = _mm256_broadcastsi128_si256(compInfo.renderState.WINOBJ_enable_SSE2[WINDOWCONTROL_EFFECTFLAG]);
+	const __m256i winOUTEnable_vec256 = _mm256_broadcastsi128_si256(compInfo.renderState.WINOUT_enable_SSE2[layerID]);
+	const __m256i winOUTEffectEnable_vec256 = _mm256_broadcastsi128_si256(compInfo.renderState.WINOUT_enable_SSE2[WINDOWCONTROL_EFFECTFLAG]);
+	
+	for (size_t i = 0; i < GPU_FRAMEBUFFER_NATIVE_WIDTH; i+=32)
+	{
+		__m256i win_vec256;
+		
+		__m256i didPassWindowTest = _mm256_setzero_si256();
+		__m256i enableColorEffect = _mm256_setzero_si256();
+		
+		__m256i win0HandledMask = _mm256_setzero_si256();
+		__m256i win1HandledMask = _mm256_setzero_si256();
+		__m256i winOBJHandledMask = _mm256_setzero_si256();
+		__m256i winOUTHandledMask = _mm256_setzero_si256();
+		
+		// Window 0 has the highest priority, so always check this first.
+		if (compInfo.renderState.WIN0_ENABLED && this->_IsWindowInsideVerticalRange<0>(compInfo))
+		{
+			win_vec256 = _mm256_load_si256((__m256i *)(this->_h_win[0] + i));
+			win0HandledMask = _mm256_cmpeq_epi8(win_vec256, _mm256_set1_epi8(1));
+			
+			didPassWindowTest = _mm256_and_si256(win0HandledMask, win0Enable_vec256);
+			enableColorEffect = _mm256_and_si256(win0HandledMask, win0EffectEnable_vec256);
+		}
+		
+		// Window 1 has medium priority, and is checked after Window 0.
+		if (compInfo.renderState.WIN1_ENABLED && this->_IsWindowInsideVerticalRange<1>(compInfo))
+		{
+			win_vec256 = _mm256_load_si256((__m256i *)(this->_h_win[1] + i));
+			win1HandledMask = _mm256_andnot_si256(win0HandledMask, _mm256_cmpeq_epi8(win_vec256, _mm256_set1_epi8(1)));
+			
+			didPassWindowTest = _mm256_or_si256( didPassWindowTest, _mm256_and_si256(win1HandledMask, win1Enable_vec256) );
+			enableColorEffect = _mm256_or_si256( enableColorEffect, _mm256_and_si256(win1HandledMask, win1EffectEnable_vec256) );
+		}
+		
+		// Window OBJ has low priority, and is checked after both Window 0 and Window 1.
+		if (compInfo.renderState.WINOBJ_ENABLED)
+		{
+			win_vec256 = _mm256_load_si256((__m256i *)(this->_sprWin + i));
+			winOBJHandledMask = _mm256_andnot_si256( _mm256_or_si256(win0HandledMask, win1HandledMask), _mm256_cmpeq_epi8(win_vec256, _mm256_set1_epi8(1)) );
+			
+			didPassWindowTest = _mm256_or_si256( didPassWindowTest, _mm256_and_si256(winOBJHandledMask, winOBJEnable_vec256) );
+			enableColorEffect = _mm256_or_si256( enableColorEffect, _mm256_and_si256(winOBJHandledMask, winOBJEffectEnable_vec256) );
+		}
+		
+		// If the pixel isn't inside any windows, then the pixel is outside, and therefore uses the WINOUT flags.
+		// This has the lowest priority, and is always checked last.
+		winOUTHandledMask = _mm256_xor_si256( _mm256_or_si256(win0HandledMask, _mm256_or_si256(win1HandledMask, winOBJHandledMask)), _mm256_set1_epi32(0xFFFFFFFF) );
+		didPassWindowTest = _mm256_or_si256( didPassWindowTest, _mm256_and_si256(winOUTHandledMask, winOUTEnable_vec256) );
+		enableColorEffect = _mm256_or_si256( enableColorEffect, _mm256_and_si256(winOUTHandledMask, winOUTEffectEnable_vec256) );
+		
+		_mm256_store_si256((__m256i *)(this->_didPassWindowTestNative[layerID] + i), _mm256_and_si256(didPassWindowTest, _mm256_set1_epi8(0x01)));
+		_mm256_store_si256((__m256i *)(this->_enableColorEffectNative[layerID] + i), _mm256_and_si256(enableColorEffect, _mm256_set1_epi8(0x01)));
+	}
+	
+	return GPU_FRAMEBUFFER_NATIVE_WIDTH;
+}
+
+#endif
+
+#ifdef ENABLE_AVX512_DISPATCH
+
+FUNCTARGET_AVX512 size_t GPUEngineBase::_PerformWindowTesting_AVX512(GPUEngineCompositorInfo &compInfo, const size_t layerID)
+{
+	const __m512i win0Enable_vec512 = _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, compInfo.renderState.WIN0_enable_SSE2[layerID]);
+	const __m512i win0EffectEnable_vec512 = _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, compInfo.renderState.WIN0_enable_SSE2[WINDOWCONTROL_EFFECTFLAG]);
+	const __m512i win1Enable_vec512 = _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, compInfo.renderState.WIN1_enable_SSE2[layerID]);
+	const __m512i win1EffectEnable_vec512 = _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, compInfo.renderState.WIN1_enable_SSE2[WINDOWCONTROL_EFFECTFLAG]);
+	const __m512i winOBJEnable_vec512 = _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, compInfo.renderState.WINOBJ_enable_SSE2[layerID]);
+	const __m512i winOBJEffectEnable_vec512 = _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, compInfo.renderState.WINOBJ_enable_SSE2[WINDOWCONTROL_EFFECTFLAG]);
+	const __m512i winOUTEnable_vec512 = _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, compInfo.renderState.WINOUT_enable_SSE2[layerID]);
+	const __m512i winOUTEffectEnable_vec512 = _mm512_maskz_broadcast_i32x4((__mmask16)0xFFFF, compInfo.renderState.WINOUT_enable_SSE2[WINDOWCONTROL_EFFECTFLAG]);
+	
+	for (size_t i = 0; i < GPU_FRAMEBUFFER_NATIVE_WIDTH; i+=64)
+	{
+		// Each window handles a disjoint set of pixels, so the per-window results can be
+		// merged with masked moves instead of OR-ing full vectors together.
+		__m512i didPassWindowTest = _mm512_setzero_si512();
+		__m512i enableColorEffect = _mm512_setzero_si512();
+		
+		__mmask64 win0HandledMask = 0;
+		__mmask64 win1HandledMask = 0;
+		__mmask64 winOBJHandledMask = 0;
+		
+		// Window 0 has the highest priority, so always check this first.
+		if (compInfo.renderState.WIN0_ENABLED && this->_IsWindowInsideVerticalRange<0>(compInfo))
+		{
+			win0HandledMask = _mm512_cmpeq_epi8_mask(_mm512_loadu_si512((__m512i *)(this->_h_win[0] + i)), _mm512_set1_epi8(1));
+			
+			didPassWindowTest = _mm512_maskz_mov_epi8(win0HandledMask, win0Enable_vec512);
+			enableColorEffect = _mm512_maskz_mov_epi8(win0HandledMask, win0EffectEnable_vec512);
+		}
+		
+		// Window 1 has medium priority, and is checked after Window 0.
+		if (compInfo.renderState.WIN1_ENABLED && this->_IsWindowInsideVerticalRange<1>(compInfo))
+		{
+			win1HandledMask = _mm512_mask_cmpeq_epi8_mask(~win0HandledMask, _mm512_loadu_si512((__m512i *)(this->_h_win[1] + i)), _mm512_set1_epi8(1));
+			
+			didPassWindowTest = _mm512_mask_mov_epi8(didPassWindowTest, win1HandledMask, win1Enable_vec512);
+			enableColorEffect = _mm512_mask_mov_epi8(enableColorEffect, win1HandledMask, win1EffectEnable_vec512);
+		}
+		
+		// Window OBJ has low priority, and is checked after both Window 0 and Window 1.
+		if (compInfo.renderState.WINOBJ_ENABLED)
+		{
+			winOBJHandledMask = _mm512_mask_cmpeq_epi8_mask(~(win0HandledMask | win1HandledMask), _mm512_loadu_si512((__m512i *)(this->_sprWin + i)), _mm512_set1_epi8(1));
+			
+			didPassWindowTest = _mm512_mask_mov_epi8(didPassWindowTest, winOBJHandledMask, winOBJEnable_vec512);
+			enableColorEffect = _mm512_mask_mov_epi8(enableColorEffect, winOBJHandledMask, winOBJEffectEnable_vec512);
+		}
+		
+		// If the pixel isn't inside any windows, then the pixel is outside, and therefore uses the WINOUT flags.
+		// This has the lowest priority, and is always checked last.
+		const __mmask64 winOUTHandledMask = ~(win0HandledMask | win1HandledMask | winOBJHandledMask);
+		didPassWindowTest = _mm512_mask_mov_epi8(didPassWindowTest, winOUTHandledMask, winOUTEnable_vec512);
+		enableColorEffect = _mm512_mask_mov_epi8(enableColorEffect, winOUTHandledMask, winOUTEffectEnable_vec512);
+		
+		_mm512_storeu_si512((__m512i *)(this->_didPassWindowTestNative[layerID] + i), _mm512_and_si512(didPassWindowTest, _mm512_set1_epi8(0x01)));
+		_mm512_storeu_si512((__m512i *)(this->_enableColorEffectNative[layerID] + i), _mm512_and_si512(enableColorEffect, _mm512_set1_epi8(0x01)));
+	}
+	
+	return GPU_FRAMEBUFFER_NATIVE_WIDTH;
+}
+
+#endif
+
 void GPUEngineBase::_PerformWindowTesting(GPUEngineCompositorInfo &compInfo)
 {
 	if (this->_needUpdateWINH[0]) this->_UpdateWINH<0>(compInfo);
@@ -4303,8 +5347,24 @@ void GPUEngineBase::_PerformWindowTesting(GPUEngineCompositorInfo &compInfo)
 			continue;
 		}
 		
-#ifdef ENABLE_SSE2
-		for (size_t i = 0; i < GPU_FRAMEBUFFER_NATIVE_WIDTH; i+=16)
+#if defined(ENABLE_SSE2)
+		size_t i = 0;
+		
+#ifdef ENABLE_AVX512_DISPATCH
+		if (_gpuHostHasAVX512)
+		{
+			i = this->_PerformWindowTesting_AVX512(compInfo, layerID);
+		}
+		else
+#endif
+#ifdef ENABLE_AVX2_DISPATCH
+		if (_gpuHostHasAVX2)
+		{
+			i = this->_PerformWindowTesting_AVX2(compInfo, layerID);
+		}
+#endif
+		
+		for (; i < GPU_FRAMEBUFFER_NATIVE_WIDTH; i+=16)
 		{
 			__m128i win_vec128;
 			
@@ -5033,6 +6093,7 @@ GPUEngineA::GPUEngineA()
 	
 	_3DFramebufferRGBA6665 = (FragmentColor *)malloc_alignedCacheLine(GPU_FRAMEBUFFER_NATIVE_WIDTH * GPU_FRAMEBUFFER_NATIVE_HEIGHT * sizeof(FragmentColor));
 	_3DFramebufferRGBA5551 = (u16 *)malloc_alignedCacheLine(GPU_FRAMEBUFFER_NATIVE_WIDTH * GPU_FRAMEBUFFER_NATIVE_HEIGHT * sizeof(u16));
+	_3DFramebufferPipelined = (FragmentColor *)malloc_alignedCacheLine(GPU_FRAMEBUFFER_NATIVE_WIDTH * GPU_FRAMEBUFFER_NATIVE_HEIGHT * sizeof(FragmentColor));
 	gfx3d_Update3DFramebuffers(_3DFramebufferRGBA6665, _3DFramebufferRGBA5551);
 }
 
@@ -5040,6 +6101,7 @@ GPUEngineA::~GPUEngineA()
 {
 	free_aligned(this->_3DFramebufferRGBA6665);
 	free_aligned(this->_3DFramebufferRGBA5551);
+	free_aligned(this->_3DFramebufferPipelined);
 	gfx3d_Update3DFramebuffers(NULL, NULL);
 }
 
@@ -5100,6 +6162,7 @@ void GPUEngineA::Reset()
 	
 	memset(this->_3DFramebufferRGBA6665, 0, dispInfo.customWidth * dispInfo.customHeight * sizeof(FragmentColor));
 	memset(this->_3DFramebufferRGBA5551, 0, dispInfo.customWidth * dispInfo.customHeight * sizeof(u16));
+	memset(this->_3DFramebufferPipelined, 0, dispInfo.customWidth * dispInfo.customHeight * sizeof(FragmentColor));
 }
 
 void GPUEngineA::ParseReg_DISPCAPCNT()
@@ -5150,6 +6213,25 @@ u16* GPUEngineA::Get3DFramebufferRGBA5551() const
 	return this->_3DFramebufferRGBA5551;
 }
 
+FragmentColor* GPUEngineA::Get3DFramebufferPipelined() const
+{
+	return this->_3DFramebufferPipelined;
+}
+
+// Copies the renderer's finished frame into the buffer that the 3D layer is displayed from
+// when the 3D renderer is pipelined, so that the renderer is free to start on the next frame.
+void GPUEngineA::Latch3DFramebuffer()
+{
+	const FragmentColor *framebuffer3D = CurrentRenderer->GetFramebuffer();
+	if (framebuffer3D == NULL)
+	{
+		return;
+	}
+	
+	const NDSDisplayInfo &dispInfo = GPU->GetDisplayInfo();
+	memcpy(this->_3DFramebufferPipelined, framebuffer3D, dispInfo.customWidth * dispInfo.customHeight * sizeof(FragmentColor));
+}
+
 u16* GPUEngineA::GetCustomVRAMBlockPtr(const size_t blockID)
 {
 	return this->_VRAMCustomBlockPtr[blockID];
@@ -5161,11 +6243,15 @@ void GPUEngineA::SetCustomFramebufferSize(size_t w, size_t h)
 	
 	FragmentColor *oldColorRGBA6665Buffer = this->_3DFramebufferRGBA6665;
 	u16 *oldColorRGBA5551Buffer = this->_3DFramebufferRGBA5551;
+	FragmentColor *oldPipelinedBuffer = this->_3DFramebufferPipelined;
 	FragmentColor *newColorRGBA6665Buffer = (FragmentColor *)malloc_alignedCacheLine(w * h * sizeof(FragmentColor));
 	u16 *newColorRGBA5551 = (u16 *)malloc_alignedCacheLine(w * h * sizeof(u16));
+	FragmentColor *newPipelinedBuffer = (FragmentColor *)malloc_alignedCacheLine(w * h * sizeof(FragmentColor));
+	memset(newPipelinedBuffer, 0, w * h * sizeof(FragmentColor));
 	
 	this->_3DFramebufferRGBA6665 = newColorRGBA6665Buffer;
 	this->_3DFramebufferRGBA5551 = newColorRGBA5551;
+	this->_3DFramebufferPipelined = newPipelinedBuffer;
 	gfx3d_Update3DFramebuffers(this->_3DFramebufferRGBA6665, this->_3DFramebufferRGBA5551);
 	
 	this->_VRAMCustomBlockPtr[0] = GPU->GetCustomVRAMBuffer();
@@ -5175,6 +6261,7 @@ void GPUEngineA::SetCustomFramebufferSize(size_t w, size_t h)
 	
 	free_aligned(oldColorRGBA6665Buffer);
 	free_aligned(oldColorRGBA5551Buffer);
+	free_aligned(oldPipelinedBuffer);
 }
 
 bool GPUEngineA::WillRender3DLayer()
@@ -5278,10 +6365,95 @@ void GPUEngineA::RenderLine(const u16 l)
 	}
 }
 
+#ifdef ENABLE_AVX2_DISPATCH
+
+template <NDSColorFormat OUTPUTFORMAT, bool WILLPERFORMWINDOWTEST>
+FUNCTARGET_AVX2 void GPUEngineA::_RenderLine_Layer3D_AVX2(GPUEngineCompositorInfo &compInfo, const FragmentColor *__restrict &srcLinePtr, const size_t avxPixCount)
+{
+	for (; compInfo.target.xCustom < avxPixCount; srcLinePtr+=32, compInfo.target.xCustom+=32, compInfo.target.xNative = _gpuDstToSrcIndex[compInfo.target.xCustom], compInfo.target.lineColor16+=32, compInfo.target.lineColor32+=32, compInfo.target.lineLayerID+=32)
+	{
+		const __m256i src[4]	= { _mm256_loadu_si256((__m256i *)srcLinePtr + 0),
+								    _mm256_loadu_si256((__m256i *)srcLinePtr + 1),
+								    _mm256_loadu_si256((__m256i *)srcLinePtr + 2),
+								    _mm256_loadu_si256((__m256i *)srcLinePtr + 3) };
+		
+		// Determine which pixels pass by doing the alpha test and the window test. The packs
+		// work within each 128-bit lane, so put the 32-bit blocks back in pixel order.
+		__m256i srcAlpha = _mm256_packs_epi16( _mm256_packs_epi32(_mm256_srli_epi32(src[0], 24), _mm256_srli_epi32(src[1], 24)),
+											   _mm256_packs_epi32(_mm256_srli_epi32(src[2], 24), _mm256_srli_epi32(src[3], 24)) );
+		srcAlpha = _mm256_permutevar8x32_epi32(srcAlpha, _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7));
+		
+		__m256i passMask8;
+		__m256i enableColorEffectMask;
+		
+		if (WILLPERFORMWINDOWTEST)
+		{
+			// Do the window test.
+			passMask8 = _mm256_cmpeq_epi8( _mm256_loadu_si256((__m256i *)(this->_didPassWindowTestCustom[compInfo.renderState.selectedLayerID] + compInfo.target.xCustom)), _mm256_set1_epi8(1) );
+			enableColorEffectMask = _mm256_cmpeq_epi8( _mm256_loadu_si256((__m256i *)(this->_enableColorEffectCustom[compInfo.renderState.selectedLayerID] + compInfo.target.xCustom)), _mm256_set1_epi8(1) );
+		}
+		else
+		{
+			passMask8 = _mm256_set1_epi8(0xFF);
+			enableColorEffectMask = _mm256_set1_epi8(0xFF);
+		}
+		
+		// Do the alpha test. Pixels with an alpha value of 0 are rejected.
+		passMask8 = _mm256_andnot_si256(_mm256_cmpeq_epi8(srcAlpha, _mm256_setzero_si256()), passMask8);
+		
+		// If none of the pixels within the vector pass, then reject them all at once.
+		if (_mm256_movemask_epi8(passMask8) == 0)
+		{
+			continue;
+		}
+		
+		// Perform the blending function.
+		__m256i dstLayerID_vec256 = _mm256_loadu_si256((__m256i *)compInfo.target.lineLayerID);
+		
+		__m256i dst[4];
+		dst[0] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 0);
+		dst[1] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 1);
+		
+		if (OUTPUTFORMAT == NDSColorFormat_BGR555_Rev)
+		{
+			// Same as the SSE2 path, the converted 16-bit src colors go into the spare vectors.
+			dst[2] = _mm256_permute4x64_epi64( _mm256_packs_epi32(_mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(src[0], _mm256_set1_epi32(0x0000003E)), 1), _mm256_srli_epi32(_mm256_and_si256(src[0], _mm256_set1_epi32(0x00003E00)), 4)), _mm256_srli_epi32(_mm256_and_si256(src[0], _mm256_set1_epi32(0x003E0000)), 7)),
+																  _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(src[1], _mm256_set1_epi32(0x0000003E)), 1), _mm256_srli_epi32(_mm256_and_si256(src[1], _mm256_set1_epi32(0x00003E00)), 4)), _mm256_srli_epi32(_mm256_and_si256(src[1], _mm256_set1_epi32(0x003E0000)), 7))), 0xD8 );
+			dst[3] = _mm256_permute4x64_epi64( _mm256_packs_epi32(_mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(src[2], _mm256_set1_epi32(0x0000003E)), 1), _mm256_srli_epi32(_mm256_and_si256(src[2], _mm256_set1_epi32(0x00003E00)), 4)), _mm256_srli_epi32(_mm256_and_si256(src[2], _mm256_set1_epi32(0x003E0000)), 7)),
+																  _mm256_or_si256(_mm256_or_si256(_mm256_srli_epi32(_mm256_and_si256(src[3], _mm256_set1_epi32(0x0000003E)), 1), _mm256_srli_epi32(_mm256_and_si256(src[3], _mm256_set1_epi32(0x00003E00)), 4)), _mm256_srli_epi32(_mm256_and_si256(src[3], _mm256_set1_epi32(0x003E0000)), 7))), 0xD8 );
+		}
+		else
+		{
+			dst[2] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 2);
+			dst[3] = _mm256_loadu_si256((__m256i *)*compInfo.target.lineColor + 3);
+		}
+		
+		this->_RenderPixel3D_AVX2<OUTPUTFORMAT>(compInfo,
+												passMask8,
+												enableColorEffectMask,
+												src[3], src[2], src[1], src[0],
+												dst[3], dst[2], dst[1], dst[0],
+												dstLayerID_vec256);
+		
+		_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 0, dst[0]);
+		_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 1, dst[1]);
+		
+		if (OUTPUTFORMAT != NDSColorFormat_BGR555_Rev)
+		{
+			_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 2, dst[2]);
+			_mm256_storeu_si256((__m256i *)*compInfo.target.lineColor + 3, dst[3]);
+		}
+		
+		_mm256_storeu_si256((__m256i *)compInfo.target.lineLayerID, dstLayerID_vec256);
+	}
+}
+
+#endif
+
 template <NDSColorFormat OUTPUTFORMAT, bool WILLPERFORMWINDOWTEST>
 void GPUEngineA::RenderLine_Layer3D(GPUEngineCompositorInfo &compInfo)
 {
-	const FragmentColor *__restrict framebuffer3D = CurrentRenderer->GetFramebuffer();
+	const FragmentColor *__restrict framebuffer3D = (CommonSettings.GFX3D_Renderer_Pipelined) ? this->_3DFramebufferPipelined : CurrentRenderer->GetFramebuffer();
 	if (framebuffer3D == NULL)
 	{
 		return;
@@ -5326,6 +6498,12 @@ void GPUEngineA::RenderLine_Layer3D(GPUEngineCompositorInfo &compInfo)
 		{
 			compInfo.target.xNative = 0;
 			compInfo.target.xCustom = 0;
+#ifdef ENABLE_AVX2_DISPATCH
+			if (_gpuHostHasAVX2)
+			{
+				this->_RenderLine_Layer3D_AVX2<OUTPUTFORMAT, WILLPERFORMWINDOWTEST>(compInfo, srcLinePtr, compInfo.line.widthCustom - (compInfo.line.widthCustom % 32));
+			}
+#endif
 #ifdef ENABLE_SSE2
 			const size_t ssePixCount = compInfo.line.widthCustom - (compInfo.line.widthCustom % 16);
 			
@@ -5486,6 +6664,7 @@ void GPUEngineA::_RenderLine_DisplayCapture(const u16 l)
 	
 	const u16 *cap_src = (this->isLineCaptureNative[vramReadBlock][readLineIndexWithOffset]) ? (u16 *)MMU.blank_memory : GPU->GetCustomVRAMBlankBuffer();
 	u16 *cap_dst = this->_VRAMNativeBlockPtr[vramWriteBlock] + cap_dst_adr;
+	MMU_VRAMmarkDirtyRange((u8 *)cap_dst, CAPTURELENGTH * sizeof(u16));
 	
 	if (vramConfiguration.banks[vramReadBlock].purpose == VramConfiguration::LCDC)
 	{
@@ -6744,6 +7923,7 @@ void GPUEngineB::RenderLine(const u16 l)
 GPUSubsystem::GPUSubsystem()
 {
 	ColorspaceHandlerInit();
+	_gpuDetectHostSIMD();
 	
 	_defaultEventHandler = new GPUEventHandlerDefault;
 	_event = _defaultEventHandler;
@@ -6764,6 +7944,10 @@ GPUSubsystem::GPUSubsystem()
 	_willAutoApplyMasterBrightness = true;
 	_willAutoConvertRGB666ToRGB888 = true;
 	_willAutoResolveToCustomBuffer = true;
+	_willRenderEnginesInParallel = false;
+	
+	_asyncEngineSubTask = new Task;
+	_asyncEngineSubLine = 0;
 	
 	OSDCLASS *previousOSD = osd;
 	osd = new OSDCLASS(-1);
@@ -6801,6 +7985,10 @@ GPUSubsystem::GPUSubsystem()
 
 GPUSubsystem::~GPUSubsystem()
 {
+	this->_asyncEngineSubTask->finish();
+	this->_asyncEngineSubTask->shutdown();
+	delete this->_asyncEngineSubTask;
+	
 	delete osd;
 	osd = NULL;
 	
@@ -6896,13 +8084,33 @@ void GPUSubsystem::ForceRender3DFinishAndFlush(bool willFlush)
 	CurrentRenderer->SetFramebufferFlushStates(need3DDisplayFramebuffer, need3DCaptureFramebuffer);
 }
 
+// Finishes the 3D render that is running and marks it as done. Every path that ends a render
+// goes through here, so that when the 3D renderer is pipelined, the frame that was just
+// finished is always the one that the 3D layer is displayed from next.
+void GPUSubsystem::FinishRender3D(bool willFlush3DDisplayFramebuffer, bool willFlush3DCaptureFramebuffer)
+{
+	bool need3DDisplayFramebuffer;
+	bool need3DCaptureFramebuffer;
+	CurrentRenderer->GetFramebufferFlushStates(need3DDisplayFramebuffer, need3DCaptureFramebuffer);
+	
+	CurrentRenderer->SetFramebufferFlushStates(willFlush3DDisplayFramebuffer, willFlush3DCaptureFramebuffer);
+	CurrentRenderer->RenderFinish();
+	CurrentRenderer->SetFramebufferFlushStates(need3DDisplayFramebuffer, need3DCaptureFramebuffer);
+	
+	if (CommonSettings.GFX3D_Renderer_Pipelined)
+	{
+		this->_engineMain->Latch3DFramebuffer();
+	}
+	
+	CurrentRenderer->SetRenderNeedsFinish(false);
+	this->_event->DidRender3DEnd();
+}
+
 void GPUSubsystem::ForceFrameStop()
 {
 	if (CurrentRenderer->GetRenderNeedsFinish())
 	{
-		this->ForceRender3DFinishAndFlush(true);
-		CurrentRenderer->SetRenderNeedsFinish(false);
-		this->_event->DidRender3DEnd();
+		this->FinishRender3D(true, true);
 	}
 	
 	if (this->_frameNeedsFinish)
@@ -7336,12 +8544,48 @@ void GPUSubsystem::SetWillAutoResolveToCustomBuffer(const bool willAutoResolve)
 	this->_willAutoResolveToCustomBuffer = willAutoResolve;
 }
 
+bool GPUSubsystem::GetWillRenderEnginesInParallel() const
+{
+	return this->_willRenderEnginesInParallel;
+}
+
+void GPUSubsystem::SetWillRenderEnginesInParallel(const bool willRenderInParallel)
+{
+	if (willRenderInParallel)
+	{
+		this->_asyncEngineSubTask->start(false);
+	}
+	else
+	{
+		this->_asyncEngineSubTask->finish();
+		this->_asyncEngineSubTask->shutdown();
+	}
+	
+	this->_willRenderEnginesInParallel = willRenderInParallel;
+}
+
+template <NDSColorFormat OUTPUTFORMAT>
+static void* GPUSubsystem_RunRenderLineEngineSub(void *arg)
+{
+	GPUSubsystem *gpuSubsystem = (GPUSubsystem *)arg;
+	gpuSubsystem->RenderLineEngineSub<OUTPUTFORMAT>();
+	
+	return NULL;
+}
+
+template <NDSColorFormat OUTPUTFORMAT>
+void GPUSubsystem::RenderLineEngineSub()
+{
+	this->_engineSub->RenderLine<OUTPUTFORMAT>(this->_asyncEngineSubLine);
+}
+
 template <NDSColorFormat OUTPUTFORMAT>
 void GPUSubsystem::RenderLine(const u16 l, bool isFrameSkipRequested)
 {
 	const bool isDisplayCaptureNeeded = this->_engineMain->WillDisplayCapture(l);
 	const bool isFramebufferRenderNeeded[2]	= { CommonSettings.showGpu.main && !this->_engineMain->GetIsMasterBrightFullIntensity(),
 											    CommonSettings.showGpu.sub && !this->_engineSub->GetIsMasterBrightFullIntensity() };
+	const bool willRenderEngineSub = isFramebufferRenderNeeded[GPUEngineID_Sub] && !isFrameSkipRequested;
 	
 	if (!this->_frameNeedsFinish)
 	{
@@ -7358,6 +8602,16 @@ void GPUSubsystem::RenderLine(const u16 l, bool isFrameSkipRequested)
 		}
 	}
 	
+	// The sub engine only reads its own registers and VRAM banks, which can't be mapped to the
+	// main engine or be the target of a display capture at the same time, so it can render
+	// alongside the main engine.
+	const bool willRenderEngineSubAsync = willRenderEngineSub && this->_willRenderEnginesInParallel;
+	if (willRenderEngineSubAsync)
+	{
+		this->_asyncEngineSubLine = l;
+		this->_asyncEngineSubTask->execute(&GPUSubsystem_RunRenderLineEngineSub<OUTPUTFORMAT>, this);
+	}
+	
 	if ( (isFramebufferRenderNeeded[GPUEngineID_Main] || isDisplayCaptureNeeded) && !isFrameSkipRequested )
 	{
 		// GPUEngineA:WillRender3DLayer() and GPUEngineA:WillCapture3DLayerDirect() both rely on register
@@ -7375,12 +8629,11 @@ void GPUSubsystem::RenderLine(const u16 l, bool isFrameSkipRequested)
 			const bool need3DDisplayFramebuffer = this->_engineMain->WillRender3DLayer();
 			const bool need3DCaptureFramebuffer = this->_engineMain->WillCapture3DLayerDirect(l);
 			
-			if (need3DDisplayFramebuffer || need3DCaptureFramebuffer)
+			// When the 3D renderer is pipelined, the display reads the last finished 3D frame,
+			// and only a capture of the 3D layer needs to wait for the current render.
+			if ( (need3DDisplayFramebuffer && !CommonSettings.GFX3D_Renderer_Pipelined) || need3DCaptureFramebuffer )
 			{
-				CurrentRenderer->SetFramebufferFlushStates(need3DDisplayFramebuffer, need3DCaptureFramebuffer);
-				CurrentRenderer->RenderFinish();
-				CurrentRenderer->SetRenderNeedsFinish(false);
-				this->_event->DidRender3DEnd();
+				this->FinishRender3D(need3DDisplayFramebuffer, need3DCaptureFramebuffer);
 			}
 		}
 		
@@ -7391,7 +8644,11 @@ void GPUSubsystem::RenderLine(const u16 l, bool isFrameSkipRequested)
 		this->_engineMain->UpdatePropertiesWithoutRender(l);
 	}
 	
-	if (isFramebufferRenderNeeded[GPUEngineID_Sub] && !isFrameSkipRequested)
+	if (willRenderEngineSubAsync)
+	{
+		this->_asyncEngineSubTask->finish();
+	}
+	else if (willRenderEngineSub)
 	{
 		this->_engineSub->RenderLine<OUTPUTFORMAT>(l);
 	}
@@ -57,6 +57,7 @@
 
 class GPUEngineBase;
 class EMUFILE;
+class Task;
 struct MMU_struct;
 
 //#undef FORCEINLINE
@@ -1381,6 +1382,26 @@ protected:
 	template<NDSColorFormat OUTPUTFORMAT> FORCEINLINE void _RenderPixel3D_SSE2(GPUEngineCompositorInfo &compInfo, const __m128i &passMask8, const __m128i &enableColorEffectMask, const __m128i &src3, const __m128i &src2, const __m128i &src1, const __m128i &src0, __m128i &dst3, __m128i &dst2, __m128i &dst1, __m128i &dst0, __m128i &dstLayerID);
 #endif
 	
+#ifdef ENABLE_AVX2_DISPATCH
+	template<NDSColorFormat COLORFORMAT> FUNCTARGET_AVX2 FORCEINLINE __m256i _ColorEffectBlend(const __m256i &colA, const __m256i &colB, const __m256i &blendEVA, const __m256i &blendEVB);
+	template<NDSColorFormat COLORFORMATB> FUNCTARGET_AVX2 FORCEINLINE __m256i _ColorEffectBlend3D(const __m256i &colA_Lo, const __m256i &colA_Hi, const __m256i &colB);
+	template<NDSColorFormat COLORFORMAT> FUNCTARGET_AVX2 FORCEINLINE __m256i _ColorEffectIncreaseBrightness(const __m256i &col, const __m256i &blendEVY);
+	template<NDSColorFormat COLORFORMAT> FUNCTARGET_AVX2 FORCEINLINE __m256i _ColorEffectDecreaseBrightness(const __m256i &col, const __m256i &blendEVY);
+	template<NDSColorFormat OUTPUTFORMAT, bool ISDEBUGRENDER, bool WILLPERFORMWINDOWTEST, bool COLOREFFECTDISABLEDHINT> FUNCTARGET_AVX2 FORCEINLINE void _RenderPixel32_AVX2(GPUEngineCompositorInfo &compInfo, const __m256i &src3, const __m256i &src2, const __m256i &src1, const __m256i &src0, const __m256i &srcEffectEnableMask, __m256i &dst3, __m256i &dst2, __m256i &dst1, __m256i &dst0, __m256i &dstLayerID, __m256i &passMask8);
+	template<NDSColorFormat OUTPUTFORMAT> FUNCTARGET_AVX2 FORCEINLINE void _RenderPixel3D_AVX2(GPUEngineCompositorInfo &compInfo, const __m256i &passMask8, const __m256i &enableColorEffectMask, const __m256i &src3, const __m256i &src2, const __m256i &src1, const __m256i &src0, __m256i &dst3, __m256i &dst2, __m256i &dst1, __m256i &dst0, __m256i &dstLayerID);
+	template<NDSColorFormat OUTPUTFORMAT, bool ISDEBUGRENDER, bool WILLPERFORMWINDOWTEST, bool COLOREFFECTDISABLEDHINT> FUNCTARGET_AVX2 void _RenderPixelsCustom_AVX2(GPUEngineCompositorInfo &compInfo, const size_t avxPixCount);
+	template<NDSColorFormat OUTPUTFORMAT, bool ISDEBUGRENDER, bool WILLPERFORMWINDOWTEST, bool COLOREFFECTDISABLEDHINT> FUNCTARGET_AVX2 size_t _RenderPixelsCustomVRAM_AVX2(GPUEngineCompositorInfo &compInfo, const u16 *__restrict srcLine, const size_t avxPixCount);
+	template<NDSColorFormat OUTPUTFORMAT, GPUMasterBrightMode MODE> FUNCTARGET_AVX2 size_t _ApplyMasterBrightness_AVX2(void *dst, const size_t pixCount, const u16 intensity);
+	FUNCTARGET_AVX2 size_t _PerformWindowTesting_AVX2(GPUEngineCompositorInfo &compInfo, const size_t layerID);
+#endif
+	
+#ifdef ENABLE_AVX512_DISPATCH
+	template<NDSColorFormat COLORFORMAT> FUNCTARGET_AVX512 FORCEINLINE __m512i _ColorEffectIncreaseBrightness(const __m512i &col, const __m512i &blendEVY);
+	template<NDSColorFormat COLORFORMAT> FUNCTARGET_AVX512 FORCEINLINE __m512i _ColorEffectDecreaseBrightness(const __m512i &col, const __m512i &blendEVY);
+	template<NDSColorFormat OUTPUTFORMAT, GPUMasterBrightMode MODE> FUNCTARGET_AVX512 size_t _ApplyMasterBrightness_AVX512(void *dst, const size_t pixCount, const u16 intensity);
+	FUNCTARGET_AVX512 size_t _PerformWindowTesting_AVX512(GPUEngineCompositorInfo &compInfo, const size_t layerID);
+#endif
+	
 	template<bool ISDEBUGRENDER> void _RenderSpriteBMP(GPUEngineCompositorInfo &compInfo, const u8 spriteNum, u16 *__restrict dst, const u32 srcadr, u8 *__restrict dst_alpha, u8 *__restrict typeTab, u8 *__restrict prioTab, const u8 prio, const size_t lg, size_t sprX, size_t x, const s32 xdir, const u8 alpha);
 	template<bool ISDEBUGRENDER> void _RenderSprite256(GPUEngineCompositorInfo &compInfo, const u8 spriteNum, u16 *__restrict dst, const u32 srcadr, const u16 *__restrict pal, u8 *__restrict dst_alpha, u8 *__restrict typeTab, u8 *__restrict prioTab, const u8 prio, const size_t lg, size_t sprX, size_t x, const s32 xdir, const u8 alpha);
 	template<bool ISDEBUGRENDER> void _RenderSprite16(GPUEngineCompositorInfo &compInfo, const u8 spriteNum, u16 *__restrict dst, const u32 srcadr, const u16 *__restrict pal, u8 *__restrict dst_alpha, u8 *__restrict typeTab, u8 *__restrict prioTab, const u8 prio, const size_t lg, size_t sprX, size_t x, const s32 xdir, const u8 alpha);
@@ -1484,6 +1505,7 @@ protected:
 	
 	FragmentColor *_3DFramebufferRGBA6665;
 	u16 *_3DFramebufferRGBA5551;
+	FragmentColor *_3DFramebufferPipelined;		// The last finished 3D frame, which is displayed while the renderer works on the next one.
 	
 	u16 *_VRAMNativeBlockPtr[4];
 	u16 *_VRAMCustomBlockPtr[4];
@@ -1505,6 +1527,10 @@ protected:
 	template<NDSColorFormat COLORFORMAT> __m128i _RenderLine_DispCapture_BlendFunc_SSE2(const __m128i &srcA, const __m128i &srcB, const __m128i &blendEVA, const __m128i &blendEVB);
 #endif
 	
+#ifdef ENABLE_AVX2_DISPATCH
+	template<NDSColorFormat OUTPUTFORMAT, bool WILLPERFORMWINDOWTEST> FUNCTARGET_AVX2 void _RenderLine_Layer3D_AVX2(GPUEngineCompositorInfo &compInfo, const FragmentColor *__restrict &srcLinePtr, const size_t avxPixCount);
+#endif
+	
 	template<NDSColorFormat OUTPUTFORMAT, bool CAPTUREFROMNATIVESRCA, bool CAPTUREFROMNATIVESRCB>
 	void _RenderLine_DispCapture_BlendToCustomDstBuffer(const void *srcA, const void *srcB, void *dst, const u8 blendEVA, const u8 blendEVB, const size_t length, size_t l); // Do not use restrict pointers, since srcB and dst can be the same
 	
@@ -1525,6 +1551,8 @@ public:
 	u16* GetCustomVRAMBlockPtr(const size_t blockID);
 	FragmentColor* Get3DFramebufferRGBA6665() const;
 	u16* Get3DFramebufferRGBA5551() const;
+	FragmentColor* Get3DFramebufferPipelined() const;
+	void Latch3DFramebuffer();
 	virtual void SetCustomFramebufferSize(size_t w, size_t h);
 	
 	bool WillRender3DLayer();
@@ -1614,9 +1642,13 @@ private:
 	bool _willAutoApplyMasterBrightness;
 	bool _willAutoConvertRGB666ToRGB888;
 	bool _willAutoResolveToCustomBuffer;
+	bool _willRenderEnginesInParallel;
 	u16 *_customVRAM;
 	u16 *_customVRAMBlank;
 	
+	Task *_asyncEngineSubTask;
+	u16 _asyncEngineSubLine;
+	
 	CACHE_ALIGN FragmentColor _nativeFramebuffer[GPU_FRAMEBUFFER_NATIVE_WIDTH * GPU_FRAMEBUFFER_NATIVE_HEIGHT * 2];
 	void *_customFramebuffer;
 	
@@ -1633,6 +1665,7 @@ public:
 	
 	void Reset();
 	void ForceRender3DFinishAndFlush(bool willFlush);
+	void FinishRender3D(bool willFlush3DDisplayFramebuffer, bool willFlush3DCaptureFramebuffer);
 	void ForceFrameStop();
 	
 	const NDSDisplayInfo& GetDisplayInfo(); // Frontends need to call this whenever they need to read the video buffers from the emulator core
@@ -1694,7 +1727,19 @@ public:
 	bool GetWillAutoResolveToCustomBuffer() const;
 	void SetWillAutoResolveToCustomBuffer(const bool willAutoResolve);
 	
+	// By default, the main and sub engines render each line one after the other on the
+	// emulation thread.
+	//
+	// If SetWillRenderEnginesInParallel() is passed "true", then the sub engine renders
+	// each line on a worker thread while the main engine renders the same line on the
+	// emulation thread. Both engines finish the line before RenderLine() returns, so the
+	// emulation sees the same results either way. The thread handoff happens once per
+	// line, so this mostly pays off at larger custom framebuffer sizes.
+	bool GetWillRenderEnginesInParallel() const;
+	void SetWillRenderEnginesInParallel(const bool willRenderInParallel);
+	
 	template<NDSColorFormat OUTPUTFORMAT> void RenderLine(const u16 l, bool skip = false);
+	template<NDSColorFormat OUTPUTFORMAT> void RenderLineEngineSub();
 	void ClearWithColor(const u16 colorBGRA5551);
 };
 
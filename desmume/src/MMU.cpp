@@ -285,6 +285,18 @@ u8 vram_arm9_map[VRAM_ARM9_PAGES];
 //this chooses which banks are mapped in the 128K banks starting at 0x06000000 in ARM7
 u8 vram_arm7_map[2];
 
+//write stamps for each 2KB block of the LCDC buffer, and for each texture and texture palette slot
+u64 vram_write_clock;
+u64 vram_dirty_block[VRAM_DIRTY_BLOCKS];
+u64 vram_texslot_stamp[4];
+u64 vram_texpalslot_stamp[6];
+
+//write stamps for each 2KB block of main memory
+u64 mainmem_write_clock;
+u64 mainmem_dirty_block[MAINMEM_DIRTY_BLOCKS];
+
+u8 *MMU_fastmem_map[2][MMU_FASTMEM_PAGES];
+
 //----->
 //consider these later, for better recordkeeping, instead of using the u8* in MMU
 
@@ -456,6 +468,48 @@ static FORCEINLINE u32 MMU_LCDmap(u32 addr, bool& unmapped, bool& restricted)
 		return LCDC_HACKY_LOCATION + (vram_page<<14) + ofs;
 }
 
+//fills in the fastmem pages for one 16MB region of the bus (only 0x03 and 0x06 go through MMU_LCDmap).
+//a page is only taken if both of its ends translate to host memory 16KB apart; that leaves out
+//unmapped pages and the LCDC mirroring above 0x068A4000, which the slow handlers keep dealing with.
+template<int PROCNUM>
+static void MMU_fastmemMapRegion(const u32 region)
+{
+	u8 **map = &MMU_fastmem_map[PROCNUM][(region << 24) >> 14];
+
+	for(u32 i=0;i<(0x01000000>>14);i++)
+	{
+		map[i] = NULL;
+		if(!CommonSettings.fastmem) continue;
+
+		const u32 adr = (region << 24) + (i << 14);
+		bool unmapped, restricted;
+		const u32 first = MMU_LCDmap<PROCNUM>(adr, unmapped, restricted);
+		if(unmapped) continue;
+		const u32 last = MMU_LCDmap<PROCNUM>(adr + 0x3FFF, unmapped, restricted);
+		if(unmapped) continue;
+
+		u8 *firstPtr = MMU.MMU_MEM[PROCNUM][first>>20] + (first & MMU.MMU_MASK[PROCNUM][first>>20]);
+		u8 *lastPtr = MMU.MMU_MEM[PROCNUM][last>>20] + (last & MMU.MMU_MASK[PROCNUM][last>>20]);
+		if(lastPtr - firstPtr == 0x3FFF)
+			map[i] = firstPtr;
+	}
+}
+
+void MMU_fastmemRebuild()
+{
+	memset(MMU_fastmem_map, 0, sizeof(MMU_fastmem_map));
+
+	//ITCM is mirrored all the way up to main memory, regardless of the cp15 settings
+	if(CommonSettings.fastmem)
+		for(u32 i=0;i<(0x02000000>>14);i++)
+			MMU_fastmem_map[ARMCPU_ARM9][i] = MMU.ARM9_ITCM + ((i&1)<<14);
+
+	MMU_fastmemMapRegion<ARMCPU_ARM9>(0x03);
+	MMU_fastmemMapRegion<ARMCPU_ARM9>(0x06);
+	MMU_fastmemMapRegion<ARMCPU_ARM7>(0x03);
+	MMU_fastmemMapRegion<ARMCPU_ARM7>(0x06);
+}
+
 
 #define LOG_VRAM_ERROR() LOG("No data for block %i MST %i\n", block, VRAMBankCnt & 0x07);
 
@@ -783,12 +837,82 @@ void MMU_VRAM_unmap_all()
 		MMU.texInfo.textureSlotAddr[i] = MMU.blank_memory;
 }
 
+void MMU_VRAMmarkDirtyRange(const u8 *ptr, const size_t len)
+{
+	if (len == 0)
+		return;
+
+	const size_t ofs = ptr - MMU.ARM9_LCD;
+	const size_t firstBlock = ofs >> VRAM_DIRTY_BLOCK_SHIFT;
+	const size_t lastBlock = (ofs + len - 1) >> VRAM_DIRTY_BLOCK_SHIFT;
+
+	for (size_t i = firstBlock; i <= lastBlock && i < VRAM_DIRTY_BLOCKS; i++)
+		vram_dirty_block[i] = vram_write_clock;
+}
+
+//used whenever VRAM gets replaced wholesale, like on a reset or a savestate load
+void MMU_VRAMmarkAllDirty()
+{
+	for (size_t i = 0; i < VRAM_DIRTY_BLOCKS; i++)
+		vram_dirty_block[i] = vram_write_clock;
+	for (size_t i = 0; i < 4; i++)
+		vram_texslot_stamp[i] = vram_write_clock;
+	for (size_t i = 0; i < 6; i++)
+		vram_texpalslot_stamp[i] = vram_write_clock;
+}
+
+void MMU_mainMemMarkDirtyRange(const u32 addr, const u32 len)
+{
+	if (len == 0)
+		return;
+
+	const u32 firstBlock = (addr & _MMU_MAIN_MEM_MASK) >> MAINMEM_DIRTY_BLOCK_SHIFT;
+	const u32 lastBlock = ((addr & _MMU_MAIN_MEM_MASK) + len - 1) >> MAINMEM_DIRTY_BLOCK_SHIFT;
+
+	for (u32 i = firstBlock; i <= lastBlock && i < MAINMEM_DIRTY_BLOCKS; i++)
+		mainmem_dirty_block[i] = mainmem_write_clock;
+}
+
+//used whenever main memory gets replaced wholesale, like on a reset or a savestate load
+void MMU_mainMemMarkAllDirty()
+{
+	for (size_t i = 0; i < MAINMEM_DIRTY_BLOCKS; i++)
+		mainmem_dirty_block[i] = mainmem_write_clock;
+}
+
+bool MMU_VRAMchangedSince(const u8 *ptr, const size_t len, const u64 stamp)
+{
+	if (len == 0)
+		return false;
+
+	const size_t ofs = ptr - MMU.ARM9_LCD;
+	const size_t firstBlock = ofs >> VRAM_DIRTY_BLOCK_SHIFT;
+	const size_t lastBlock = (ofs + len - 1) >> VRAM_DIRTY_BLOCK_SHIFT;
+
+	//anything outside of the LCDC buffer can't be tracked, so assume that it changed
+	if (ptr < MMU.ARM9_LCD || lastBlock >= VRAM_DIRTY_BLOCKS)
+		return true;
+
+	for (size_t i = firstBlock; i <= lastBlock; i++)
+	{
+		if (vram_dirty_block[i] >= stamp)
+			return true;
+	}
+
+	return false;
+}
+
 static inline void MMU_VRAMmapControl(u8 block, u8 VRAMBankCnt)
 {
 	//handle WRAM, first of all
 	if(block == 7)
 	{
 		MMU.WRAMCNT = VRAMBankCnt & 3;
+		if(CommonSettings.fastmem)
+		{
+			MMU_fastmemMapRegion<ARMCPU_ARM9>(0x03);
+			MMU_fastmemMapRegion<ARMCPU_ARM7>(0x03);
+		}
 		return;
 	}
 
@@ -827,12 +951,27 @@ static inline void MMU_VRAMmapControl(u8 block, u8 VRAMBankCnt)
 	MMU_VRAMmapRefreshBank<VRAM_BANK_C>();
 	MMU_VRAMmapRefreshBank<VRAM_BANK_D>();
 
+	//the pages are all NULL without fastmem, since MMU_fastmemRebuild() at reset
+	if(CommonSettings.fastmem)
+	{
+		MMU_fastmemMapRegion<ARMCPU_ARM9>(0x06);
+		MMU_fastmemMapRegion<ARMCPU_ARM7>(0x06);
+	}
+
 	//printf(vramConfiguration.describe().c_str());
 	//printf("vram remapped at vcount=%d\n",nds.VCount);
 
 	//if texInfo changed, trigger notifications
 	if(memcmp(&oldTexInfo,&MMU.texInfo,sizeof(MMU_struct::TextureInfo)))
 	{
+		//stamp the slots that now point somewhere else, so that anything copied out of them gets rechecked
+		for(int i=0;i<4;i++)
+			if(oldTexInfo.textureSlotAddr[i] != MMU.texInfo.textureSlotAddr[i])
+				vram_texslot_stamp[i] = vram_write_clock;
+		for(int i=0;i<6;i++)
+			if(oldTexInfo.texPalSlot[i] != MMU.texInfo.texPalSlot[i])
+				vram_texpalslot_stamp[i] = vram_write_clock;
+
 		//if(!nds.isIn3dVblank())
 	//		PROGINFO("Changing texture or texture palette mappings outside of 3d vblank\n");
 		CurrentRenderer->VramReconfigureSignal();
@@ -1005,6 +1144,9 @@ void MMU_Reset()
 	T1WriteWord(MMU.ARM7_REG, 0x304, 0x0001);
 	
 	MMU_VRAM_unmap_all();
+	MMU_VRAMmarkAllDirty();
+	MMU_mainMemMarkAllDirty();
+	MMU_fastmemRebuild();
 
 	MMU.powerMan_CntReg = 0x00;
 	MMU.powerMan_CntRegWritten = FALSE;
@@ -1063,7 +1205,7 @@ static void execsqrt() {
 	MMU.sqrtCycles = nds_timer + 26;
 	MMU.sqrtResult = ret;
 	MMU.sqrtRunning = TRUE;
-	NDS_Reschedule();
+	NDS_RescheduleDivSqrt();
 }
 
 static void execdiv() {
@@ -1122,7 +1264,7 @@ static void execdiv() {
 	MMU.divResult = res;
 	MMU.divMod = mod;
 	MMU.divRunning = TRUE;
-	NDS_Reschedule();
+	NDS_RescheduleDivSqrt();
 }
 
 DSI_TSC::DSI_TSC()
@@ -2240,6 +2382,132 @@ void DmaController::exec()
 	driver->DEBUG_UpdateIORegView(BaseDriver::EDEBUG_IOREG_DMA);
 }
 
+//maps [adr, adr+len) for a DMA access, provided that it is plain memory within one 16KB page: main memory,
+//WRAM, VRAM, and on the ARM9 also palette and OAM. returns NULL for anything that has to go through the
+//regular handlers one unit at a time, including the TCMs (which DMA can't see) and unmapped VRAM.
+//mapped receives the address that the handlers would use for JIT invalidation and VRAM dirty tracking.
+template<int PROCNUM>
+static u8* DMA_bulkMap(const u32 adr, const u32 len, u32 &mapped)
+{
+	if(PROCNUM==ARMCPU_ARM9 && (adr & ~0x3FFF) == MMU.DTCMRegion)
+		return NULL;
+
+	switch(adr >> 24)
+	{
+		case 0x02:
+			mapped = adr;
+			return MMU.MAIN_MEM + (adr & _MMU_MAIN_MEM_MASK);
+		case 0x05:
+		case 0x07:
+			if(PROCNUM==ARMCPU_ARM7) return NULL;
+			break;
+		case 0x03:
+		case 0x06:
+			break;
+		default:
+			return NULL;
+	}
+
+	bool unmapped, restricted;
+	const u32 first = MMU_LCDmap<PROCNUM>(adr, unmapped, restricted);
+	if(unmapped) return NULL;
+	const u32 last = MMU_LCDmap<PROCNUM>(adr + len - 1, unmapped, restricted);
+	if(unmapped) return NULL;
+
+	//palette and OAM mirror every 2KB, and the LCDC mirroring doesn't keep offsets, so make sure the span is contiguous
+	u8 *ptr = MMU.MMU_MEM[PROCNUM][first>>20] + (first & MMU.MMU_MASK[PROCNUM][first>>20]);
+	if(MMU.MMU_MEM[PROCNUM][last>>20] + (last & MMU.MMU_MASK[PROCNUM][last>>20]) != ptr + len - 1)
+		return NULL;
+
+	mapped = first;
+	return ptr;
+}
+
+//does the same to the destination of a bulk copy that the write handlers do for every unit
+template<int PROCNUM>
+static void DMA_bulkWritten(const u32 mapped, u8 *ptr, const u32 len)
+{
+#ifdef HAVE_JIT
+	if((mapped >> 24) == 0x02)
+		memset(&JIT_COMPILED_FUNC_KNOWNBANK(mapped, MAIN_MEM, _MMU_MAIN_MEM_MASK, 0), 0, (len>>1) * sizeof(uintptr_t));
+	else if(JIT_MAPPED(mapped, PROCNUM))
+		memset(&JIT_COMPILED_FUNC_PREMASKED(mapped, PROCNUM, 0), 0, (len>>1) * sizeof(uintptr_t));
+#endif
+
+	if((mapped >> 24) == 0x02)
+		MMU_mainMemMarkDirtyRange(mapped, len);
+	else if((mapped >> 24) == 0x06)
+		MMU_VRAMmarkDirtyRange(ptr, len);
+}
+
+template<int PROCNUM, int SIZE>
+static int DMA_copy(u32 &src, u32 &dst, const u32 srcinc, const u32 dstinc, u32 todo)
+{
+	const u32 sz = SIZE >> 3;
+	int time_elapsed = 0;
+
+	//incrementing copies between plain memory are done a page at a time with memmove.
+	//the access time of a DMA only depends on the region, so it can be worked out once per page.
+	bool bulk = (srcinc == sz) && (dstinc == sz) && !((src | dst) & (sz-1));
+#ifdef HAVE_LUA
+	if(hookedRegions[LUAMEMHOOK_READ].NotEmpty() || hookedRegions[LUAMEMHOOK_WRITE].NotEmpty())
+		bulk = false;
+#endif
+	if(CheckDebugEvent(DEBUG_EVENT_READ) || CheckDebugEvent(DEBUG_EVENT_WRITE))
+		bulk = false;
+
+	while(todo > 0)
+	{
+		u32 n = todo;
+
+		if(bulk)
+		{
+			//stop at the next page boundary on either side
+			n = std::min(n, (0x4000 - (src & 0x3FFF)) / sz);
+			n = std::min(n, (0x4000 - (dst & 0x3FFF)) / sz);
+
+			const u32 len = n * sz;
+			u32 srcMapped, dstMapped;
+			u8 *srcPtr = DMA_bulkMap<PROCNUM>(src, len, srcMapped);
+			u8 *dstPtr = srcPtr ? DMA_bulkMap<PROCNUM>(dst, len, dstMapped) : NULL;
+
+			//a destination that overlaps the source from above would pick up its own writes
+			if(dstPtr && (dstPtr <= srcPtr || dstPtr >= srcPtr + len))
+			{
+				time_elapsed += n * (_MMU_accesstime<PROCNUM,MMU_AT_DMA,SIZE,MMU_AD_READ,TRUE>(src,true)
+				                   + _MMU_accesstime<PROCNUM,MMU_AT_DMA,SIZE,MMU_AD_WRITE,TRUE>(dst,true));
+				memmove(dstPtr, srcPtr, len);
+				DMA_bulkWritten<PROCNUM>(dstMapped, dstPtr, len);
+				src += len;
+				dst += len;
+				todo -= n;
+				continue;
+			}
+		}
+
+		for(u32 i = n; i > 0; i--)
+		{
+			time_elapsed += _MMU_accesstime<PROCNUM,MMU_AT_DMA,SIZE,MMU_AD_READ,TRUE>(src,true);
+			time_elapsed += _MMU_accesstime<PROCNUM,MMU_AT_DMA,SIZE,MMU_AD_WRITE,TRUE>(dst,true);
+			if(SIZE == 32)
+			{
+				u32 temp = _MMU_read32(PROCNUM,MMU_AT_DMA,src);
+				_MMU_write32(PROCNUM,MMU_AT_DMA,dst, temp);
+			}
+			else
+			{
+				u16 temp = _MMU_read16(PROCNUM,MMU_AT_DMA,src);
+				_MMU_write16(PROCNUM,MMU_AT_DMA,dst, temp);
+			}
+			dst += dstinc;
+			src += srcinc;
+		}
+		todo -= n;
+	}
+
+	return time_elapsed;
+}
+
 template<int PROCNUM>
 void DmaController::doCopy()
 {
@@ -2291,31 +2559,12 @@ void DmaController::doCopy()
 	//if these do not use MMU_AT_DMA and the corresponding code in the read/write routines,
 	//then danny phantom title screen will be filled with a garbage char which is made by
 	//dmaing from 0x00000000 to 0x06000000
-	//TODO - these might be losing out a lot by not going through the templated version anymore.
-	//we might make another function to do just the raw copy op which can use them with checks
-	//outside the loop
-	int time_elapsed = 0;
-	if(sz==4) {
-		for(s32 i=(s32)todo; i>0; i--)
-		{
-			time_elapsed += _MMU_accesstime<PROCNUM,MMU_AT_DMA,32,MMU_AD_READ,TRUE>(src,true);
-			time_elapsed += _MMU_accesstime<PROCNUM,MMU_AT_DMA,32,MMU_AD_WRITE,TRUE>(dst,true);
-			u32 temp = _MMU_read32(procnum,MMU_AT_DMA,src);
-			_MMU_write32(procnum,MMU_AT_DMA,dst, temp);
-			dst += dstinc;
-			src += srcinc;
-		}
-	} else {
-		for(s32 i=(s32)todo; i>0; i--)
-		{
-			time_elapsed += _MMU_accesstime<PROCNUM,MMU_AT_DMA,16,MMU_AD_READ,TRUE>(src,true);
-			time_elapsed += _MMU_accesstime<PROCNUM,MMU_AT_DMA,16,MMU_AD_WRITE,TRUE>(dst,true);
-			u16 temp = _MMU_read16(procnum,MMU_AT_DMA,src);
-			_MMU_write16(procnum,MMU_AT_DMA,dst, temp);
-			dst += dstinc;
-			src += srcinc;
-		}
-	}
+	//(DMA_copy only takes the bulk path for memory where MMU_AT_DMA makes no difference)
+	int time_elapsed;
+	if(sz==4)
+		time_elapsed = DMA_copy<PROCNUM,32>(src, dst, srcinc, dstinc, todo);
+	else
+		time_elapsed = DMA_copy<PROCNUM,16>(src, dst, srcinc, dstinc, todo);
 
 	//printf("ARM%c dma of size %d from 0x%08X to 0x%08X took %d cycles\n",PROCNUM==0?'9':'7',todo*sz,saddr,daddr,time_elapsed);
 
@@ -2369,7 +2618,7 @@ void DmaController::doSchedule()
 {
 	dmaCheck = TRUE;
 	nextEvent = nds_timer;
-	NDS_RescheduleDMA();
+	NDS_RescheduleDMA(procnum, chan);
 }
 
 
@@ -3663,6 +3912,9 @@ void FASTCALL _MMU_ARM9_write08(u32 adr, u8 val)
 		JIT_COMPILED_FUNC_PREMASKED(adr, ARMCPU_ARM9, 0) = 0;
 #endif
 
+	if ((adr >> 24) == 0x06)
+		MMU_VRAMmarkDirty(adr - LCDC_HACKY_LOCATION);
+
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	MMU.MMU_MEM[ARMCPU_ARM9][adr>>20][adr&MMU.MMU_MASK[ARMCPU_ARM9][adr>>20]]=val;
 }
@@ -4239,6 +4491,9 @@ void FASTCALL _MMU_ARM9_write16(u32 adr, u16 val)
 		JIT_COMPILED_FUNC_PREMASKED(adr, ARMCPU_ARM9, 0) = 0;
 #endif
 
+	if ((adr >> 24) == 0x06)
+		MMU_VRAMmarkDirty(adr - LCDC_HACKY_LOCATION);
+
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	T1WriteWord(MMU.MMU_MEM[ARMCPU_ARM9][adr>>20], adr&MMU.MMU_MASK[ARMCPU_ARM9][adr>>20], val);
 } 
@@ -4749,6 +5004,9 @@ void FASTCALL _MMU_ARM9_write32(u32 adr, u32 val)
 	}
 #endif
 
+	if ((adr >> 24) == 0x06)
+		MMU_VRAMmarkDirty(adr - LCDC_HACKY_LOCATION);
+
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	T1WriteLong(MMU.MMU_MEM[ARMCPU_ARM9][adr>>20], adr&MMU.MMU_MASK[ARMCPU_ARM9][adr>>20], val);
 }
@@ -5216,6 +5474,9 @@ void FASTCALL _MMU_ARM7_write08(u32 adr, u8 val)
 		JIT_COMPILED_FUNC_PREMASKED(adr, ARMCPU_ARM7, 0) = 0;
 #endif
 	
+	if ((adr >> 24) == 0x06)
+		MMU_VRAMmarkDirty(adr - LCDC_HACKY_LOCATION);
+
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	MMU.MMU_MEM[ARMCPU_ARM7][adr>>20][adr&MMU.MMU_MASK[ARMCPU_ARM7][adr>>20]]=val;
 }
@@ -5398,6 +5659,9 @@ void FASTCALL _MMU_ARM7_write16(u32 adr, u16 val)
 		JIT_COMPILED_FUNC_PREMASKED(adr, ARMCPU_ARM7, 0) = 0;
 #endif
 
+	if ((adr >> 24) == 0x06)
+		MMU_VRAMmarkDirty(adr - LCDC_HACKY_LOCATION);
+
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	T1WriteWord(MMU.MMU_MEM[ARMCPU_ARM7][adr>>20], adr&MMU.MMU_MASK[ARMCPU_ARM7][adr>>20], val);
 }
@@ -5500,6 +5764,9 @@ void FASTCALL _MMU_ARM7_write32(u32 adr, u32 val)
 	}
 #endif
 
+	if ((adr >> 24) == 0x06)
+		MMU_VRAMmarkDirty(adr - LCDC_HACKY_LOCATION);
+
 	// Removed the &0xFF as they are implicit with the adr&0x0FFFFFFF [shash]
 	T1WriteLong(MMU.MMU_MEM[ARMCPU_ARM7][adr>>20], adr&MMU.MMU_MASK[ARMCPU_ARM7][adr>>20], val);
 }
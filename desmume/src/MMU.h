@@ -621,6 +621,47 @@ FORCEINLINE void* MMU_gpu_map(const u32 vram_addr)
 	return MMU.ARM9_LCD + (vram_page << 14) + ofs;
 }
 
+//VRAM write tracking. Every write into ARM9_LCD stamps the 2KB block that it lands in with the
+//current value of vram_write_clock, and every change to a texture or texture palette slot mapping
+//stamps that slot. Anything that keeps its own copy of VRAM data (such as the texture cache) can
+//take a new stamp when it makes the copy, and later check that nothing it was copied from has been
+//written or remapped since then, without having to read VRAM again.
+#define VRAM_DIRTY_BLOCK_SHIFT 11
+#define VRAM_DIRTY_BLOCKS ((0xA4000 + 0x20000) >> VRAM_DIRTY_BLOCK_SHIFT)
+extern u64 vram_write_clock;
+extern u64 vram_dirty_block[VRAM_DIRTY_BLOCKS];
+extern u64 vram_texslot_stamp[4];
+extern u64 vram_texpalslot_stamp[6];
+
+FORCEINLINE void MMU_VRAMmarkDirty(const u32 lcdOffset)
+{
+	vram_dirty_block[lcdOffset >> VRAM_DIRTY_BLOCK_SHIFT] = vram_write_clock;
+}
+
+FORCEINLINE u64 MMU_VRAMnewStamp()
+{
+	return ++vram_write_clock;
+}
+
+void MMU_VRAMmarkDirtyRange(const u8 *ptr, const size_t len);
+void MMU_VRAMmarkAllDirty();
+bool MMU_VRAMchangedSince(const u8 *ptr, const size_t len, const u64 stamp);
+
+//fastmem: a host pointer for every 16KB page of the bus below 0x08000000 whose reads have no side effects
+//and land in one contiguous piece of host memory (ITCM, shared and ARM7 WRAM, VRAM), following the current
+//WRAMCNT and VRAM bank mapping. other pages are NULL and go through the regular handlers.
+//this is only used for reads; writes have to invalidate jitted code and mark VRAM dirty, so they always take the long way.
+//the pages are only filled in when CommonSettings.fastmem is set.
+#define MMU_FASTMEM_PAGES (0x08000000 >> 14)
+extern u8 *MMU_fastmem_map[2][MMU_FASTMEM_PAGES];
+void MMU_fastmemRebuild();
+
+FORCEINLINE u8* MMU_fastmemPage(const int PROCNUM, const u32 addr)
+{
+	if(addr >= 0x08000000) return NULL;
+	return MMU_fastmem_map[PROCNUM][addr >> 14];
+}
+
 
 template<int PROCNUM, MMU_ACCESS_TYPE AT> u8 _MMU_read08(u32 addr);
 template<int PROCNUM, MMU_ACCESS_TYPE AT> u16 _MMU_read16(u32 addr);
@@ -657,6 +698,42 @@ extern u32 _MMU_MAIN_MEM_MASK16;
 extern u32 _MMU_MAIN_MEM_MASK32;
 void SetupMMU(bool debugConsole, bool dsi);
 
+//main memory write tracking, the same way as for VRAM: every write into main memory stamps the 2KB block
+//that it lands in with the current value of mainmem_write_clock. the SPU keeps ADPCM sounds decoded ahead
+//of time, and uses this to find out whether their data has been written since it decoded them.
+#define MAINMEM_DIRTY_BLOCK_SHIFT 11
+#define MAINMEM_DIRTY_BLOCKS ((16*1024*1024) >> MAINMEM_DIRTY_BLOCK_SHIFT)
+extern u64 mainmem_write_clock;
+extern u64 mainmem_dirty_block[MAINMEM_DIRTY_BLOCKS];
+
+FORCEINLINE void MMU_mainMemMarkDirty(const u32 addr)
+{
+	mainmem_dirty_block[(addr & _MMU_MAIN_MEM_MASK) >> MAINMEM_DIRTY_BLOCK_SHIFT] = mainmem_write_clock;
+}
+
+FORCEINLINE u64 MMU_mainMemNewStamp()
+{
+	return ++mainmem_write_clock;
+}
+
+//[addr, addr+len) must not wrap around the end of main memory
+FORCEINLINE bool MMU_mainMemChangedSince(const u32 addr, const u32 len, const u64 stamp)
+{
+	const u32 firstBlock = (addr & _MMU_MAIN_MEM_MASK) >> MAINMEM_DIRTY_BLOCK_SHIFT;
+	const u32 lastBlock = ((addr & _MMU_MAIN_MEM_MASK) + len - 1) >> MAINMEM_DIRTY_BLOCK_SHIFT;
+
+	for (u32 i = firstBlock; i <= lastBlock; i++)
+	{
+		if (mainmem_dirty_block[i] >= stamp)
+			return true;
+	}
+
+	return false;
+}
+
+void MMU_mainMemMarkDirtyRange(const u32 addr, const u32 len);
+void MMU_mainMemMarkAllDirty();
+
 FORCEINLINE void CheckMemoryDebugEvent(EDEBUG_EVENT event, const MMU_ACCESS_TYPE type, const u32 procnum, const u32 addr, const u32 size, const u32 val)
 {
 	//TODO - ugh work out a better prefetch event system
@@ -709,6 +786,9 @@ FORCEINLINE u8 _MMU_read08(const int PROCNUM, const MMU_ACCESS_TYPE AT, const u3
 	if ( (addr & 0x0F000000) == 0x02000000)
 		return T1ReadByte( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK);
 
+	if(u8 *page = MMU_fastmemPage(PROCNUM, addr))
+		return T1ReadByte(page, addr & 0x3FFF);
+
 	if(PROCNUM==ARMCPU_ARM9) return _MMU_ARM9_read08(addr);
 	else return _MMU_ARM7_read08(addr);
 }
@@ -757,6 +837,9 @@ FORCEINLINE u16 _MMU_read16(const int PROCNUM, const MMU_ACCESS_TYPE AT, const u
 		return T1ReadWord_guaranteedAligned( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK16);
 
 dunno:
+	if(u8 *page = MMU_fastmemPage(PROCNUM, addr))
+		return T1ReadWord_guaranteedAligned(page, addr & 0x3FFE);
+
 	if(PROCNUM==ARMCPU_ARM9) return _MMU_ARM9_read16(addr);
 	else return _MMU_ARM7_read16(addr);
 }
@@ -822,6 +905,9 @@ FORCEINLINE u32 _MMU_read32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const u
 	}
 
 dunno:
+	if(u8 *page = MMU_fastmemPage(PROCNUM, addr))
+		return T1ReadLong_guaranteedAligned(page, addr & 0x3FFC);
+
 	if(PROCNUM==ARMCPU_ARM9) return _MMU_ARM9_read32(addr);
 	else return _MMU_ARM7_read32(addr);
 }
@@ -851,6 +937,7 @@ FORCEINLINE void _MMU_write08(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 #ifdef HAVE_JIT
 		JIT_COMPILED_FUNC_KNOWNBANK(addr, MAIN_MEM, _MMU_MAIN_MEM_MASK, 0) = 0;
 #endif
+		MMU_mainMemMarkDirty(addr);
 		T1WriteByte( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK, val);
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 1, val, LUAMEMHOOK_WRITE);
@@ -890,6 +977,7 @@ FORCEINLINE void _MMU_write16(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 #ifdef HAVE_JIT
 		JIT_COMPILED_FUNC_KNOWNBANK(addr, MAIN_MEM, _MMU_MAIN_MEM_MASK16, 0) = 0;
 #endif
+		MMU_mainMemMarkDirty(addr);
 		T1WriteWord( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK16, val);
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 2, val, LUAMEMHOOK_WRITE);
@@ -930,6 +1018,7 @@ FORCEINLINE void _MMU_write32(const int PROCNUM, const MMU_ACCESS_TYPE AT, const
 		JIT_COMPILED_FUNC_KNOWNBANK(addr, MAIN_MEM, _MMU_MAIN_MEM_MASK32, 0) = 0;
 		JIT_COMPILED_FUNC_KNOWNBANK(addr, MAIN_MEM, _MMU_MAIN_MEM_MASK32, 1) = 0;
 #endif
+		MMU_mainMemMarkDirty(addr);
 		T1WriteLong( MMU.MAIN_MEM, addr & _MMU_MAIN_MEM_MASK32, val);
 #ifdef HAVE_LUA
 		CallRegisteredLuaMemHook(addr, 4, val, LUAMEMHOOK_WRITE);
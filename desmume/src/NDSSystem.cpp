@@ -142,6 +142,7 @@ int NDS_Init()
 {
 	nds.idleFrameCounter = 0;
 	memset(nds.runCycleCollector,0,sizeof(nds.runCycleCollector));
+	TaskPool::configure(CommonSettings.num_cores, CommonSettings.thread_spin, CommonSettings.thread_affinity);
 	MMU_Init();
 
 	//got to print this somewhere..
@@ -204,6 +205,7 @@ void NDS_DeInit(void)
 	cheatSearch = NULL;
 
 #ifdef HAVE_JIT
+	arm_jit_profile_load(NULL, 0);
 	arm_jit_close();
 #endif
 
@@ -426,6 +428,14 @@ bool GameInfo::loadROM(std::string fname, u32 type)
 	char *noext = strdup(fname.c_str());
 	reader = ROMReaderInit(&noext); free(noext);
 	fROM = reader->Init(fname.c_str());
+#ifdef HAVE_ROMREADER_MMAP
+	//some files can't be mapped (empty ones, for instance). read those the usual way
+	if (!fROM && reader == &MMAPROMReader)
+	{
+		reader = &STDROMReader;
+		fROM = reader->Init(fname.c_str());
+	}
+#endif
 	if (!fROM) return false;
 
 	headerOffset = (type == ROM_DSGBA)?DSGBA_LOADER_SIZE:0;
@@ -527,6 +537,16 @@ bool GameInfo::loadROM(std::string fname, u32 type)
 			reader->Read(fROM, &secureArea[0], 0x4000);
 		}
 
+#ifdef HAVE_ROMREADER_MMAP
+		if (reader->id == ROMREADER_MMAP)
+		{
+			//the mapped file is as good as a loaded copy, without reading anything up front.
+			//so use it that way even when streaming from disk was asked for
+			romdata = MMAPROMReaderData(fROM) + headerOffset;
+			romdataIsMapped = true;
+		}
+		else
+#endif
 		if (CommonSettings.loadToMemory)
 		{
 			reader->Seek(fROM, headerOffset, SEEK_SET);
@@ -539,7 +559,10 @@ bool GameInfo::loadROM(std::string fname, u32 type)
 
 				return false;
 			}
+		}
 
+		if (romdata != NULL)
+		{
 			if(hasRomBanner())
 			{
 				memcpy(&banner, romdata + header.IconOff, sizeof(RomBanner));
@@ -554,7 +577,12 @@ bool GameInfo::loadROM(std::string fname, u32 type)
 			}
 
 			_isDSiEnhanced = (LE_TO_LOCAL_32(*(u32*)(romdata + 0x180) == 0x8D898581U) && LE_TO_LOCAL_32(*(u32*)(romdata + 0x184) == 0x8C888480U));
-			reader->DeInit(fROM); fROM = NULL;
+
+			//a mapped file has to stay open for as long as romdata is used
+			if (!romdataIsMapped)
+			{
+				reader->DeInit(fROM); fROM = NULL;
+			}
 			return true;
 		}
 		_isDSiEnhanced = ((readROM(0x180) == 0x8D898581U) && (readROM(0x184) == 0x8C888480U));
@@ -583,16 +611,18 @@ bool GameInfo::loadROM(std::string fname, u32 type)
 
 void GameInfo::closeROM()
 {
+	if (romdata && !romdataIsMapped)
+		delete [] romdata;
+
 	if (fROM)
 		reader->DeInit(fROM);
 
-	if (romdata)
-		delete [] romdata;
-
 	fROM = NULL;
 	romdata = NULL;
+	romdataIsMapped = false;
 	romsize = 0;
 	lastReadPos = 0xFFFFFFFF;
+	prefetchBegin = prefetchEnd = 0;
 }
 
 u32 GameInfo::readROM(u32 pos)
@@ -642,6 +672,25 @@ u32 GameInfo::readROM(u32 pos)
 	return (LE_TO_LOCAL_32(data) & ~pad) | pad;
 }
 
+//called when the card starts a data read at pos. card reads are small but mostly sequential,
+//so this lets the OS fetch a good amount ahead, without asking it again for every read
+void GameInfo::prefetchROM(u32 pos)
+{
+#ifdef HAVE_ROMREADER_MMAP
+	static const u32 kPrefetchSize = 256 * 1024;
+
+	if (!romdataIsMapped || pos >= romsize)
+		return;
+
+	if (pos >= prefetchBegin && (pos + kPrefetchSize/2) <= prefetchEnd)
+		return;
+
+	MMAPROMReaderPrefetch(fROM, pos + headerOffset, kPrefetchSize);
+	prefetchBegin = pos;
+	prefetchEnd = pos + kPrefetchSize;
+#endif
+}
+
 bool GameInfo::isDSiEnhanced()
 {
 	return _isDSiEnhanced;
@@ -782,7 +831,8 @@ int NDS_LoadROM(const char *filename, const char *physicalName, const char *logi
 	//for homebrew, try auto-patching DLDI. should be benign if there is no DLDI or if it fails
 	if(gameInfo.isHomebrew())
 	{
-		if(!CommonSettings.loadToMemory)
+		//a mapped rom is a private copy that can be patched like a loaded one
+		if(!CommonSettings.loadToMemory && !gameInfo.romdataIsMapped)
 			msgbox->warn("Sorry.. right now, you can't use the default (stream rom from disk) with homebrew due to a bug with DLDI-autopatching");
 		if (slot1_GetCurrentType() == NDS_SLOT1_R4)
 			DLDI::tryPatch((void*)gameInfo.romdata, gameInfo.romsize, 1);
@@ -800,6 +850,20 @@ int NDS_LoadROM(const char *filename, const char *physicalName, const char *logi
 		cheats->init(buf);
 	}
 
+#ifdef HAVE_JIT
+	if (CommonSettings.jit_profile)
+	{
+		memset(buf, 0, MAX_PATH);
+		path.getpathnoext(path.STATES, buf);
+		strcat(buf, ".djp");						// DeSmuME jit profile
+		arm_jit_profile_load(buf, crc32(0, (u8*)&gameInfo.header, sizeof(gameInfo.header)));
+	}
+	else
+		arm_jit_profile_load(NULL, 0);
+#endif
+
+	memset(idleLoopStats, 0, sizeof(idleLoopStats));
+
 	NDS_Reset();
 
 	return ret;
@@ -808,7 +872,17 @@ int NDS_LoadROM(const char *filename, const char *physicalName, const char *logi
 void NDS_FreeROM(void)
 {
 	FCEUI_StopMovie();
+	if (CommonSettings.idle_loop_skip)
+	{
+		for (int i = 0; i < 2; i++)
+			INFO("%c%c%c%c ARM%c idle loops: %u found, %u skips, %llu cycles skipped\n",
+				gameInfo.header.gameCode[0], gameInfo.header.gameCode[1], gameInfo.header.gameCode[2], gameInfo.header.gameCode[3],
+				i ? '7' : '9', idleLoopStats[i].loops, idleLoopStats[i].skips, (unsigned long long)idleLoopStats[i].cycles);
+	}
 	gameInfo.closeROM();
+#ifdef HAVE_JIT
+	arm_jit_profile_load(NULL, 0);
+#endif
 }
 
 void NDS_Sleep() { nds.sleeping = TRUE; }
@@ -938,6 +1012,17 @@ struct TSequenceItem
 	u32 param;
 	bool enabled;
 
+	//the sequencer's bookkeeping: the item's place in the execution order and in the heap,
+	//and the time it was filed under there
+	int priority;
+	int heapIndex;
+	u64 key;
+
+	TSequenceItem()
+		: timestamp(0), param(0), enabled(false)
+		, priority(0), heapIndex(-1), key(0)
+	{}
+
 	virtual void save(EMUFILE* os)
 	{
 		write64le(timestamp,os);
@@ -958,10 +1043,38 @@ struct TSequenceItem
 		return enabled && nds_timer >= timestamp;
 	}
 
-	FORCEINLINE u64 next()
+	virtual bool isEnabled() { return enabled; }
+
+	virtual u64 next()
 	{
 		return timestamp;
 	}
+
+	virtual void exec() {}
+};
+
+struct TSequenceItem_dispcnt : public TSequenceItem
+{
+	void exec();
+};
+
+struct TSequenceItem_wifi : public TSequenceItem
+{
+	void exec();
+};
+
+//wraps an NDSEvent registered from outside. it runs once each time it is scheduled
+struct TSequenceItem_external : public TSequenceItem
+{
+	NDSEvent* event;
+
+	TSequenceItem_external() : event(NULL) {}
+
+	void exec()
+	{
+		enabled = false;
+		event->exec();
+	}
 };
 
 struct TSequenceItem_GXFIFO : public TSequenceItem
@@ -1170,12 +1283,19 @@ struct TSequenceItem_sqrtunit : public TSequenceItem
 
 };
 
+#define kMaxExternalEvents 8
+#define kMaxSequenceItems 32
+
+//the items that are enabled are kept in a binary heap ordered by the time they are due,
+//so finding the next one doesn't have to look at all of them. whatever changes an item's
+//time or enabled state has to requeue() it (the NDS_Reschedule* functions do this);
+//the heap is brought up to date before it is next used.
 struct Sequencer
 {
 	bool nds_vblankEnded;
 	bool reschedule;
-	TSequenceItem dispcnt;
-	TSequenceItem wifi;
+	TSequenceItem_dispcnt dispcnt;
+	TSequenceItem_wifi wifi;
 	TSequenceItem_divider divider;
 	TSequenceItem_sqrtunit sqrtunit;
 	TSequenceItem_GXFIFO gxfifo;
@@ -1187,12 +1307,31 @@ struct Sequencer
 	TSequenceItem_Timer<0,2> timer_0_2; TSequenceItem_Timer<0,3> timer_0_3;
 	TSequenceItem_Timer<1,0> timer_1_0; TSequenceItem_Timer<1,1> timer_1_1;
 	TSequenceItem_Timer<1,2> timer_1_2; TSequenceItem_Timer<1,3> timer_1_3;
+	TSequenceItem_external external[kMaxExternalEvents];
+
+	//every item, in the order they run when due at the same time
+	TSequenceItem* items[kMaxSequenceItems];
+	u32 numItems;
+	TSequenceItem* heap[kMaxSequenceItems];
+	u32 heapSize;
+	u32 dirty;
+
+	Sequencer();
 
 	void init();
 
 	void execHardware();
 	u64 findNext();
 
+	FORCEINLINE void requeue(TSequenceItem &item) { dirty |= 1<<item.priority; }
+	void add(TSequenceItem &item);
+	FORCEINLINE void refresh() { if(dirty) refreshDirty(); }
+	void refreshDirty();
+	void file(TSequenceItem &item);
+	void siftUp(u32 i);
+	void siftDown(u32 i);
+	TSequenceItem* findTriggered(u32 i, int after, TSequenceItem *best);
+
 	void save(EMUFILE* os)
 	{
 		write64le(nds_timer,os);
@@ -1209,6 +1348,9 @@ struct Sequencer
 		SAVE(dma,0,0); SAVE(dma,0,1); SAVE(dma,0,2); SAVE(dma,0,3); 
 		SAVE(dma,1,0); SAVE(dma,1,1); SAVE(dma,1,2); SAVE(dma,1,3); 
 #undef SAVE
+		write32le(kMaxExternalEvents,os);
+		for(int i=0;i<kMaxExternalEvents;i++)
+			external[i].save(os);
 	}
 
 	bool load(EMUFILE* is, int version)
@@ -1228,6 +1370,25 @@ struct Sequencer
 		LOAD(dma,1,0); LOAD(dma,1,1); LOAD(dma,1,2); LOAD(dma,1,3); 
 #undef LOAD
 
+		//registered events are matched up by the order they were registered in. older states
+		//didn't have them, so anything that was pending is dropped rather than left with a time
+		//from another session
+		u32 numExternal = 0;
+		if(version >= 4)
+			if(read32le(&numExternal,is) != 1) return false;
+		for(u32 i=0;i<numExternal;i++)
+		{
+			TSequenceItem_external dummy;
+			TSequenceItem_external &item = (i < kMaxExternalEvents) ? external[i] : dummy;
+			if(!item.load(is)) return false;
+		}
+		for(int i=0;i<kMaxExternalEvents;i++)
+			if(i >= (int)numExternal || !external[i].event)
+				external[i].enabled = false;
+
+		//the mmu state the items are timed by may still be on its way in
+		dirty = 0xFFFFFFFF >> (32-numItems);
+
 		return true;
 	}
 
@@ -1240,12 +1401,13 @@ void NDS_RescheduleGXFIFO(u32 cost)
 		sequencer.gxfifo.enabled = true;
 	}
 	MMU.gfx3dCycles += cost;
+	sequencer.requeue(sequencer.gxfifo);
 	NDS_Reschedule();
 }
 
 void NDS_RescheduleTimers()
 {
-#define check(X,Y) sequencer.timer_##X##_##Y .schedule();
+#define check(X,Y) sequencer.timer_##X##_##Y .schedule(); sequencer.requeue(sequencer.timer_##X##_##Y);
 	check(0,0); check(0,1); check(0,2); check(0,3);
 	check(1,0); check(1,1); check(1,2); check(1,3);
 #undef check
@@ -1253,11 +1415,58 @@ void NDS_RescheduleTimers()
 	NDS_Reschedule();
 }
 
-void NDS_RescheduleDMA()
+void NDS_RescheduleDMA(int procnum, int chan)
+{
+	//the dma items were added one after the other, starting with dma_0_0
+	sequencer.requeue(*sequencer.items[sequencer.dma_0_0.priority + procnum*4 + chan]);
+	NDS_Reschedule();
+}
+
+void NDS_RescheduleDivSqrt()
+{
+	sequencer.requeue(sequencer.divider);
+	sequencer.requeue(sequencer.sqrtunit);
+	NDS_Reschedule();
+}
+
+void NDS_RegisterEvent(NDSEvent *ev)
+{
+	for(int i=0;i<kMaxExternalEvents;i++)
+	{
+		TSequenceItem_external &item = sequencer.external[i];
+		if(item.event) continue;
+		item.event = ev;
+		item.enabled = false;
+		ev->seqIndex = i;
+		return;
+	}
+	printf("Sequencer: too many registered events\n");
+}
+
+void NDS_UnregisterEvent(NDSEvent *ev)
 {
-	//TBD
+	if(ev->seqIndex < 0) return;
+	NDS_CancelEvent(ev);
+	sequencer.external[ev->seqIndex].event = NULL;
+	ev->seqIndex = -1;
+}
+
+void NDS_ScheduleEvent(NDSEvent *ev, u64 timestamp)
+{
+	if(ev->seqIndex < 0) return;
+	TSequenceItem_external &item = sequencer.external[ev->seqIndex];
+	item.timestamp = timestamp;
+	item.enabled = true;
+	sequencer.requeue(item);
 	NDS_Reschedule();
+}
 
+void NDS_CancelEvent(NDSEvent *ev)
+{
+	if(ev->seqIndex < 0) return;
+	TSequenceItem_external &item = sequencer.external[ev->seqIndex];
+	item.enabled = false;
+	sequencer.requeue(item);
 }
 
 static void initSchedule()
@@ -1280,10 +1489,40 @@ static void initSchedule()
 const u64 kWifiCycles = 67;//34*2;
 //(this isn't very precise. I don't think it needs to be)
 
+Sequencer::Sequencer()
+	: numItems(0)
+	, heapSize(0)
+	, dirty(0)
+{
+	add(dispcnt);
+#ifdef EXPERIMENTAL_WIFI_COMM
+	add(wifi);
+#endif
+	add(divider);
+	add(sqrtunit);
+	add(gxfifo);
+	add(dma_0_0); add(dma_0_1); add(dma_0_2); add(dma_0_3);
+	add(dma_1_0); add(dma_1_1); add(dma_1_2); add(dma_1_3);
+	add(timer_0_0); add(timer_0_1); add(timer_0_2); add(timer_0_3);
+	add(timer_1_0); add(timer_1_1); add(timer_1_2); add(timer_1_3);
+	for(int i=0;i<kMaxExternalEvents;i++)
+		add(external[i]);
+}
+
+void Sequencer::add(TSequenceItem &item)
+{
+	item.priority = numItems;
+	item.heapIndex = -1;
+	items[numItems++] = &item;
+}
+
 void Sequencer::init()
 {
+	for(u32 i=0;i<heapSize;i++)
+		heap[i]->heapIndex = -1;
+	heapSize = 0;
+
 	NDS_RescheduleTimers();
-	NDS_RescheduleDMA();
 
 	reschedule = false;
 	nds_timer = 0;
@@ -1296,6 +1535,9 @@ void Sequencer::init()
 
 	gxfifo.enabled = false;
 
+	for(int i=0;i<kMaxExternalEvents;i++)
+		external[i].enabled = false;
+
 	dma_0_0.controller = &MMU_new.dma[0][0];
 	dma_0_1.controller = &MMU_new.dma[0][1];
 	dma_0_2.controller = &MMU_new.dma[0][2];
@@ -1312,6 +1554,8 @@ void Sequencer::init()
 	#else
 	wifi.enabled = false;
 	#endif
+
+	dirty = 0xFFFFFFFF >> (32-numItems);
 }
 
 static void execHardware_hblank()
@@ -1567,126 +1811,178 @@ void NDS_Reschedule()
 {
 	IF_DEVELOPER(if(!sequencer.reschedule) DEBUG_statistics.sequencerExecutionCounters[0]++;);
 	sequencer.reschedule = true;
+#ifdef HAVE_JIT
+	// stop chained jit blocks at the end of the current block
+	arm_jit_chain_budget = 0;
+#endif
 }
 
-FORCEINLINE u32 _fast_min32(u32 a, u32 b, u32 c, u32 d)
+void Sequencer::siftUp(u32 i)
 {
-	return ((( ((s32)(a-b)) >> (32-1)) & (c^d)) ^ d);
+	TSequenceItem *item = heap[i];
+	while(i > 0)
+	{
+		const u32 parent = (i-1)/2;
+		TSequenceItem *p = heap[parent];
+		if(p->key < item->key || (p->key == item->key && p->priority < item->priority)) break;
+		heap[i] = p;
+		p->heapIndex = i;
+		i = parent;
+	}
+	heap[i] = item;
+	item->heapIndex = i;
 }
 
-FORCEINLINE u64 _fast_min(u64 a, u64 b)
+void Sequencer::siftDown(u32 i)
 {
-	//you might find that this is faster on a 64bit system; someone should try it
-	//http://aggregate.org/MAGIC/#Integer%20Selection
-	//u64 ret = (((((s64)(a-b)) >> (64-1)) & (a^b)) ^ b);
-	//assert(ret==min(a,b));
-	//return ret;	
-	
-	//but this ends up being the fastest on 32bits
-	return a<b?a:b;
-
-	//just for the record, I tried to do the 64bit math on a 32bit proc
-	//using sse2 and it was really slow
-	//__m128i __a; __a.m128i_u64[0] = a;
-	//__m128i __b; __b.m128i_u64[0] = b;
-	//__m128i xorval = _mm_xor_si128(__a,__b);
-	//__m128i temp = _mm_sub_epi64(__a,__b);
-	//temp.m128i_i64[0] >>= 63; //no 64bit shra in sse2, what a disappointment
-	//temp = _mm_and_si128(temp,xorval);
-	//temp = _mm_xor_si128(temp,__b);
-	//return temp.m128i_u64[0];
+	TSequenceItem *item = heap[i];
+	for(;;)
+	{
+		u32 child = 2*i+1;
+		if(child >= heapSize) break;
+		if(child+1 < heapSize)
+		{
+			TSequenceItem *l = heap[child], *r = heap[child+1];
+			if(r->key < l->key || (r->key == l->key && r->priority < l->priority)) child++;
+		}
+		TSequenceItem *c = heap[child];
+		if(item->key < c->key || (item->key == c->key && item->priority < c->priority)) break;
+		heap[i] = c;
+		c->heapIndex = i;
+		i = child;
+	}
+	heap[i] = item;
+	item->heapIndex = i;
 }
 
-
-
-u64 Sequencer::findNext()
+//puts the item where its current time and enabled state say it belongs
+void Sequencer::file(TSequenceItem &item)
 {
-	//this one is always enabled so dont bother to check it
-	u64 next = dispcnt.next();
+	if(!item.isEnabled())
+	{
+		if(item.heapIndex < 0) return;
+		const u32 i = item.heapIndex;
+		item.heapIndex = -1;
+		if(i == --heapSize) return;
+		TSequenceItem *moved = heap[heapSize];
+		heap[i] = moved;
+		moved->heapIndex = i;
+		siftUp(i);
+		siftDown(moved->heapIndex);
+		return;
+	}
 
-	if(divider.isEnabled()) next = _fast_min(next,divider.next());
-	if(sqrtunit.isEnabled()) next = _fast_min(next,sqrtunit.next());
-	if(gxfifo.enabled) next = _fast_min(next,gxfifo.next());
+	const u64 key = item.next();
+	if(item.heapIndex < 0)
+	{
+		item.key = key;
+		heap[heapSize] = &item;
+		siftUp(heapSize++);
+	}
+	else if(key < item.key)
+	{
+		item.key = key;
+		siftUp(item.heapIndex);
+	}
+	else if(key > item.key)
+	{
+		item.key = key;
+		siftDown(item.heapIndex);
+	}
+}
 
-#ifdef EXPERIMENTAL_WIFI_COMM
-	next = _fast_min(next,wifi.next());
-#endif
+void Sequencer::refreshDirty()
+{
+	for(u32 i=0; dirty; i++)
+	{
+		if(!(dirty & (1<<i))) continue;
+		dirty &= ~(1<<i);
+		file(*items[i]);
+	}
+}
 
-#define test(X,Y) if(dma_##X##_##Y .isEnabled()) next = _fast_min(next,dma_##X##_##Y .next());
-	test(0,0); test(0,1); test(0,2); test(0,3);
-	test(1,0); test(1,1); test(1,2); test(1,3);
-#undef test
-#define test(X,Y) if(timer_##X##_##Y .enabled) next = _fast_min(next,timer_##X##_##Y .next());
-	test(0,0); test(0,1); test(0,2); test(0,3);
-	test(1,0); test(1,1); test(1,2); test(1,3);
-#undef test
+u64 Sequencer::findNext()
+{
+	refresh();
+	return heapSize ? heap[0]->key : kNever;
+}
 
-	return next;
+//the due item that runs first after the one numbered 'after', looking at the due item heap[i] and
+//everything below it. due items can only be found below other due items, so this doesn't look at
+//much more of the heap than those.
+TSequenceItem* Sequencer::findTriggered(u32 i, int after, TSequenceItem *best)
+{
+	TSequenceItem *item = heap[i];
+	if(item->priority > after && (!best || item->priority < best->priority)) best = item;
+	const u32 end = std::min(2*i+3, heapSize);
+	for(u32 child = 2*i+1; child < end; child++)
+		if(heap[child]->key <= nds_timer)
+			best = findTriggered(child, after, best);
+	return best;
 }
 
 void Sequencer::execHardware()
 {
-	if(dispcnt.isTriggered())
+	//due items run in a fixed order, once each. an item that another one makes due right now
+	//still runs in this pass if it comes later in the order, or else in the next one.
+	int after = -1;
+	for(;;)
 	{
+		refresh();
+		if(!heapSize || heap[0]->key > nds_timer) break;
+		TSequenceItem *item = findTriggered(0, after, NULL);
+		if(!item) break;
+		after = item->priority;
+		item->exec();
+		requeue(*item);
+	}
+}
 
-		IF_DEVELOPER(DEBUG_statistics.sequencerExecutionCounters[1]++);
+void TSequenceItem_dispcnt::exec()
+{
+	IF_DEVELOPER(DEBUG_statistics.sequencerExecutionCounters[1]++);
 
-		switch(dispcnt.param)
-		{
-		case ESI_DISPCNT_HStart:
-			execHardware_hstart();
-			//(used to be 3168)
-			//hstart is actually 8 dots before the visible drawing begins
-			//we're going to run 1 here and then run 7 in the next case
-			dispcnt.timestamp += 1*6*2;
-			dispcnt.param = ESI_DISPCNT_HStartIRQ;
-			break;
-		case ESI_DISPCNT_HStartIRQ:
-			execHardware_hstart_irq();
-			dispcnt.timestamp += 7*6*2;
-			dispcnt.param = ESI_DISPCNT_HDraw;
-			break;
-			
-		case ESI_DISPCNT_HDraw:
-			execHardware_hdraw();
-			//duration of non-blanking period is ~1606 clocks (gbatek agrees) [but says its different on arm7]
-			//im gonna call this 267 dots = 267*6=1602
-			//so, this event lasts 267 dots minus the 8 dot preroll
-			dispcnt.timestamp += (267-8)*6*2;
-			dispcnt.param = ESI_DISPCNT_HBlank;
-			break;
-
-		case ESI_DISPCNT_HBlank:
-			execHardware_hblank();
-			//(once this was 1092 or 1092/12=91 dots.)
-			//there are surely 355 dots per scanline, less 267 for non-blanking period. the rest is hblank and then after that is hstart
-			dispcnt.timestamp += (355-267)*6*2;
-			dispcnt.param = ESI_DISPCNT_HStart;
-			break;
-		}
+	switch(param)
+	{
+	case ESI_DISPCNT_HStart:
+		execHardware_hstart();
+		//(used to be 3168)
+		//hstart is actually 8 dots before the visible drawing begins
+		//we're going to run 1 here and then run 7 in the next case
+		timestamp += 1*6*2;
+		param = ESI_DISPCNT_HStartIRQ;
+		break;
+	case ESI_DISPCNT_HStartIRQ:
+		execHardware_hstart_irq();
+		timestamp += 7*6*2;
+		param = ESI_DISPCNT_HDraw;
+		break;
+		
+	case ESI_DISPCNT_HDraw:
+		execHardware_hdraw();
+		//duration of non-blanking period is ~1606 clocks (gbatek agrees) [but says its different on arm7]
+		//im gonna call this 267 dots = 267*6=1602
+		//so, this event lasts 267 dots minus the 8 dot preroll
+		timestamp += (267-8)*6*2;
+		param = ESI_DISPCNT_HBlank;
+		break;
+
+	case ESI_DISPCNT_HBlank:
+		execHardware_hblank();
+		//(once this was 1092 or 1092/12=91 dots.)
+		//there are surely 355 dots per scanline, less 267 for non-blanking period. the rest is hblank and then after that is hstart
+		timestamp += (355-267)*6*2;
+		param = ESI_DISPCNT_HStart;
+		break;
 	}
+}
 
+void TSequenceItem_wifi::exec()
+{
 #ifdef EXPERIMENTAL_WIFI_COMM
-	if(wifi.isTriggered())
-	{
-		WIFI_usTrigger();
-		wifi.timestamp += kWifiCycles;
-	}
+	WIFI_usTrigger();
+	timestamp += kWifiCycles;
 #endif
-	
-	if(divider.isTriggered()) divider.exec();
-	if(sqrtunit.isTriggered()) sqrtunit.exec();
-	if(gxfifo.isTriggered()) gxfifo.exec();
-
-
-#define test(X,Y) if(dma_##X##_##Y .isTriggered()) dma_##X##_##Y .exec();
-	test(0,0); test(0,1); test(0,2); test(0,3);
-	test(1,0); test(1,1); test(1,2); test(1,3);
-#undef test
-#define test(X,Y) if(timer_##X##_##Y .enabled) if(timer_##X##_##Y .isTriggered()) timer_##X##_##Y .exec();
-	test(0,0); test(0,1); test(0,2); test(0,3);
-	test(1,0); test(1,1); test(1,2); test(1,3);
-#undef test
 }
 
 void execHardware_interrupts();
@@ -1697,7 +1993,7 @@ static bool loadUserInput(EMUFILE* is, int version);
 void nds_savestate(EMUFILE* os)
 {
 	//version
-	write32le(3,os);
+	write32le(4,os);
 
 	sequencer.save(os);
 
@@ -1717,7 +2013,7 @@ bool nds_loadstate(EMUFILE* is, int size)
 	u32 version;
 	if(read32le(&version,is) != 1) return false;
 
-	if(version > 3) return false;
+	if(version > 4) return false;
 
 	bool temp = true;
 	temp &= sequencer.load(is, version);
@@ -1805,6 +2101,448 @@ FORCEINLINE void arm7log()
 #endif
 }
 
+//polling loops that only read memory which doesn't change by itself can't leave until an
+//event fires or the other cpu writes something, so the time they would spin can be skipped.
+#define IDLELOOP_MAX_INSNS 8
+#define IDLELOOP_CACHE_SIZE 256
+#define IDLELOOP_FLAGS (1<<16)
+
+IdleLoopStats idleLoopStats[2];
+
+struct IdleLoopOp
+{
+	u32 reads, writes;		//registers, and IDLELOOP_FLAGS for the cpsr flags
+	bool load, word;
+	u32 base, ofs;			//load address is R[base]+ofs; for base 15, ofs is added to the pc
+	bool hasValue;			//the register written is a constant known from the code
+	u32 value;
+	bool branch, conditional;
+	u32 target;
+};
+
+struct IdleLoopLoad
+{
+	u32 base;				//0xFF: ofs is the whole address
+	u32 ofs;
+};
+
+struct IdleLoopEntry
+{
+	u32 head;				//loop address | thumb, or 0xFFFFFFFF if unused
+	bool idle;
+	u32 end;				//address of the branch back to head
+	u32 numCode, numLoads;
+	u32 codeAdr[IDLELOOP_MAX_INSNS*2], codeVal[IDLELOOP_MAX_INSNS*2];
+	bool codeWord[IDLELOOP_MAX_INSNS*2];
+	IdleLoopLoad loads[IDLELOOP_MAX_INSNS];
+};
+
+struct IdleLoopState
+{
+	u32 head;				//target of the cpu's last short backward branch | thumb
+	bool idle;				//head is a skippable loop
+	u32 end;				//its last instruction, when idle
+	bool looped;			//the cpu has been all the way around it
+};
+
+static IdleLoopEntry idleLoopCache[2][IDLELOOP_CACHE_SIZE];
+static IdleLoopState idleLoopState[2];
+
+static bool idleLoopDecodeArm(u32 adr, u32 opcode, IdleLoopOp &op)
+{
+	const u32 cond = CONDITION(opcode);
+	const u32 rd = REG_POS(opcode,12);
+	const u32 rn = REG_POS(opcode,16);
+	memset(&op, 0, sizeof(op));
+
+	if(cond == 0xF) return false;
+	if((opcode & 0x0E000000) == 0x0A000000)
+	{
+		if(BIT24(opcode)) return false;		//BL
+		op.branch = true;
+		op.conditional = (cond != 0xE);
+		op.target = adr + 8 + ((s32)(opcode<<8)>>6);
+		if(op.conditional) op.reads = IDLELOOP_FLAGS;
+		return true;
+	}
+	//only the branches out of the loop and back to its start may be conditional
+	if(cond != 0xE) return false;
+
+	if((opcode & 0x0E000090) == 0x00000090)
+	{
+		//LDRH/LDRSB/LDRSH with an immediate offset and no writeback
+		if((opcode & 0x01700000) != 0x01500000 || (opcode & 0x60) == 0 || rd == 15) return false;
+		const u32 ofs = ((opcode>>4) & 0xF0) | (opcode & 0xF);
+		op.load = true;
+		op.base = rn;
+		op.ofs = BIT23(opcode) ? ofs : (u32)-(s32)ofs;
+		op.reads = 1<<rn;
+		op.writes = 1<<rd;
+		return true;
+	}
+
+	switch((opcode>>26) & 3)
+	{
+		case 0:
+		{
+			const u32 opc = (opcode>>21) & 0xF;
+			const bool test = (opc >= 8 && opc <= 11);
+			if(test && !BIT20(opcode)) return false;		//MRS, MSR, BX
+			if(!test && rd == 15) return false;
+			if(opc != 13 && opc != 15) op.reads |= 1<<rn;
+			if(BIT25(opcode))
+			{
+				const u32 rot = (opcode>>7) & 0x1E;
+				const u32 imm = ((opcode & 0xFF) >> rot) | ((opcode & 0xFF) << ((32 - rot) & 31));
+				op.hasValue = (opc == 13) || (rn == 15 && (opc == 2 || opc == 4));
+				op.value = (opc == 13) ? imm : (opc == 2) ? adr + 8 - imm : adr + 8 + imm;
+			}
+			else
+			{
+				op.reads |= 1<<REG_POS(opcode,0);
+				if(BIT4(opcode)) op.reads |= 1<<REG_POS(opcode,8);
+				else if((opcode & 0xFF0) == 0x060) op.reads |= IDLELOOP_FLAGS;	//RRX
+			}
+			if(opc >= 5 && opc <= 7) op.reads |= IDLELOOP_FLAGS;				//ADC, SBC, RSC
+			if(!test) op.writes |= 1<<rd;
+			if(BIT20(opcode)) op.writes |= IDLELOOP_FLAGS;
+			return true;
+		}
+		case 1:
+			//LDR/LDRB with an immediate offset and no writeback
+			if((opcode & 0x03300000) != 0x01100000 || rd == 15) return false;
+			op.load = true;
+			op.word = !BIT22(opcode);
+			op.base = rn;
+			op.ofs = BIT23(opcode) ? (opcode & 0xFFF) : (u32)-(s32)(opcode & 0xFFF);
+			op.reads = 1<<rn;
+			op.writes = 1<<rd;
+			return true;
+	}
+	return false;
+}
+
+static bool idleLoopDecodeThumb(u32 adr, u32 opcode, IdleLoopOp &op)
+{
+	const u32 rd = opcode & 7;
+	const u32 rs = (opcode>>3) & 7;
+	const u32 r8 = (opcode>>8) & 7;
+	memset(&op, 0, sizeof(op));
+
+	switch(opcode>>11)
+	{
+		case 0x00: case 0x01: case 0x02:	//LSL, LSR, ASR by immediate
+			op.reads = 1<<rs;
+			op.writes = (1<<rd) | IDLELOOP_FLAGS;
+			return true;
+		case 0x03:							//ADD, SUB
+			op.reads = 1<<rs;
+			if(!BIT10(opcode)) op.reads |= 1<<((opcode>>6) & 7);
+			op.writes = (1<<rd) | IDLELOOP_FLAGS;
+			return true;
+		case 0x04:							//MOV #imm
+			op.writes = (1<<r8) | IDLELOOP_FLAGS;
+			op.hasValue = true;
+			op.value = opcode & 0xFF;
+			return true;
+		case 0x05:							//CMP #imm
+			op.reads = 1<<r8;
+			op.writes = IDLELOOP_FLAGS;
+			return true;
+		case 0x06: case 0x07:				//ADD, SUB #imm
+			op.reads = 1<<r8;
+			op.writes = (1<<r8) | IDLELOOP_FLAGS;
+			return true;
+		case 0x08:
+			if(!BIT10(opcode))
+			{
+				//ALU operations
+				const u32 opc = (opcode>>6) & 0xF;
+				op.reads = 1<<rs;
+				if(opc != 9 && opc != 15) op.reads |= 1<<rd;					//NEG, MVN
+				if(opc == 5 || opc == 6) op.reads |= IDLELOOP_FLAGS;			//ADC, SBC
+				if(opc != 8 && opc != 10 && opc != 11) op.writes = 1<<rd;		//TST, CMP, CMN
+				op.writes |= IDLELOOP_FLAGS;
+				return true;
+			}
+			else
+			{
+				//ADD, CMP, MOV with high registers
+				const u32 opc = (opcode>>8) & 3;
+				const u32 hd = rd | ((opcode>>4) & 8);
+				const u32 hs = (opcode>>3) & 0xF;
+				if(opc == 3 || (opc != 1 && hd == 15)) return false;
+				op.reads = 1<<hs;
+				if(opc != 2) op.reads |= 1<<hd;
+				op.writes = (opc == 1) ? IDLELOOP_FLAGS : 1<<hd;
+				return true;
+			}
+		case 0x09:							//LDR [PC, #imm]
+			op.load = op.word = true;
+			op.base = 15;
+			op.ofs = ((opcode & 0xFF)<<2) - (adr & 2);
+			op.writes = 1<<r8;
+			return true;
+		case 0x0D: case 0x0F:				//LDR, LDRB [Rb, #imm]
+			op.load = true;
+			op.base = rs;
+			op.ofs = ((opcode>>6) & 0x1F) << (BIT12(opcode) ? 0 : 2);
+			op.reads = 1<<rs;
+			op.writes = 1<<rd;
+			return true;
+		case 0x11:							//LDRH [Rb, #imm]
+			op.load = true;
+			op.base = rs;
+			op.ofs = ((opcode>>6) & 0x1F) << 1;
+			op.reads = 1<<rs;
+			op.writes = 1<<rd;
+			return true;
+		case 0x13:							//LDR [SP, #imm]
+			op.load = true;
+			op.base = 13;
+			op.ofs = (opcode & 0xFF) << 2;
+			op.reads = 1<<13;
+			op.writes = 1<<r8;
+			return true;
+		case 0x14:							//ADD Rd, PC, #imm
+			op.writes = 1<<r8;
+			op.hasValue = true;
+			op.value = ((adr + 4) & ~3) + ((opcode & 0xFF)<<2);
+			return true;
+		case 0x15:							//ADD Rd, SP, #imm
+			op.reads = 1<<13;
+			op.writes = 1<<r8;
+			return true;
+		case 0x1A: case 0x1B:				//B<cond>
+			if(((opcode>>8) & 0xF) >= 0xE) return false;
+			op.branch = op.conditional = true;
+			op.reads = IDLELOOP_FLAGS;
+			op.target = adr + 4 + ((s32)(s8)(opcode & 0xFF) << 1);
+			return true;
+		case 0x1C:							//B
+			op.branch = true;
+			op.target = adr + 4 + ((s32)(opcode<<21)>>20);
+			return true;
+	}
+	return false;
+}
+
+//memory the loop may read: no side effects on reading, and nothing but events or the other cpu changes it
+template<int PROCNUM>
+static bool idleLoopSafeRead(u32 adr)
+{
+	if(PROCNUM == ARMCPU_ARM9 && (adr < 0x02000000 || (adr & ~0x3FFF) == MMU.DTCMRegion))
+		return true;
+
+	switch(adr>>24)
+	{
+		case 0x02:
+		case 0x03:
+			return true;
+		case 0x04:
+			switch(adr & ~3)
+			{
+				case REG_DISPA_DISPSTAT:	//and VCOUNT
+				case REG_IPCSYNC:
+				case REG_IPCFIFOCNT:
+				case REG_IME:
+				case REG_IE:
+				case REG_IF:
+					return true;
+			}
+			return false;
+	}
+	return false;
+}
+
+//checks that the code at head is a short loop which does the same thing every time around:
+//it stores nothing, and each register it reads is either written earlier in the same pass
+//or not written at all. loads through the registers that aren't written are kept in the entry,
+//since what they point at has to be checked against the registers each time.
+template<int PROCNUM>
+static bool idleLoopAnalyze(u32 head, bool thumb, IdleLoopEntry &e)
+{
+	const u32 size = thumb ? 2 : 4;
+	u32 written = 0, readFirst = 0, known = 0;
+	u32 value[16];
+	u32 exits[IDLELOOP_MAX_INSNS];
+	u32 numExits = 0;
+
+	e.numCode = e.numLoads = 0;
+	for(u32 i = 0; i < IDLELOOP_MAX_INSNS; i++)
+	{
+		const u32 adr = head + i*size;
+		const u32 opcode = thumb ? _MMU_read16<PROCNUM,MMU_AT_DEBUG>(adr) : _MMU_read32<PROCNUM,MMU_AT_DEBUG>(adr);
+		e.codeAdr[e.numCode] = adr;
+		e.codeVal[e.numCode] = opcode;
+		e.codeWord[e.numCode++] = !thumb;
+
+		IdleLoopOp op;
+		if(!(thumb ? idleLoopDecodeThumb(adr, opcode, op) : idleLoopDecodeArm(adr, opcode, op)))
+			return false;
+
+		readFirst |= op.reads & ~written;
+
+		if(op.load)
+		{
+			IdleLoopLoad &load = e.loads[e.numLoads++];
+			if(op.base == 15)
+			{
+				load.base = 0xFF;
+				load.ofs = adr + 2*size + op.ofs;
+				//a word from the literal pool is a constant, as long as it is checked along with the code
+				if(op.word)
+				{
+					op.hasValue = true;
+					op.value = _MMU_read32<PROCNUM,MMU_AT_DEBUG>(load.ofs);
+					e.codeAdr[e.numCode] = load.ofs;
+					e.codeVal[e.numCode] = op.value;
+					e.codeWord[e.numCode++] = true;
+				}
+			}
+			else if(written & (1<<op.base))
+			{
+				//pointers computed in the loop are only followed if they are constants
+				if(!(known & (1<<op.base))) return false;
+				load.base = 0xFF;
+				load.ofs = value[op.base] + op.ofs;
+			}
+			else
+			{
+				load.base = op.base;
+				load.ofs = op.ofs;
+			}
+		}
+
+		written |= op.writes;
+		known &= ~op.writes;
+		if(op.hasValue)
+		{
+			u32 r = 0;
+			while(!(op.writes & (1<<r))) r++;
+			known |= 1<<r;
+			value[r] = op.value;
+		}
+
+		if(op.branch)
+		{
+			if(op.target == head)
+			{
+				for(u32 j = 0; j < numExits; j++)
+					if(exits[j] <= adr) return false;
+				e.end = adr;
+				return (readFirst & written) == 0;
+			}
+			//anything else has to be a way out
+			if(!op.conditional || op.target <= adr) return false;
+			exits[numExits++] = op.target;
+		}
+	}
+	return false;
+}
+
+template<int PROCNUM>
+static bool idleLoopCheck(u32 head, bool thumb, u32 *end = NULL)
+{
+	const armcpu_t &cpu = PROCNUM ? NDS_ARM7 : NDS_ARM9;
+	IdleLoopEntry &e = idleLoopCache[PROCNUM][(head>>1) & (IDLELOOP_CACHE_SIZE-1)];
+	const u32 key = head | (thumb ? 1 : 0);
+
+	//the code may have been overwritten since. loops that weren't idle only get the first instruction checked
+	bool analyze = (e.head != key);
+	for(u32 i = 0, n = e.idle ? e.numCode : 1; !analyze && i < n; i++)
+	{
+		const u32 val = e.codeWord[i] ? _MMU_read32<PROCNUM,MMU_AT_DEBUG>(e.codeAdr[i]) : _MMU_read16<PROCNUM,MMU_AT_DEBUG>(e.codeAdr[i]);
+		analyze = (val != e.codeVal[i]);
+	}
+	if(analyze)
+	{
+		e.head = key;
+		e.idle = idleLoopAnalyze<PROCNUM>(head, thumb, e);
+		if(e.idle) idleLoopStats[PROCNUM].loops++;
+	}
+	if(!e.idle) return false;
+
+	for(u32 i = 0; i < e.numLoads; i++)
+	{
+		const IdleLoopLoad &load = e.loads[i];
+		if(!idleLoopSafeRead<PROCNUM>(load.base == 0xFF ? load.ofs : cpu.R[load.base] + load.ofs))
+			return false;
+	}
+	if(end) *end = e.end;
+	return true;
+}
+
+bool NDS_IsIdleLoop(int procnum, u32 adr, bool thumb)
+{
+	return procnum == ARMCPU_ARM9 ? idleLoopCheck<ARMCPU_ARM9>(adr, thumb) : idleLoopCheck<ARMCPU_ARM7>(adr, thumb);
+}
+
+static void idleLoopReset()
+{
+	for(int i = 0; i < 2; i++)
+	{
+		for(int j = 0; j < IDLELOOP_CACHE_SIZE; j++)
+			idleLoopCache[i][j].head = 0xFFFFFFFF;
+		idleLoopState[i].head = 0xFFFFFFFF;
+		idleLoopState[i].end = 0;
+		idleLoopState[i].idle = idleLoopState[i].looped = false;
+	}
+}
+
+//whether the cpu is stuck until an event, so that it can't change anything the other one is polling.
+//the other cpu may have written to the code or the registers' targets since this one last went
+//around, so the loop is checked again rather than trusted from then.
+template<int PROCNUM>
+static FORCEINLINE bool idleLoopParked()
+{
+	const armcpu_t &cpu = PROCNUM ? NDS_ARM7 : NDS_ARM9;
+	const IdleLoopState &state = idleLoopState[PROCNUM];
+	if(cpu.waitIRQ) return true;
+	if(!state.looped || state.head != (cpu.instruct_adr | cpu.CPSR.bits.T)) return false;
+	return idleLoopCheck<PROCNUM>(cpu.instruct_adr, cpu.CPSR.bits.T);
+}
+
+//called after the cpu ran from lastpc. returns the time it may jump to, which is its own time unless
+//it just went around an idle loop. with the interpreter each pass ends on the backward branch; with
+//the jit it ends when a block returns, and arm_jit.cpp doesn't chain blocks around idle loops.
+template<int PROCNUM>
+static FORCEINLINE s32 idleLoopSkip(u32 lastpc, s32 time, s32 limit)
+{
+	const armcpu_t &cpu = PROCNUM ? NDS_ARM7 : NDS_ARM9;
+	IdleLoopState &state = idleLoopState[PROCNUM];
+	const u32 pc = cpu.instruct_adr;
+	const u32 key = pc | cpu.CPSR.bits.T;
+
+	//getting to the head from anywhere but the loop itself, like falling into it or through
+	//an outer loop, means the next pass is a first arrival again
+	if(state.head == key && (lastpc < pc || lastpc > state.end))
+		state.looped = false;
+
+	if(pc > lastpc || lastpc - pc >= IDLELOOP_MAX_INSNS*4) return time;
+
+	if(state.head != key)
+	{
+		state.head = key;
+		state.looped = false;
+		state.idle = idleLoopCheck<PROCNUM>(pc, cpu.CPSR.bits.T, &state.end);
+		return time;
+	}
+	if(!state.idle) return time;
+
+	state.looped = true;
+	if(time >= limit) return time;
+	if(!idleLoopCheck<PROCNUM>(pc, cpu.CPSR.bits.T))
+	{
+		state.idle = state.looped = false;
+		return time;
+	}
+	idleLoopStats[PROCNUM].skips++;
+	idleLoopStats[PROCNUM].cycles += limit - time;
+	nds.idleCycles[PROCNUM] += limit - time;
+	return limit;
+}
+
 //these have not been tuned very well yet.
 static const int kMaxWork = 4000;
 static const int kIrqWait = 4000;
@@ -1839,11 +2577,16 @@ static /*donotinline*/ std::pair<s32,s32> armInnerLoop(
 			{
 				arm9log();
 				debug();
+				const u32 lastpc = NDS_ARM9.instruct_adr;
 #ifdef HAVE_JIT
+				// chained blocks may keep going until the point where this loop would switch cpus
+				if(jit) arm_jit_chain_budget = (doarm7 ? min(s32next, arm7) : s32next) - arm9;
 				arm9 += armcpu_exec<ARMCPU_ARM9,jit>();
 #else
 				arm9 += armcpu_exec<ARMCPU_ARM9>();
 #endif
+				if(CommonSettings.idle_loop_skip)
+					arm9 = idleLoopSkip<ARMCPU_ARM9>(lastpc, arm9, (doarm7 && !idleLoopParked<ARMCPU_ARM7>()) ? min(s32next, arm7) : s32next);
 				#ifdef DEVELOPER
 					nds_debug_continuing[0] = false;
 				#endif
@@ -1861,11 +2604,15 @@ static /*donotinline*/ std::pair<s32,s32> armInnerLoop(
 			if(!NDS_ARM7.waitIRQ&&!nds.freezeBus)
 			{
 				arm7log();
+				const u32 lastpc = NDS_ARM7.instruct_adr;
 #ifdef HAVE_JIT
+				if(jit) arm_jit_chain_budget = ((doarm9 ? min(s32next, arm9) : s32next) - arm7 + 1) >> 1;
 				arm7 += (armcpu_exec<ARMCPU_ARM7,jit>()<<1);
 #else
 				arm7 += (armcpu_exec<ARMCPU_ARM7>()<<1);
 #endif
+				if(CommonSettings.idle_loop_skip)
+					arm7 = idleLoopSkip<ARMCPU_ARM7>(lastpc, arm7, (doarm9 && !idleLoopParked<ARMCPU_ARM9>()) ? min(s32next, arm9) : s32next);
 				#ifdef DEVELOPER
 					nds_debug_continuing[1] = false;
 				#endif
@@ -1922,6 +2669,16 @@ void NDS_exec(s32 nb)
 
 	LagFrameFlag=1;
 
+#if defined(HAVE_LUA) && defined(HAVE_JIT)
+	//the JIT builds exec hooks into its blocks, so blocks compiled before they changed have to go
+	if(hookedExecRegionsChanged)
+	{
+		hookedExecRegionsChanged = false;
+		if(CommonSettings.use_jit)
+			arm_jit_reset(true, true);
+	}
+#endif
+
 	sequencer.nds_vblankEnded = false;
 
 	nds.cpuloopIterationCount = 0;
@@ -2057,6 +2814,7 @@ void NDS_exec(s32 nb)
 	}
 	currFrameCounter++;
 	DEBUG_Notify.NextFrame();
+	MMU_new.backupDevice.autoFlush();
 	if(cheats) cheats->process(CHEAT_TYPE_INTERNAL);
 
         #ifdef GDB_STUB
@@ -2554,6 +3312,7 @@ void NDS_Reset()
 	#ifdef HAVE_JIT
 		arm_jit_reset(CommonSettings.use_jit);
 	#endif
+	idleLoopReset();
 
 
 	//initialize CP15 specially for this platform
@@ -2591,6 +3350,7 @@ void NDS_Reset()
 	memcpy(&TSCal, firmware->getTouchCalibrate(), sizeof(TSCalInfo));
 
 	GPU->Reset();
+	GPU->SetWillRenderEnginesInParallel(CommonSettings.GPU_ParallelEngines);
 
 	WIFI_Reset();
 	memcpy(FW_Mac, (MMU.fw.data + 0x36), 6);
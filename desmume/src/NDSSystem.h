@@ -148,8 +148,30 @@ void emu_halt();
 extern u64 nds_timer;
 void NDS_Reschedule();
 void NDS_RescheduleGXFIFO(u32 cost);
-void NDS_RescheduleDMA();
+void NDS_RescheduleDMA(int procnum, int chan);
 void NDS_RescheduleTimers();
+void NDS_RescheduleDivSqrt();
+
+//lets hardware that keeps its own time (wifi, slot-2 devices, the rtc) be called back by the sequencer
+//without a slot of its own in NDSSystem.cpp. register the event once, then schedule it for a time on the
+//nds_timer clock whenever it is needed. exec() runs once that time is reached, after any built-in hardware
+//that is due too, and may schedule the event again. pending events are saved in savestates and matched
+//up again by the order they were registered in, so register them in a fixed order (at startup). a reset
+//cancels them all, since nds_timer starts over, so the owner has to schedule its events again after one.
+class NDSEvent
+{
+public:
+	NDSEvent() : seqIndex(-1) {}
+	virtual ~NDSEvent() {}
+	virtual void exec() = 0;
+
+	int seqIndex; //assigned by NDS_RegisterEvent
+};
+
+void NDS_RegisterEvent(NDSEvent *ev);
+void NDS_UnregisterEvent(NDSEvent *ev);
+void NDS_ScheduleEvent(NDSEvent *ev, u64 timestamp);
+void NDS_CancelEvent(NDSEvent *ev);
 
 enum ENSATA_HANDSHAKE
 {
@@ -316,12 +338,14 @@ struct GameInfo
 	void *fROM;
 	ROMReader_struct *reader;
 	u8	*romdata;
+	bool romdataIsMapped; //romdata points into the file mapped by MMAPROMReader, rather than being our own copy
 	u32 romsize;
 	u32 cardSize;
 	u32 mask;
 	u32 crc;
 	u32 chipID;
 	u32 lastReadPos;
+	u32 prefetchBegin, prefetchEnd;
 	u32	romType;
 	u32 headerOffset;
 	char ROMserial[20];
@@ -335,12 +359,15 @@ struct GameInfo
 
 	GameInfo() :	fROM(NULL),
 					romdata(NULL),
+					romdataIsMapped(false),
 					crc(0),
 					chipID(0x00000FC2),
 					romsize(0),
 					cardSize(0),
 					mask(0),
 					lastReadPos(0xFFFFFFFF),
+					prefetchBegin(0),
+					prefetchEnd(0),
 					romType(ROM_NDS),
 					headerOffset(0),
 					_isDSiEnhanced(false)
@@ -355,6 +382,7 @@ struct GameInfo
 	bool loadROM(std::string fname, u32 type = ROM_NDS);
 	void closeROM();
 	u32 readROM(u32 pos);
+	void prefetchROM(u32 pos);
 	bool ValidateHeader();
 	void populate();
 	bool isDSiEnhanced();
@@ -447,6 +475,18 @@ int NDS_LoadROM(const char *filename, const char* physicalFilename=0, const char
 void NDS_FreeROM(void);
 void NDS_Reset();
 
+//polling loops skipped with CommonSettings.idle_loop_skip, counted since the rom was loaded
+struct IdleLoopStats
+{
+	u32 loops;		//loops found that can be skipped
+	u32 skips;
+	u64 cycles;		//in arm9 cycles
+};
+extern IdleLoopStats idleLoopStats[2];
+
+//whether the code at adr is a polling loop that can't change anything until an event or the other cpu does
+bool NDS_IsIdleLoop(int procnum, u32 adr, bool thumb);
+
 bool NDS_LegitBoot();
 bool NDS_FakeBoot();
 
@@ -486,9 +526,12 @@ extern struct TCommonSettings {
 		, GFX3D_Renderer_TextureScalingFactor(1) // Possible values: 1, 2, 4
 		, GFX3D_Renderer_TextureDeposterize(false)
 		, GFX3D_Renderer_TextureSmoothing(false)
+		, GFX3D_Renderer_Pipelined(false)
+		, GPU_ParallelEngines(false)
 		, GFX3D_TXTHack(false)
 		, GFX3D_PrescaleHD(1)
 		, jit_max_block_size(100)
+		, jit_profile(false)
 		, loadToMemory(false)
 		, UseExtBIOS(false)
 		, SWIFromBIOS(false)
@@ -499,8 +542,12 @@ extern struct TCommonSettings {
 		, DebugConsole(false)
 		, EnsataEmulation(false)
 		, cheatsDisable(false)
+		, thread_spin(false)
+		, thread_affinity(0)
 		, rigorous_timing(false)
 		, advanced_timing(true)
+		, idle_loop_skip(false)
+		, fastmem(false)
 		, micMode(InternalNoise)
 		, spuInterpolationMode(1)
 		, manualBackupType(0)
@@ -549,6 +596,13 @@ extern struct TCommonSettings {
 	int GFX3D_Renderer_TextureScalingFactor;
 	bool GFX3D_Renderer_TextureDeposterize;
 	bool GFX3D_Renderer_TextureSmoothing;
+	
+	//lets the 3D renderer run alongside the whole of the next frame's emulation, at the
+	//cost of displaying the 3D layer one frame late. captures of the 3D layer still sync.
+	bool GFX3D_Renderer_Pipelined;
+
+	//renders each sub engine line on a worker while the main engine renders the same line. applied on reset
+	bool GPU_ParallelEngines;
 	bool GFX3D_TXTHack;
 
 	//may not want this on OSX port
@@ -576,6 +630,11 @@ extern struct TCommonSettings {
 
 	int num_cores;
 	bool single_core() { return num_cores==1; }
+
+	//the task pool's threads spin for a while before sleeping, and may only run on the cores in this mask (0 for any)
+	bool thread_spin;
+	u64 thread_affinity;
+
 	bool rigorous_timing;
 
 	int StylusPressure;
@@ -585,8 +644,14 @@ extern struct TCommonSettings {
 	
 	FAST_ALIGN bool advanced_timing;
 
+	bool idle_loop_skip;
+
+	//read WRAM, ITCM and VRAM through a page table instead of the address decoding in the MMU handlers. applied on reset
+	bool fastmem;
+
 	bool use_jit;
 	u32	jit_max_block_size;
+	bool jit_profile;
 	
 	struct _Wifi {
 		int mode;
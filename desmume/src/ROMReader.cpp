@@ -21,6 +21,11 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <stdio.h>
+#ifdef HAVE_ROMREADER_MMAP
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #ifdef HAVE_LIBZZIP
 #include <zzip/zzip.h>
 #endif
@@ -47,7 +52,11 @@ ROMReader_struct * ROMReaderInit(char ** filename)
 		return &ZIPROMReader;
 	}
 #endif
+#ifdef HAVE_ROMREADER_MMAP
+	return &MMAPROMReader;
+#else
 	return &STDROMReader;
+#endif
 }
 
 void * STDROMReaderInit(const char * filename);
@@ -112,6 +121,129 @@ int STDROMReaderRead(void * file, void * buffer, u32 size)
 	return fread(buffer, 1, size, (FILE*)file);
 }
 
+#ifdef HAVE_ROMREADER_MMAP
+void * MMAPROMReaderInit(const char * filename);
+void MMAPROMReaderDeInit(void *);
+u32 MMAPROMReaderSize(void *);
+int MMAPROMReaderSeek(void *, int, int);
+int MMAPROMReaderRead(void *, void *, u32);
+
+ROMReader_struct MMAPROMReader =
+{
+	ROMREADER_MMAP,
+	"Memory Mapped ROM Reader",
+	MMAPROMReaderInit,
+	MMAPROMReaderDeInit,
+	MMAPROMReaderSize,
+	MMAPROMReaderSeek,
+	MMAPROMReaderRead
+};
+
+struct MMAPROMFile
+{
+	u8 *data;
+	u32 size;
+	u32 pos;
+};
+
+void * MMAPROMReaderInit(const char * filename)
+{
+	struct stat sb;
+	if (stat(filename, &sb) == -1)
+		return 0;
+
+	if ((sb.st_mode & S_IFMT) != S_IFREG || sb.st_size == 0 || (u64)sb.st_size > 0xFFFFFFFFULL)
+		return 0;
+
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1)
+		return 0;
+
+	//writable but private, so that the rom can still be patched in memory like a loaded copy could
+	void *data = mmap(NULL, (size_t)sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return 0;
+
+	MMAPROMFile *file = new MMAPROMFile;
+	file->data = (u8 *)data;
+	file->size = (u32)sb.st_size;
+	file->pos = 0;
+	return (void *) file;
+}
+
+void MMAPROMReaderDeInit(void * file)
+{
+	if (!file) return ;
+	MMAPROMFile *mfile = (MMAPROMFile *)file;
+	munmap(mfile->data, mfile->size);
+	delete mfile;
+}
+
+u32 MMAPROMReaderSize(void * file)
+{
+	if (!file) return 0 ;
+	return ((MMAPROMFile *)file)->size;
+}
+
+int MMAPROMReaderSeek(void * file, int offset, int whence)
+{
+	if (!file) return 0 ;
+	MMAPROMFile *mfile = (MMAPROMFile *)file;
+
+	s64 pos;
+	switch (whence)
+	{
+		case SEEK_SET: pos = offset; break;
+		case SEEK_CUR: pos = (s64)mfile->pos + offset; break;
+		case SEEK_END: pos = (s64)mfile->size + offset; break;
+		default: return -1;
+	}
+
+	if (pos < 0)
+		return -1;
+
+	mfile->pos = (pos > (s64)mfile->size) ? mfile->size : (u32)pos;
+	return 0;
+}
+
+int MMAPROMReaderRead(void * file, void * buffer, u32 size)
+{
+	if (!file) return 0 ;
+	MMAPROMFile *mfile = (MMAPROMFile *)file;
+
+	if (size > mfile->size - mfile->pos)
+		size = mfile->size - mfile->pos;
+
+	memcpy(buffer, mfile->data + mfile->pos, size);
+	mfile->pos += size;
+	return size;
+}
+
+u8 * MMAPROMReaderData(void * file)
+{
+	if (!file) return 0 ;
+	return ((MMAPROMFile *)file)->data;
+}
+
+void MMAPROMReaderPrefetch(void * file, u32 offset, u32 size)
+{
+	if (!file) return ;
+	MMAPROMFile *mfile = (MMAPROMFile *)file;
+
+	if (offset >= mfile->size)
+		return;
+	if (size > mfile->size - offset)
+		size = mfile->size - offset;
+
+	//madvise wants a page aligned address
+	const size_t pageMask = (size_t)sysconf(_SC_PAGESIZE) - 1;
+	const size_t begin = (size_t)(mfile->data + offset) & ~pageMask;
+	const size_t end = (size_t)(mfile->data + offset + size);
+	madvise((void *)begin, end - begin, MADV_WILLNEED);
+}
+#endif
+
 #ifdef HAVE_LIBZ
 void * GZIPROMReaderInit(const char * filename);
 void GZIPROMReaderDeInit(void *);
@@ -27,6 +27,11 @@
 #define ROMREADER_STD	0
 #define ROMREADER_GZIP	1
 #define ROMREADER_ZIP	2
+#define ROMREADER_MMAP	3
+
+#ifndef WIN32
+#define HAVE_ROMREADER_MMAP
+#endif
 
 typedef struct
 {
@@ -46,5 +51,14 @@ extern ROMReader_struct GZIPROMReader;
 #ifdef HAVE_LIBZZIP
 extern ROMReader_struct ZIPROMReader;
 #endif
+#ifdef HAVE_ROMREADER_MMAP
+extern ROMReader_struct MMAPROMReader;
+
+//the whole file as mapped by MMAPROMReader. the mapping is private, so writing to it
+//(such as DLDI patching) only changes our copy of the touched pages and never the file
+u8 * MMAPROMReaderData(void * file);
+//hints that the given range of the file is about to be read
+void MMAPROMReaderPrefetch(void * file, u32 offset, u32 size);
+#endif
 
 ROMReader_struct * ROMReaderInit(char ** filename);
@@ -30,6 +30,7 @@
 #include <string.h>
 #include <queue>
 #include <vector>
+#include <algorithm>
 
 #include "debug.h"
 #include "driver.h"
@@ -41,6 +42,10 @@
 #include "NDSSystem.h"
 #include "matrix.h"
 
+#ifdef ENABLE_SSE4_1
+#include <smmintrin.h>
+#endif
+
 
 static inline s16 read16(u32 addr) { return (s16)_MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(addr); }
 static inline u8 read08(u32 addr) { return _MMU_read08<ARMCPU_ARM7,MMU_AT_DEBUG>(addr); }
@@ -126,6 +131,206 @@ static FORCEINLINE T MinMax(T val, T min, T max)
 	return val;
 }
 
+//------------------------------------------
+//decoded ADPCM cache
+//
+//ADPCM can only be decoded serially, and the same sounds get decoded again every time they loop or
+//are replayed. so sounds in main memory are decoded into a cache instead, a whole block at a time as
+//channels get to them, keeping the decoder state after every sample. channels playing a sound then
+//just pick up the samples they advance through, provided that they enter them in the state that the
+//cache has for the sample before (which is the case unless they got there some other way, like a
+//savestate made with different data).
+//writes to main memory stamp the blocks that they land in (see MMU_mainMemMarkDirty), and a sound is
+//dropped as soon as a channel reaches data that has been written since the sound was cached. it is
+//only cached again after it has played all the way through without any more writes, so that streamed
+//sounds which are refilled while they play keep getting decoded serially as before.
+
+#define ADPCM_CACHE_SLOTS 32
+#define ADPCM_CACHE_MAX_WORDS 0x4000
+#define ADPCM_CACHE_EVICT_AGE 0x10000
+#define ADPCM_CACHE_BLOCK_SAMPLES 0x1000
+#define ADPCM_CACHE_MIN_SAMPLES 2
+
+struct SPU_ADPCMCacheSlot
+{
+	SPU_ADPCMCacheSlot() : addr(0), loopstart(0), totlength(0), lastUse(0), decodedEnd(0), quietSamples(0), stamp(0), isValid(false) {}
+	u32 addr;
+	u16 loopstart;
+	u32 totlength;
+	u32 lastUse;
+	u32 decodedEnd; //samples before this one have been decoded
+	u32 quietSamples; //samples played since a write to the sound was last noticed, while it isn't valid
+	u64 stamp; //main memory write stamp from when the sound was cached, or last checked while it isn't valid
+	bool isValid;
+	std::vector<s16> pcm; //decoder state after each sample. sample 7 holds the state from the header
+	std::vector<u8> index;
+};
+
+class SPU_ADPCMCache
+{
+public:
+	SPU_ADPCMCache() : clock(0) { memset(channelSlot, 0, sizeof(channelSlot)); }
+	void reset();
+	FORCEINLINE SPU_ADPCMCacheSlot* find(const channel_struct *chan, const u32 endExclusive);
+
+private:
+	SPU_ADPCMCacheSlot* findSlow(const channel_struct *chan, const u32 endExclusive);
+	static void restart(SPU_ADPCMCacheSlot &slot);
+	static void decode(SPU_ADPCMCacheSlot &slot, const u32 endExclusive);
+
+	u32 clock;
+	SPU_ADPCMCacheSlot slot[ADPCM_CACHE_SLOTS];
+	SPU_ADPCMCacheSlot *channelSlot[16]; //the slot each channel used last, to skip the lookup
+};
+
+void SPU_ADPCMCache::reset()
+{
+	for (size_t i = 0; i < ADPCM_CACHE_SLOTS; i++)
+	{
+		slot[i].addr = 0;
+		slot[i].loopstart = 0;
+		slot[i].totlength = 0;
+		slot[i].lastUse = 0;
+		slot[i].decodedEnd = 0;
+		slot[i].quietSamples = 0;
+		slot[i].stamp = 0;
+		slot[i].isValid = false;
+		std::vector<s16>().swap(slot[i].pcm);
+		std::vector<u8>().swap(slot[i].index);
+	}
+
+	memset(channelSlot, 0, sizeof(channelSlot));
+}
+
+//throws away whatever was decoded, and starts tracking writes to the sound from now on
+void SPU_ADPCMCache::restart(SPU_ADPCMCacheSlot &slot)
+{
+	slot.stamp = MMU_mainMemNewStamp();
+	slot.decodedEnd = 0;
+	slot.quietSamples = 0;
+	slot.isValid = true;
+}
+
+//decodes whole blocks of the sound until the samples before endExclusive are all there
+void SPU_ADPCMCache::decode(SPU_ADPCMCacheSlot &slot, const u32 endExclusive)
+{
+	//find() made sure that the sound and the word past its end are contiguous in main memory
+	u8 *src = MMU.MAIN_MEM + (slot.addr & _MMU_MAIN_MEM_MASK);
+
+	if (slot.decodedEnd == 0)
+	{
+		slot.pcm[7] = (s16)T1ReadWord(src, 0);
+		slot.index[7] = src[2] & 0x7F;
+		slot.decodedEnd = 8;
+	}
+
+	const u32 end = std::min<u32>((u32)slot.pcm.size(), (endExclusive + ADPCM_CACHE_BLOCK_SAMPLES - 1) & ~(ADPCM_CACHE_BLOCK_SAMPLES - 1));
+	s32 pcm16b = slot.pcm[slot.decodedEnd - 1];
+	int index = slot.index[slot.decodedEnd - 1];
+
+	for (u32 i = slot.decodedEnd; i < end; i++)
+	{
+		const u32 data4bit = ((u32)src[i >> 1]) >> ((i & 1) << 2);
+
+		const s32 diff = precalcdifftbl[index][data4bit & 0xF];
+		index = precalcindextbl[index][data4bit & 0x7];
+		pcm16b = MinMax(pcm16b+diff, -0x8000, 0x7FFF);
+
+		slot.pcm[i] = pcm16b;
+		slot.index[i] = index;
+	}
+
+	slot.decodedEnd = end;
+}
+
+//returns the slot holding the sound that chan is playing, if it can take the samples up to endExclusive from there
+FORCEINLINE SPU_ADPCMCacheSlot* SPU_ADPCMCache::find(const channel_struct *chan, const u32 endExclusive)
+{
+	clock++;
+
+	//the usual case is a channel carrying on through a sound that has been decoded far enough already
+	SPU_ADPCMCacheSlot *thisSlot = channelSlot[chan->num];
+	const u32 first = chan->lastsampcnt + 1;
+	if (thisSlot == NULL || !thisSlot->isValid || endExclusive > thisSlot->decodedEnd || first < 8 || endExclusive <= first ||
+		thisSlot->addr != chan->addr || thisSlot->loopstart != chan->loopstart || thisSlot->totlength != chan->totlength)
+		return findSlow(chan, endExclusive);
+
+	thisSlot->lastUse = clock;
+
+	//only the data that this channel is about to go through has to be unchanged
+	if (MMU_mainMemChangedSince(chan->addr + (first >> 1), ((endExclusive - 1) >> 1) - (first >> 1) + 1, thisSlot->stamp))
+		return findSlow(chan, endExclusive);
+
+	if (thisSlot->pcm[first - 1] != chan->pcm16b || thisSlot->index[first - 1] != chan->index)
+		return NULL;
+
+	return thisSlot;
+}
+
+SPU_ADPCMCacheSlot* SPU_ADPCMCache::findSlow(const channel_struct *chan, const u32 endExclusive)
+{
+	SPU_ADPCMCacheSlot *thisSlot = channelSlot[chan->num];
+	if (thisSlot == NULL || thisSlot->addr != chan->addr || thisSlot->loopstart != chan->loopstart || thisSlot->totlength != chan->totlength)
+	{
+		//only sounds in main memory are cached, since they can be read in one piece and their writes are tracked
+		const u32 byteLength = (chan->totlength + 1) << 2;
+		if (chan->totlength == 0 || chan->totlength > ADPCM_CACHE_MAX_WORDS ||
+			(chan->addr & 0x0F000000) != 0x02000000 || (chan->addr & _MMU_MAIN_MEM_MASK) + byteLength > _MMU_MAIN_MEM_MASK + 1)
+			return NULL;
+
+		thisSlot = &slot[(chan->addr * 2654435761U) >> 27];
+
+		if (thisSlot->addr != chan->addr || thisSlot->loopstart != chan->loopstart || thisSlot->totlength != chan->totlength || thisSlot->pcm.empty())
+		{
+			//don't let two sounds playing at once keep kicking each other out of the same slot
+			if (!thisSlot->pcm.empty() && (clock - thisSlot->lastUse) < ADPCM_CACHE_EVICT_AGE)
+				return NULL;
+
+			//the decoder can go through the word past the end before a channel notices that it has to loop
+			thisSlot->addr = chan->addr;
+			thisSlot->loopstart = chan->loopstart;
+			thisSlot->totlength = chan->totlength;
+			thisSlot->pcm.resize((chan->totlength + 1) << 3);
+			thisSlot->index.resize((chan->totlength + 1) << 3);
+			restart(*thisSlot);
+		}
+
+		channelSlot[chan->num] = thisSlot;
+	}
+
+	thisSlot->lastUse = clock;
+
+	const u32 first = chan->lastsampcnt + 1;
+	if (first < 8 || endExclusive <= first || endExclusive > thisSlot->pcm.size())
+		return NULL;
+
+	const u32 firstByte = chan->addr + (first >> 1);
+	const u32 byteCount = ((endExclusive - 1) >> 1) - (first >> 1) + 1;
+	if (MMU_mainMemChangedSince(firstByte, byteCount, thisSlot->stamp))
+	{
+		restart(*thisSlot);
+		thisSlot->isValid = false;
+		return NULL;
+	}
+
+	if (!thisSlot->isValid)
+	{
+		thisSlot->quietSamples += endExclusive - first;
+		if (thisSlot->quietSamples <= (thisSlot->totlength << 3))
+			return NULL;
+
+		restart(*thisSlot);
+	}
+
+	if (endExclusive > thisSlot->decodedEnd)
+		decode(*thisSlot, endExclusive);
+
+	if (thisSlot->pcm[first - 1] != chan->pcm16b || thisSlot->index[first - 1] != chan->index)
+		return NULL;
+
+	return thisSlot;
+}
+
 //--------------external spu interface---------------
 
 int SPU_ChangeSoundCore(int coreid, int buffersize)
@@ -319,6 +524,8 @@ void SPU_struct::reset()
 
 	reconstruct(&regs);
 
+	adpcmCache->reset();
+
 	for(int i = 0; i < 16; i++)
 	{
 		channels[i].num = i;
@@ -334,6 +541,7 @@ SPU_struct::SPU_struct(int buffersize)
 {
 	sndbuf = new s32[buffersize*2];
 	outbuf = new s16[buffersize*2];
+	adpcmCache = new SPU_ADPCMCache();
 	reset();
 }
 
@@ -341,6 +549,7 @@ SPU_struct::~SPU_struct()
 {
 	if(sndbuf) delete[] sndbuf;
 	if(outbuf) delete[] outbuf;
+	delete adpcmCache;
 }
 
 void SPU_DeInit(void)
@@ -1089,7 +1298,23 @@ template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE void Fetch16B
 		*data = read16(chan->addr + sputrunc(chan->sampcnt)*2);
 }
 
-template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE void FetchADPCMData(channel_struct * const chan, s32 * const data)
+static FORCEINLINE void DecodeADPCMCached(channel_struct * const chan, const SPU_ADPCMCacheSlot * const cacheSlot, const u32 endExclusive)
+{
+	const u32 first = chan->lastsampcnt + 1;
+	const u32 last = endExclusive - 1;
+
+	chan->pcm16b_last = cacheSlot->pcm[last - 1];
+	chan->pcm16b = cacheSlot->pcm[last];
+	chan->index = cacheSlot->index[last];
+
+	const u32 loopSample = (u32)chan->loopstart << 3;
+	if (loopSample >= first && loopSample <= last) {
+		chan->loop_pcm16b = cacheSlot->pcm[loopSample];
+		chan->loop_index = cacheSlot->index[loopSample];
+	}
+}
+
+template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE void FetchADPCMData(SPU_struct * const SPU, channel_struct * const chan, s32 * const data)
 {
 	if (chan->sampcnt < 8)
 	{
@@ -1101,21 +1326,32 @@ template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE void FetchADP
 	if (chan->lastsampcnt != sputrunc(chan->sampcnt)){
 
 		const u32 endExclusive = sputrunc(chan->sampcnt+1);
-		for (u32 i = chan->lastsampcnt+1; i < endExclusive; i++)
+
+		//a single sample gets decoded about as quickly as it can be looked up, so the cache only
+		//pays off for channels going through more than one sample per output sample
+		const SPU_ADPCMCacheSlot *cacheSlot = NULL;
+		if ((endExclusive - chan->lastsampcnt - 1) >= ADPCM_CACHE_MIN_SAMPLES)
+			cacheSlot = SPU->adpcmCache->find(chan, endExclusive);
+		if (cacheSlot != NULL)
+			DecodeADPCMCached(chan, cacheSlot, endExclusive);
+		else
 		{
-			const u32 shift = (i&1)<<2;
-			const u32 data4bit = ((u32)read08(chan->addr + (i>>1))) >> shift;
+			for (u32 i = chan->lastsampcnt+1; i < endExclusive; i++)
+			{
+				const u32 shift = (i&1)<<2;
+				const u32 data4bit = ((u32)read08(chan->addr + (i>>1))) >> shift;
 
-			const s32 diff = precalcdifftbl[chan->index][data4bit & 0xF];
-			chan->index = precalcindextbl[chan->index][data4bit & 0x7];
+				const s32 diff = precalcdifftbl[chan->index][data4bit & 0xF];
+				chan->index = precalcindextbl[chan->index][data4bit & 0x7];
 
-			chan->pcm16b_last = chan->pcm16b;
-			chan->pcm16b = MinMax(chan->pcm16b+diff, -0x8000, 0x7FFF);
+				chan->pcm16b_last = chan->pcm16b;
+				chan->pcm16b = MinMax(chan->pcm16b+diff, -0x8000, 0x7FFF);
 
-			if(i == (chan->loopstart<<3)) {
-				if(chan->loop_index != K_ADPCM_LOOPING_RECOVERY_INDEX) printf("over-snagging\n");
-				chan->loop_pcm16b = chan->pcm16b;
-				chan->loop_index = chan->index;
+				if(i == ((u32)chan->loopstart<<3)) {
+					if(chan->loop_index != K_ADPCM_LOOPING_RECOVERY_INDEX) printf("over-snagging\n");
+					chan->loop_pcm16b = chan->pcm16b;
+					chan->loop_index = chan->index;
+				}
 			}
 		}
 
@@ -1260,6 +1496,172 @@ static FORCEINLINE void TestForLoop2(SPU_struct *SPU, channel_struct *chan)
 	}
 }
 
+#ifdef ENABLE_SSE2
+
+#define SPU_MIX_BLOCK_SIZE 64
+
+//same as spumuldiv7(), for four values at once. the values must fit in 16 bits, which
+//holds for channel samples both before and after the channel volume is applied.
+static FORCEINLINE __m128i spumuldiv7_SSE2(const __m128i &val, const u8 multiplier)
+{
+	if (multiplier == 127)
+		return val;
+	
+	return _mm_srai_epi32(_mm_madd_epi16(val, _mm_set1_epi32(multiplier)), 7);
+}
+
+//same as Interpolate(), for four samples at once. the positions must not be negative.
+template<SPUInterpolationMode INTERPOLATE_MODE> static FORCEINLINE __m128i Interpolate_SSE2(const s32 *sampleA, const s32 *sampleB, const double *pos)
+{
+	const __m128i a = _mm_load_si128((__m128i *)sampleA);
+	if (INTERPOLATE_MODE == SPUInterpolation_None)
+		return a;
+	
+	const __m128i b = _mm_load_si128((__m128i *)sampleB);
+	
+	const __m128d a0 = _mm_cvtepi32_pd(a);
+	const __m128d a1 = _mm_cvtepi32_pd(_mm_shuffle_epi32(a, 0xEE));
+	const __m128d diff0 = _mm_sub_pd(_mm_cvtepi32_pd(b), a0);
+	const __m128d diff1 = _mm_sub_pd(_mm_cvtepi32_pd(_mm_shuffle_epi32(b, 0xEE)), a1);
+	
+	const __m128d pos0 = _mm_load_pd(pos + 0);
+	const __m128d pos1 = _mm_load_pd(pos + 2);
+	__m128d ratio0 = _mm_sub_pd(pos0, _mm_cvtepi32_pd(_mm_cvttpd_epi32(pos0)));
+	__m128d ratio1 = _mm_sub_pd(pos1, _mm_cvtepi32_pd(_mm_cvttpd_epi32(pos1)));
+	
+	if (INTERPOLATE_MODE == SPUInterpolation_Cosine)
+	{
+		CACHE_ALIGN s32 index[8];
+		_mm_store_si128((__m128i *)index + 0, _mm_cvttpd_epi32(_mm_mul_pd(ratio0, _mm_set1_pd((double)COSINE_INTERPOLATION_RESOLUTION))));
+		_mm_store_si128((__m128i *)index + 1, _mm_cvttpd_epi32(_mm_mul_pd(ratio1, _mm_set1_pd((double)COSINE_INTERPOLATION_RESOLUTION))));
+		ratio0 = _mm_setr_pd(cos_lut[index[0]], cos_lut[index[1]]);
+		ratio1 = _mm_setr_pd(cos_lut[index[4]], cos_lut[index[5]]);
+	}
+	
+	const __m128 result = _mm_movelh_ps( _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(ratio0, diff0), a0)),
+	                                     _mm_cvtpd_ps(_mm_add_pd(_mm_mul_pd(ratio1, diff1), a1)) );
+	
+	// Round down the same way that s32floor() does.
+	return _mm_srai_epi32(_mm_cvtps_epi32(_mm_add_ps(_mm_set1_ps(-0.5f), _mm_add_ps(result, result))), 1);
+}
+
+//renders a PCM8 or PCM16 channel in blocks of samples. the sample counter is stepped one
+//sample at a time, exactly like TestForLoop() does it, while the samples are fetched.
+//the interpolation and mixing are then done four samples at a time.
+template<int FORMAT, SPUInterpolationMode INTERPOLATE_MODE, int CHANNELS> 
+	static void SPU_ChanUpdatePCM_SSE2(SPU_struct* const SPU, channel_struct* const chan)
+{
+	CACHE_ALIGN double pos[SPU_MIX_BLOCK_SIZE];
+	CACHE_ALIGN s32 sampleA[SPU_MIX_BLOCK_SIZE];
+	CACHE_ALIGN s32 sampleB[SPU_MIX_BLOCK_SIZE];
+	CACHE_ALIGN s32 data[SPU_MIX_BLOCK_SIZE];
+	
+	const int shift = (FORMAT == 0 ? 2 : 1);
+	const u32 lastLoc = (chan->totlength << shift) - 1;
+	const __m128i volumeShift = _mm_cvtsi32_si128(volume_shift[chan->volumeDiv]);
+	
+	while (SPU->bufpos < SPU->buflength)
+	{
+		const size_t blockLength = std::min<size_t>(SPU_MIX_BLOCK_SIZE, SPU->buflength - SPU->bufpos);
+		size_t count = 0;
+		bool didStop = false;
+		
+		while ( (count < blockLength) && !didStop )
+		{
+			if (chan->sampcnt < 0)
+			{
+				pos[count] = 0.0;
+				sampleA[count] = 0;
+				sampleB[count] = 0;
+			}
+			else
+			{
+				const u32 loc = sputrunc(chan->sampcnt);
+				const s32 a = (FORMAT == 0) ? (s32)(read_s8(chan->addr + loc) << 8) : (s32)read16(chan->addr + loc*2);
+				s32 b = a;
+				
+				if ( (INTERPOLATE_MODE != SPUInterpolation_None) && (loc < lastLoc) )
+					b = (FORMAT == 0) ? (s32)(read_s8(chan->addr + loc + 1) << 8) : (s32)read16(chan->addr + loc*2 + 2);
+				
+				pos[count] = chan->sampcnt;
+				sampleA[count] = a;
+				sampleB[count] = b;
+			}
+			
+			count++;
+			chan->sampcnt += chan->sampinc;
+			
+			if (chan->sampcnt > chan->double_totlength_shifted)
+			{
+				// Do we loop? Or are we done?
+				if (chan->repeat == 1)
+				{
+					while (chan->sampcnt > chan->double_totlength_shifted)
+						chan->sampcnt -= chan->double_totlength_shifted - (double)(chan->loopstart << shift);
+				}
+				else
+				{
+					SPU->KeyOff(chan->num);
+					didStop = true;
+				}
+			}
+		}
+		
+		// Pad out the last group of four with silence.
+		for (size_t i = count; i < ((count + 3) & ~3); i++)
+		{
+			pos[i] = 0.0;
+			sampleA[i] = 0;
+			sampleB[i] = 0;
+		}
+		
+		s32 *sndbuf = SPU->sndbuf + (SPU->bufpos << 1);
+		
+		for (size_t i = 0; i < count; i += 4)
+		{
+			const __m128i sample = Interpolate_SSE2<INTERPOLATE_MODE>(sampleA + i, sampleB + i, pos + i);
+			_mm_store_si128((__m128i *)(data + i), sample);
+			
+			const __m128i vol = _mm_sra_epi32(spumuldiv7_SSE2(sample, chan->vol), volumeShift);
+			__m128i mixL;
+			__m128i mixR;
+			
+			switch (CHANNELS)
+			{
+				case 0: mixL = vol; mixR = _mm_setzero_si128(); break;
+				case 1: mixL = spumuldiv7_SSE2(vol, 127 - chan->pan); mixR = spumuldiv7_SSE2(vol, chan->pan); break;
+				case 2: mixL = _mm_setzero_si128(); mixR = vol; break;
+			}
+			
+			const __m128i mixLR0 = _mm_unpacklo_epi32(mixL, mixR);
+			const __m128i mixLR1 = _mm_unpackhi_epi32(mixL, mixR);
+			
+			if (i + 4 <= count)
+			{
+				_mm_storeu_si128((__m128i *)(sndbuf + (i*2) + 0), _mm_add_epi32(_mm_loadu_si128((__m128i *)(sndbuf + (i*2) + 0)), mixLR0));
+				_mm_storeu_si128((__m128i *)(sndbuf + (i*2) + 4), _mm_add_epi32(_mm_loadu_si128((__m128i *)(sndbuf + (i*2) + 4)), mixLR1));
+			}
+			else
+			{
+				CACHE_ALIGN s32 mixLR[8];
+				_mm_store_si128((__m128i *)mixLR + 0, mixLR0);
+				_mm_store_si128((__m128i *)mixLR + 1, mixLR1);
+				
+				for (size_t j = 0; j < (count - i) * 2; j++)
+					sndbuf[(i*2) + j] += mixLR[j];
+			}
+		}
+		
+		SPU->lastdata = data[count - 1];
+		SPU->bufpos += count;
+		
+		if (didStop)
+			SPU->bufpos = SPU->buflength;
+	}
+}
+
+#endif
+
 template<int CHANNELS> FORCEINLINE static void SPU_Mix(SPU_struct* SPU, channel_struct *chan, s32 data)
 {
 	switch(CHANNELS)
@@ -1275,6 +1677,15 @@ template<int CHANNELS> FORCEINLINE static void SPU_Mix(SPU_struct* SPU, channel_
 template<int FORMAT, SPUInterpolationMode INTERPOLATE_MODE, int CHANNELS> 
 	FORCEINLINE static void ____SPU_ChanUpdate(SPU_struct* const SPU, channel_struct* const chan)
 {
+#ifdef ENABLE_SSE2
+	// Longer runs of PCM samples, like the ones mixed for SPU_user, are done in blocks.
+	if ( (FORMAT == 0 || FORMAT == 1) && (CHANNELS != -1) && (SPU->buflength - SPU->bufpos >= 8) )
+	{
+		SPU_ChanUpdatePCM_SSE2<FORMAT,INTERPOLATE_MODE,CHANNELS>(SPU, chan);
+		return;
+	}
+#endif
+	
 	for (; SPU->bufpos < SPU->buflength; SPU->bufpos++)
 	{
 		if(CHANNELS != -1)
@@ -1284,7 +1695,7 @@ template<int FORMAT, SPUInterpolationMode INTERPOLATE_MODE, int CHANNELS>
 			{
 				case 0: Fetch8BitData<INTERPOLATE_MODE>(chan, &data); break;
 				case 1: Fetch16BitData<INTERPOLATE_MODE>(chan, &data); break;
-				case 2: FetchADPCMData<INTERPOLATE_MODE>(chan, &data); break;
+				case 2: FetchADPCMData<INTERPOLATE_MODE>(SPU, chan, &data); break;
 				case 3: FetchPSGData(chan, &data); break;
 			}
 			SPU_Mix<CHANNELS>(SPU, chan, data);
@@ -1636,13 +2047,37 @@ static void SPU_MixAudio(bool actuallyMix, SPU_struct *SPU, int length)
 
 	// convert from 32-bit->16-bit
 	if(actuallyMix && speakers)
-		for (int i = 0; i < length*2; i++)
+	{
+		int i = 0;
+		
+#ifdef ENABLE_SSE4_1
+		const __m128i vol_vec128 = _mm_set1_epi32(vol);
+		
+		for (; i < (length*2) - 7; i += 8)
+		{
+			__m128i out0 = _mm_loadu_si128((__m128i *)(SPU->sndbuf + i + 0));
+			__m128i out1 = _mm_loadu_si128((__m128i *)(SPU->sndbuf + i + 4));
+			
+			if (vol != 127)
+			{
+				out0 = _mm_srai_epi32(_mm_mullo_epi32(out0, vol_vec128), 7);
+				out1 = _mm_srai_epi32(_mm_mullo_epi32(out1, vol_vec128), 7);
+			}
+			
+			_mm_storeu_si128((__m128i *)(SPU->sndbuf + i + 0), out0);
+			_mm_storeu_si128((__m128i *)(SPU->sndbuf + i + 4), out1);
+			_mm_storeu_si128((__m128i *)(SPU->outbuf + i), _mm_packs_epi32(out0, out1));
+		}
+#endif
+		
+		for (; i < length*2; i++)
 		{
 			// Apply Master Volume
 			SPU->sndbuf[i] = spumuldiv7(SPU->sndbuf[i], vol);
 			s16 outsample = MinMax(SPU->sndbuf[i],-0x8000,0x7FFF);
 			SPU->outbuf[i] = outsample;
 		}
+	}
 
 
 }
@@ -142,6 +142,8 @@ public:
 	void reset();
 };
 
+class SPU_ADPCMCache;
+
 class SPU_struct
 {
 public:
@@ -153,6 +155,7 @@ public:
    s16 *outbuf;
    u32 bufsize;
    channel_struct channels[16];
+   SPU_ADPCMCache *adpcmCache;
 
    //registers
    struct REGS {
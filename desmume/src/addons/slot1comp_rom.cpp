@@ -25,6 +25,9 @@ void Slot1Comp_Rom::start(eSlot1Operation operation, u32 addr)
 {
 	this->operation = operation;
 	this->address = addr;
+
+	if (operation == eSlot1Operation_B7_Read)
+		gameInfo.prefetchROM(addr & gameInfo.mask);
 }
 
 u32 Slot1Comp_Rom::read()
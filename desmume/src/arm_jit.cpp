@@ -39,9 +39,11 @@
 #include "Disassembler.h"
 #include "MMU.h"
 #include "MMU_timing.h"
+#include "NDSSystem.h"
 #include "utils/AsmJit/AsmJit.h"
 #include "arm_jit.h"
 #include "bios.h"
+#include "emufile.h"
 
 #define LOG_JIT_LEVEL 0
 #define PROFILER_JIT_LEVEL 0
@@ -49,6 +51,9 @@
 #if (PROFILER_JIT_LEVEL > 0)
 #include <algorithm>
 #endif
+#include <vector>
+#include <map>
+#include <zlib.h>
 
 using namespace AsmJit;
 
@@ -192,6 +197,162 @@ DS_ALIGN(4096) uintptr_t compiled_funcs[1<<26] = {0};
 
 static u8 recompile_counts[(1<<26)/16];
 
+// Blocks are first compiled quickly (tier 1) and count their own executions.
+// Once a block has run JIT_HOT_THRESHOLD times it drops its entry from the dispatch
+// table, marks itself pending and gets recompiled with the more expensive optimizations
+// (tier 2) the next time the dispatcher reaches it.
+// The counters are hashed by address; a collision only promotes a block early.
+// Set to 0 to disable tiering.
+#define JIT_HOT_THRESHOLD 256
+#define JIT_HOT_INDEX(adr) ((((adr) >> 1) ^ ((adr) >> 17)) & 0xFFFF)
+#define JIT_HOT_COUNTER(adr, PROCNUM) hot_counts[PROCNUM][JIT_HOT_INDEX(adr)]
+#define JIT_HOT_PENDING(adr, PROCNUM) hot_pending[PROCNUM][JIT_HOT_INDEX(adr)]
+
+#if (JIT_HOT_THRESHOLD > 0)
+static u16 hot_counts[2][0x10000];
+static u8 hot_pending[2][0x10000];
+#endif
+
+// Blocks whose exit address is known at compile time call the next block directly
+// through its dispatch table entry instead of returning to armInnerLoop. Since the
+// link is the table entry itself, compiling the target patches it in and invalidating
+// the target unlinks it. The chain stops when the entry is empty, when the cycle budget
+// handed out by the dispatcher runs out, or when the cpu has to stop for the sequencer.
+// Each link is a nested call, so the chain also stops after JIT_CHAIN_MAX_DEPTH links,
+// which keeps the host stack bounded when a lot of short blocks fit in the budget.
+#define JIT_CHAIN_MAX_DEPTH 64
+s32 arm_jit_chain_budget = 0;
+static u32 chain_depth = 0;
+
+JITCacheStats arm_jit_cache_stats;
+
+static void recompile_count_dec(u32 adr)
+{
+	u32 mask_adr = (adr & 0x07FFFFFE) >> 4;
+	u32 shift = 4*(mask_adr & 1);
+	if((recompile_counts[mask_adr >> 1] >> shift) & 0xF)
+		recompile_counts[mask_adr >> 1] -= 1 << shift;
+}
+
+#if (JIT_HOT_THRESHOLD > 0)
+// Tier 2 blocks are remembered per game across runs. When such a block is reached again
+// and its code still hashes the same, it is compiled as tier 2 right away instead of
+// counting up to JIT_HOT_THRESHOLD in tier 1 first. Only the block addresses are kept:
+// the generated code embeds host addresses and specializes on the register values seen
+// while compiling, so it can't be reused as is.
+#define JIT_PROFILE_MAGIC 0x504A5344 // DSJP
+#define JIT_PROFILE_VERSION 2
+
+struct JIT_PROFILE_ENTRY
+{
+	u32 hash;
+	u32 size;
+	bool thumb;
+};
+
+static std::map<u32, JIT_PROFILE_ENTRY> jit_profile[2];
+static std::string jit_profile_fname;
+static u32 jit_profile_key;
+static bool jit_profile_dirty;
+
+template<int PROCNUM>
+static u32 profile_hash(u32 adr, u32 size, bool thumb)
+{
+	u32 hash = 0;
+	for(u32 i = 0; i < size; i += thumb ? 2 : 4)
+	{
+		u32 opcode = thumb ? _MMU_read16<PROCNUM, MMU_AT_CODE>(adr + i) : _MMU_read32<PROCNUM, MMU_AT_CODE>(adr + i);
+		hash = crc32(hash, (u8*)&opcode, thumb ? 2 : 4);
+	}
+	return hash;
+}
+
+template<int PROCNUM>
+static bool profile_is_hot(u32 adr, bool thumb)
+{
+	std::map<u32, JIT_PROFILE_ENTRY>::iterator it = jit_profile[PROCNUM].find(adr);
+	if(it == jit_profile[PROCNUM].end()) return false;
+	const JIT_PROFILE_ENTRY &e = it->second;
+	return (e.thumb == thumb) && (e.hash == profile_hash<PROCNUM>(adr, e.size, thumb));
+}
+
+static void profile_add(int PROCNUM, u32 adr, const u32 *opcodes, u32 count, bool thumb)
+{
+	JIT_PROFILE_ENTRY e;
+	e.hash = 0;
+	for(u32 i = 0; i < count; i++)
+		e.hash = crc32(e.hash, (u8*)&opcodes[i], thumb ? 2 : 4);
+	e.size = count * (thumb ? 2 : 4);
+	e.thumb = thumb;
+	jit_profile[PROCNUM][adr] = e;
+	jit_profile_dirty = true;
+}
+#endif
+
+void arm_jit_profile_save()
+{
+#if (JIT_HOT_THRESHOLD > 0)
+	if(jit_profile_fname.empty() || !jit_profile_dirty) return;
+
+	EMUFILE_FILE f(jit_profile_fname, "wb");
+	if(f.fail())
+	{
+		printf("JIT: can't write profile %s\n", jit_profile_fname.c_str());
+		return;
+	}
+	f.write32le(JIT_PROFILE_MAGIC);
+	f.write32le(JIT_PROFILE_VERSION);
+	f.write32le(jit_profile_key);
+	f.write32le((u32)(jit_profile[0].size() + jit_profile[1].size()));
+	for(int proc = 0; proc < 2; proc++)
+		for(std::map<u32, JIT_PROFILE_ENTRY>::iterator it = jit_profile[proc].begin(); it != jit_profile[proc].end(); ++it)
+		{
+			f.write32le((u32)proc);
+			f.write32le(it->first);
+			f.write32le(it->second.hash);
+			f.write32le(it->second.size | ((u32)it->second.thumb << 31));
+		}
+	jit_profile_dirty = false;
+#endif
+}
+
+void arm_jit_profile_load(const char *fname, u32 key)
+{
+#if (JIT_HOT_THRESHOLD > 0)
+	arm_jit_profile_save();
+	jit_profile[0].clear();
+	jit_profile[1].clear();
+	jit_profile_fname = fname ? fname : "";
+	jit_profile_key = key;
+	jit_profile_dirty = false;
+	if(jit_profile_fname.empty()) return;
+
+	EMUFILE_FILE f(jit_profile_fname, "rb");
+	if(f.fail()) return;
+	u32 magic = 0, version = 0, file_key = 0, count = 0;
+	f.read32le(&magic);
+	f.read32le(&version);
+	f.read32le(&file_key);
+	f.read32le(&count);
+	if(magic != JIT_PROFILE_MAGIC || version != JIT_PROFILE_VERSION || file_key != key)
+	{
+		printf("JIT: ignoring profile %s made for a different game or version\n", fname);
+		return;
+	}
+	for(u32 i = 0; i < count; i++)
+	{
+		u32 proc, adr, size;
+		JIT_PROFILE_ENTRY e;
+		if(f.read32le(&proc) != 1 || f.read32le(&adr) != 1 || f.read32le(&e.hash) != 1 || f.read32le(&size) != 1) break;
+		if(proc > 1) break;
+		e.size = size & 0x7FFFFFFF;
+		e.thumb = (size >> 31) != 0;
+		jit_profile[proc][adr] = e;
+	}
+	printf("JIT: loaded %u hot block(s) from %s\n", (u32)(jit_profile[0].size() + jit_profile[1].size()), fname);
+#endif
+}
+
 #ifdef HAVE_STATIC_CODE_BUFFER
 // On x86_64, allocate jitted code from a static buffer to ensure that it's within 2GB of .text
 // Allows call instructions to use pcrel offsets, as opposed to slower indirect calls.
@@ -201,11 +362,69 @@ static u8 recompile_counts[(1<<26)/16];
 DS_ALIGN(4096) static u8 scratchpad[1<<25];
 static u8 *scratchptr;
 
+// The scratchpad is filled one generation at a time. When the newest generation is full,
+// the oldest one is evicted and reused: the blocks compiled into it are dropped from the
+// dispatch table and get compiled again if they are still in use, while the rest of the
+// cache stays intact. Eviction only happens while compiling from the dispatcher, so no
+// evicted code can be on the stack (see emit_chain).
+#define JIT_CACHE_GENERATIONS 8
+#define JIT_CACHE_GENERATION_SIZE (sizeof(scratchpad) / JIT_CACHE_GENERATIONS)
+
+
+static u32 cache_generation;
+// start addresses of the blocks in each generation, with the cpu in bit 31
+static std::vector<u32> cache_blocks[JIT_CACHE_GENERATIONS];
+
+// -1 for code outside the scratchpad, e.g. op_decode
+static int cache_generation_of(uintptr_t code)
+{
+	if(code < (uintptr_t)scratchpad || code >= (uintptr_t)scratchpad + sizeof(scratchpad)) return -1;
+	return (code - (uintptr_t)scratchpad) / JIT_CACHE_GENERATION_SIZE;
+}
+
+static void cache_add_block(u32 adr, int PROCNUM, uintptr_t code)
+{
+	int gen = cache_generation_of(code);
+	if(gen >= 0)
+		cache_blocks[gen].push_back((adr & 0x0FFFFFFF) | ((u32)PROCNUM << 31));
+}
+
+static void cache_evict_generation(u32 gen)
+{
+	std::vector<u32> &blocks = cache_blocks[gen];
+	if(blocks.empty()) return;
+
+	for(size_t i = 0; i < blocks.size(); i++)
+	{
+		u32 adr = blocks[i] & 0x0FFFFFFF;
+		int proc = blocks[i] >> 31;
+		uintptr_t *func = &JIT_COMPILED_FUNC(adr, proc);
+		// the entry may have been recompiled into a newer generation since
+		if(cache_generation_of(*func) == (int)gen)
+		{
+			*func = 0;
+			// being evicted doesn't make a block self-modifying
+			recompile_count_dec(adr);
+		}
+	}
+	arm_jit_cache_stats.blocks_evicted += blocks.size();
+	arm_jit_cache_stats.evictions++;
+	blocks.clear();
+}
+
+static void cache_reset()
+{
+	for(int i = 0; i < JIT_CACHE_GENERATIONS; i++)
+		cache_blocks[i].clear();
+	cache_generation = 0;
+	scratchptr = scratchpad;
+}
+
 struct ASMJIT_API StaticCodeGenerator : public Context
 {
 	StaticCodeGenerator()
 	{
-		scratchptr = scratchpad;
+		cache_reset();
 		int align = (uintptr_t)scratchpad & (sysconf(_SC_PAGESIZE) - 1);
 		int err = mprotect(scratchpad-align, sizeof(scratchpad)+align, PROT_READ|PROT_WRITE|PROT_EXEC);
 		if(err)
@@ -223,14 +442,18 @@ struct ASMJIT_API StaticCodeGenerator : public Context
 			*dest = NULL;
 			return kErrorNoFunction;
 		}
-		if(size > (uintptr_t)(scratchpad+sizeof(scratchpad)-scratchptr))
+		if(size > JIT_CACHE_GENERATION_SIZE)
 		{
-			fprintf(stderr, "Out of memory for asmjit. Clearing code cache.\n");
-			arm_jit_reset(1);
-			// If arm_jit_reset didn't involve recompiling op_cmp, we could keep the current function.
+			fprintf(stderr, "JIT: block of %u bytes doesn't fit into the code cache.\n", (u32)size);
 			*dest = NULL;
 			return kErrorOk;
 		}
+		if(size > (uintptr_t)(scratchpad + (cache_generation + 1) * JIT_CACHE_GENERATION_SIZE - scratchptr))
+		{
+			cache_generation = (cache_generation + 1) % JIT_CACHE_GENERATIONS;
+			cache_evict_generation(cache_generation);
+			scratchptr = scratchpad + cache_generation * JIT_CACHE_GENERATION_SIZE;
+		}
 		void *p = scratchptr;
 		size = assembler->relocCode(p);
 		scratchptr += size;
@@ -328,8 +551,23 @@ static GpVar bb_profiler_entry;
 //-----------------------------------------------------------------------------
 //   Shifting macros
 //-----------------------------------------------------------------------------
+// Flag bits as they appear in flags_ptr (the high byte of CPSR)
+#define FLAG_N			0x80
+#define FLAG_Z			0x40
+#define FLAG_C			0x20
+#define FLAG_V			0x10
+#define FLAGS_NZ		(FLAG_N|FLAG_Z)
+#define FLAGS_NZC		(FLAG_N|FLAG_Z|FLAG_C)
+#define FLAGS_NZCV		(FLAG_N|FLAG_Z|FLAG_C|FLAG_V)
+
+// flags which are read before being overwritten by a later instruction of the block.
+// always FLAGS_NZCV unless the block is being recompiled as hot (see compile_basicblock)
+static u32 bb_flags_live = FLAGS_NZCV;
+#define FLAGS_DEAD(x) (!(bb_flags_live & (x)))
+
 #define SET_NZCV(sign) { \
 	JIT_COMMENT("SET_NZCV"); \
+	if (FLAGS_DEAD(FLAGS_NZCV)) { JIT_COMMENT("dead"); } else { \
 	GpVar x = c.newGpVar(kX86VarTypeGpd); \
 	GpVar y = c.newGpVar(kX86VarTypeGpd); \
 	c.sets(x.r8Lo()); \
@@ -346,11 +584,13 @@ static GpVar bb_profiler_entry;
 	c.mov(flags_ptr, x.r8Lo()); \
 	c.unuse(x); \
 	c.unuse(y); \
+	} \
 	JIT_COMMENT("end SET_NZCV"); \
 }
 
 #define SET_NZC { \
 	JIT_COMMENT("SET_NZC"); \
+	if (FLAGS_DEAD(cf_change?FLAGS_NZC:FLAGS_NZ)) { JIT_COMMENT("dead"); if (cf_change) c.unuse(rcf); } else { \
 	GpVar x = c.newGpVar(kX86VarTypeGpd); \
 	GpVar y = c.newGpVar(kX86VarTypeGpd); \
 	c.sets(x.r8Lo()); \
@@ -362,11 +602,13 @@ static GpVar bb_profiler_entry;
 	c.and_(y, cf_change?0x1F:0x3F); \
 	c.or_(x, y); \
 	c.mov(flags_ptr, x.r8Lo()); \
+	} \
 	JIT_COMMENT("end SET_NZC"); \
 }
 
 #define SET_NZC_SHIFTS_ZERO(cf) { \
 	JIT_COMMENT("SET_NZC_SHIFTS_ZERO"); \
+	if (FLAGS_DEAD(FLAGS_NZC)) { JIT_COMMENT("dead"); } else { \
 	c.and_(flags_ptr, 0x1F); \
 	if(cf) \
 	{ \
@@ -376,11 +618,13 @@ static GpVar bb_profiler_entry;
 	} \
 	else \
 		c.or_(flags_ptr, (1<<6)); \
+	} \
 	JIT_COMMENT("end SET_NZC_SHIFTS_ZERO"); \
 }
 
 #define SET_NZ(clear_cv) { \
 	JIT_COMMENT("SET_NZ"); \
+	if (FLAGS_DEAD(clear_cv?FLAGS_NZCV:FLAGS_NZ)) { JIT_COMMENT("dead"); } else { \
 	GpVar x = c.newGpVar(kX86VarTypeGpz); \
 	GpVar y = c.newGpVar(kX86VarTypeGpz); \
 	c.sets(x.r8Lo()); \
@@ -391,11 +635,13 @@ static GpVar bb_profiler_entry;
 	c.shl(x, 6); \
 	c.or_(x, y); \
 	c.mov(flags_ptr, x.r8Lo()); \
+	} \
 	JIT_COMMENT("end SET_NZ"); \
 }
 
 #define SET_N { \
 	JIT_COMMENT("SET_N"); \
+	if (FLAGS_DEAD(FLAG_N)) { JIT_COMMENT("dead"); } else { \
 	GpVar x = c.newGpVar(kX86VarTypeGpz); \
 	GpVar y = c.newGpVar(kX86VarTypeGpz); \
 	c.sets(x.r8Lo()); \
@@ -404,11 +650,13 @@ static GpVar bb_profiler_entry;
 	c.shl(x, 7); \
 	c.or_(x, y); \
 	c.mov(flags_ptr, x.r8Lo()); \
+	} \
 	JIT_COMMENT("end SET_N"); \
 }
 
 #define SET_Z { \
 	JIT_COMMENT("SET_Z"); \
+	if (FLAGS_DEAD(FLAG_Z)) { JIT_COMMENT("dead"); } else { \
 	GpVar x = c.newGpVar(kX86VarTypeGpz); \
 	GpVar y = c.newGpVar(kX86VarTypeGpz); \
 	c.setz(x.r8Lo()); \
@@ -417,6 +665,7 @@ static GpVar bb_profiler_entry;
 	c.shl(x, 6); \
 	c.or_(x, y); \
 	c.mov(flags_ptr, x.r8Lo()); \
+	} \
 	JIT_COMMENT("end SET_Z"); \
 }
 
@@ -2203,6 +2452,12 @@ static u32 FASTCALL OP_LDM_STM(u32 adr, u64 regs, int n)
 	{
 		ptr = MMU.MAIN_MEM + (adr & _MMU_MAIN_MEM_MASK32);
 		cycles = n * ((PROCNUM==ARMCPU_ARM9) ? 4 : 2);
+		if(store)
+		{
+			// the whole transfer is at most 64 bytes, so its two ends cover every block it touches
+			MMU_mainMemMarkDirty(adr);
+			MMU_mainMemMarkDirty(adr + (n-1)*4*dir);
+		}
 	}
 	else if(PROCNUM==ARMCPU_ARM7 && !store && (adr & 0xFF800000) == 0x03800000)
 	{
@@ -2214,6 +2469,11 @@ static u32 FASTCALL OP_LDM_STM(u32 adr, u64 regs, int n)
 		ptr = MMU.SWIRAM + (adr & 0x7FFC);
 		cycles = n;
 	}
+	else if(!store && (ptr = MMU_fastmemPage(PROCNUM, adr)) != NULL)
+	{
+		ptr += adr & 0x3FFC;
+		cycles = n * MMU_memAccessCycles<PROCNUM,32,MMU_AD_READ>(adr);
+	}
 	else
 		return OP_LDM_STM_other<PROCNUM, store, dir>(adr, regs, n);
 
@@ -3838,6 +4098,9 @@ static u32 FASTCALL OP_DECODE()
 		cpu->R[15] = adr + 4;
 		u32 opcode = _MMU_read16<PROCNUM, MMU_AT_CODE>(adr);
 		_armlog(PROCNUM, adr, opcode);
+#ifdef HAVE_LUA
+		CallRegisteredLuaMemHook(adr, 2, opcode, LUAMEMHOOK_EXEC);
+#endif
 		cycles = thumb_instructions_set[PROCNUM][opcode>>6](opcode);
 	}
 	else
@@ -3847,7 +4110,12 @@ static u32 FASTCALL OP_DECODE()
 		u32 opcode = _MMU_read32<PROCNUM, MMU_AT_CODE>(adr);
 		_armlog(PROCNUM, adr, opcode);
 		if(CONDITION(opcode) == 0xE || TEST_COND(CONDITION(opcode), CODE(opcode), cpu->CPSR))
+		{
+#ifdef HAVE_LUA
+			CallRegisteredLuaMemHook(adr, 4, opcode, LUAMEMHOOK_EXEC);
+#endif
 			cycles = arm_instructions_set[PROCNUM][INSTRUCTION_INDEX(opcode)](opcode);
+		}
 		else
 			cycles = 1;
 	}
@@ -3939,6 +4207,176 @@ static bool instr_does_prefetch(u32 opcode)
 			   && ((x & BRANCH_ALWAYS) || (x & BRANCH_LDM));
 }
 
+// Which of NZCV an instruction reads and which it unconditionally overwrites.
+// Anything not decoded here is assumed to read all of them and write none,
+// so the result is always safe to use for flag liveness.
+static u32 instr_flags_arm(u32 i, u32 *written)
+{
+	*written = 0;
+	if(CONDITION(i) != 0xE)
+		return FLAGS_NZCV;
+
+	switch(CODE(i))
+	{
+		case 0:
+			if((i & 0x90) == 0x90)
+			{
+				// multiply
+				if((i & 0x0F0000F0) == 0x00000090)
+				{
+					if(BIT20(i)) *written = FLAGS_NZ;
+					return 0;
+				}
+				// swap, halfword and doubleword transfers
+				return 0;
+			}
+			// MRS, MSR, BX, CLZ, QADD...
+			if((i & 0x01900000) == 0x01000000)
+				return FLAGS_NZCV;
+			break;
+
+		case 1:
+			// MSR (immediate), undefined
+			if((i & 0x01900000) == 0x01000000)
+				return FLAGS_NZCV;
+			break;
+
+		case 3:
+			// undefined
+			if(BIT4(i))
+				return FLAGS_NZCV;
+			// register offset shifted with RRX
+			if(((i>>5) & 3) == 3 && ((i>>7) & 0x1F) == 0)
+				return FLAG_C;
+			return 0;
+
+		case 2:
+			return 0;
+
+		case 4:
+			// LDM/STM with S bit touch the CPSR/user bank
+			return BIT22(i) ? FLAGS_NZCV : 0;
+
+		case 5:
+			return 0;
+
+		default:
+			return FLAGS_NZCV;
+	}
+
+	// data processing
+	const u32 op = (i>>21) & 0xF;
+	const bool logical = (op <= 1) || (op == 8) || (op == 9) || (op >= 12);
+	u32 read = 0;
+	bool carry_out = false;
+
+	if(op >= 5 && op <= 7) // ADC, SBC, RSC
+		read |= FLAG_C;
+
+	if(BIT25(i))
+		carry_out = ((i>>8) & 0xF) != 0;
+	else if(BIT4(i))
+	{
+		// shift by register: a zero amount passes the old carry through
+		if(BIT20(i)) read |= FLAG_C;
+		carry_out = true;
+	}
+	else
+	{
+		const u32 shift = (i>>5) & 3;
+		const u32 imm = (i>>7) & 0x1F;
+		if(shift == 3 && imm == 0) // RRX
+			read |= FLAG_C;
+		carry_out = (shift != 0) || (imm != 0);
+	}
+
+	if(!BIT20(i))
+		return read;
+
+	if(REG_POS(i,12) == 15)
+		return FLAGS_NZCV;
+
+	if(logical)
+		*written = carry_out ? FLAGS_NZC : FLAGS_NZ;
+	else
+		*written = FLAGS_NZCV;
+
+	return read;
+}
+
+static u32 instr_flags_thumb(u32 i, u32 *written)
+{
+	*written = 0;
+	switch(i>>11)
+	{
+		case 0x00: // LSL, LSR, ASR (immediate)
+		case 0x01:
+		case 0x02:
+			*written = (((i>>6) & 0x1F) || (i>>11)) ? FLAGS_NZC : FLAGS_NZ;
+			return 0;
+
+		case 0x03: // ADD, SUB (register, imm3)
+		case 0x05: // CMP imm8
+		case 0x06: // ADD imm8
+		case 0x07: // SUB imm8
+			*written = FLAGS_NZCV;
+			return 0;
+
+		case 0x04: // MOV imm8
+			*written = FLAGS_NZ;
+			return 0;
+
+		case 0x08:
+			if(BIT10(i))
+			{
+				// high register operations
+				if(((i>>8) & 3) == 1) *written = FLAGS_NZCV; // CMP
+				return 0;
+			}
+			switch((i>>6) & 0xF)
+			{
+				case 0x2: case 0x3: case 0x4: case 0x7: // LSL, LSR, ASR, ROR (register)
+					*written = FLAGS_NZC;
+					return FLAG_C;
+				case 0x5: case 0x6: // ADC, SBC
+					*written = FLAGS_NZCV;
+					return FLAG_C;
+				case 0x9: case 0xA: case 0xB: // NEG, CMP, CMN
+					*written = FLAGS_NZCV;
+					return 0;
+				default: // AND, EOR, TST, ORR, MUL, BIC, MVN
+					*written = FLAGS_NZ;
+					return 0;
+			}
+
+		case 0x16: case 0x17:
+			switch(i>>8)
+			{
+				case 0xB0: // ADD/SUB SP
+				case 0xB4: case 0xB5: // PUSH
+				case 0xBC: case 0xBD: // POP
+					return 0;
+			}
+			return FLAGS_NZCV;
+
+		case 0x1A: case 0x1B: // conditional branch, SWI
+			return FLAGS_NZCV;
+
+		default: // loads, stores, ADD PC/SP, B, BL, BLX
+			return 0;
+	}
+}
+
+static u32 instr_flags(u32 opcode, u32 *written)
+{
+	if(instr_attributes(opcode) & JIT_BYPASS)
+	{
+		*written = 0;
+		return FLAGS_NZCV;
+	}
+	return bb_thumb ? instr_flags_thumb(opcode, written) : instr_flags_arm(opcode, written);
+}
+
 static const char *disassemble(u32 opcode)
 {
 	if(bb_thumb)
@@ -4033,6 +4471,43 @@ static void emit_armop_call(u32 opcode)
 	ctx->setReturn(bb_cycles);
 }
 
+#ifdef HAVE_LUA
+// blocks end before any instruction with an exec hook, so that a hooked instruction
+// is always the first one of its block, and the block calls the hook before running it
+static bool instr_is_exec_hooked(u32 adr)
+{
+	return hookedRegions[LUAMEMHOOK_EXEC].NotEmpty() && hookedRegions[LUAMEMHOOK_EXEC].Contains(adr, bb_opcodesize);
+}
+
+static void emit_lua_exec_hook(u32 opcode)
+{
+	JIT_COMMENT("lua exec hook");
+	// the script sees the cpu as the interpreter would have it right after the prefetch
+	c.mov(cpu_ptr(instruct_adr), bb_adr);
+	c.mov(cpu_ptr(next_instruction), bb_next_instruction);
+	c.mov(reg_ptr(15), bb_r15);
+
+	GpVar adr = c.newGpVar(kX86VarTypeGpd);
+	GpVar size = c.newGpVar(kX86VarTypeGpd);
+	GpVar value = c.newGpVar(kX86VarTypeGpd);
+	GpVar type = c.newGpVar(kX86VarTypeGpd);
+	c.mov(adr, bb_adr);
+	c.mov(size, bb_opcodesize);
+	c.mov(value, opcode);
+	c.mov(type, LUAMEMHOOK_EXEC);
+	X86CompilerFuncCall* ctx = c.call((void*)CallRegisteredLuaMemHook_LuaMatch);
+	ctx->setPrototype(kX86FuncConvDefault, FuncBuilder4<Void, u32, s32, u32, u32>());
+	ctx->setArgument(0, adr);
+	ctx->setArgument(1, size);
+	ctx->setArgument(2, value);
+	ctx->setArgument(3, type);
+	c.unuse(adr);
+	c.unuse(size);
+	c.unuse(value);
+	c.unuse(type);
+}
+#endif
+
 static void _armlog(u8 proc, u32 addr, u32 opcode)
 {
 #if 0
@@ -4055,15 +4530,129 @@ static void _armlog(u8 proc, u32 addr, u32 opcode)
 #endif
 }
 
+// flag liveness of a hot block, filled in by analyze_flags() before it is recompiled
+#define JIT_ANALYZE_MAX 100
+static u32 bb_analyzed_count;
+static u32 bb_analyzed_opcode[JIT_ANALYZE_MAX];
+static u32 bb_analyzed_flags_live[JIT_ANALYZE_MAX];
+
 template<int PROCNUM>
-static u32 compile_basicblock()
+static void analyze_flags(u32 start_adr)
+{
+	u32 n = 0;
+	for(bool bEndBlock = false; !bEndBlock && (n < JIT_ANALYZE_MAX); n++)
+	{
+		u32 adr = start_adr + (n * bb_opcodesize);
+		u32 opcode = bb_thumb ? _MMU_read16<PROCNUM, MMU_AT_CODE>(adr) : _MMU_read32<PROCNUM, MMU_AT_CODE>(adr);
+		bb_analyzed_opcode[n] = opcode;
+		bEndBlock = instr_is_branch(opcode) || (n >= (CommonSettings.jit_max_block_size - 1));
+	}
+	bb_analyzed_count = n;
+
+	// walk backwards from the end of the block, where all flags are live
+	u32 live = FLAGS_NZCV;
+	while(n--)
+	{
+		u32 written = 0;
+		u32 read = instr_flags(bb_analyzed_opcode[n], &written);
+		bb_analyzed_flags_live[n] = live;
+		live = read | (live & ~written);
+	}
+}
+
+static void add_chain_target(u32 *targets, u32 &n, u32 adr)
+{
+	// a branch to the next instruction continues there either way
+	for(u32 t = 0; t < n; t++)
+		if(targets[t] == adr) return;
+	targets[n++] = adr;
+}
+
+// addresses the block at bb_adr may continue at, if they can be told from the code
+static u32 chain_targets(u32 opcode, u32 prev_opcode, u32 *targets)
+{
+	u32 n = 0;
+	if(!instr_is_branch(opcode) || instr_is_conditional(opcode))
+		add_chain_target(targets, n, bb_next_instruction);
+	if(bb_thumb)
+	{
+		if((opcode & 0xF000) == 0xD000 && ((opcode >> 8) & 0xF) < 0xE)
+		{
+			// B<cond>
+			add_chain_target(targets, n, bb_next_instruction);
+			add_chain_target(targets, n, bb_r15 + ((s32)(s8)(opcode & 0xFF) << 1));
+		}
+		else if((opcode & 0xF800) == 0xE000)
+			add_chain_target(targets, n, bb_r15 + ((s32)(opcode << 21) >> 20));  // B
+		else if((opcode & 0xF800) == 0xF800 && (prev_opcode & 0xF800) == 0xF000)
+			add_chain_target(targets, n, bb_adr + 2 + ((s32)(prev_opcode << 21) >> 9) + ((opcode & 0x7FF) << 1));  // BL
+	}
+	else if((opcode & 0x0E000000) == 0x0A000000 && CONDITION(opcode) != 0xF)
+		add_chain_target(targets, n, bb_r15 + ((s32)(opcode << 8) >> 6));  // B, BL
+	return n;
+}
+
+template<int PROCNUM>
+static void emit_chain(u32 opcode, u32 prev_opcode)
+{
+	u32 targets[3];
+	u32 n = chain_targets(opcode, prev_opcode, targets);
+	if(n == 0) return;
+
+	JIT_COMMENT("chain");
+	Label done = c.newLabel();
+	GpVar x = c.newGpVar(kX86VarTypeGpz);
+	c.mov(x, (uintptr_t)&arm_jit_chain_budget);
+	c.sub(dword_ptr(x), bb_total_cycles.r32());
+	c.jle(done);
+	c.cmp(cpu_ptr(waitIRQ), 0);
+	c.jne(done);
+	c.mov(x, (uintptr_t)&nds.freezeBus);
+	c.cmp(dword_ptr(x), 0);
+	c.jne(done);
+	GpVar depth = c.newGpVar(kX86VarTypeGpz);
+	c.mov(depth, (uintptr_t)&chain_depth);
+	c.cmp(dword_ptr(depth), JIT_CHAIN_MAX_DEPTH);
+	c.jae(done);
+	for(u32 t = 0; t < n; t++)
+	{
+		if(!JIT_MAPPED(targets[t] & 0x0FFFFFFF, PROCNUM)) continue;
+		// return to armInnerLoop after each pass of a polling loop, so that it can skip the rest
+		if(CommonSettings.idle_loop_skip && targets[t] <= (u32)bb_adr && NDS_IsIdleLoop(PROCNUM, targets[t], bb_thumb)) continue;
+		Label next = c.newLabel();
+		c.cmp(cpu_ptr(instruct_adr), targets[t]);
+		c.jne(next);
+		c.mov(x, (uintptr_t)&JIT_COMPILED_FUNC(targets[t], PROCNUM));
+		c.mov(x, sysint_ptr(x));
+		c.test(x, x);
+		c.jz(done);
+		c.inc(dword_ptr(depth));
+		GpVar cycles = c.newGpVar(kX86VarTypeGpd);
+		X86CompilerFuncCall* ctx = c.call(x);
+		ctx->setPrototype(ASMJIT_CALL_CONV, FuncBuilder0<u32>());
+		ctx->setReturn(cycles);
+		c.mov(depth, (uintptr_t)&chain_depth);
+		c.dec(dword_ptr(depth));
+		c.add(bb_total_cycles, cycles.r64());
+		c.unuse(cycles);
+		c.jmp(done);
+		c.bind(next);
+	}
+	c.bind(done);
+	c.unuse(depth);
+	c.unuse(x);
+}
+
+template<int PROCNUM>
+static u32 compile_basicblock(bool hot)
 {
 #if LOG_JIT
 	bool has_variable_cycles = FALSE;
 #endif
 	u32 interpreted_cycles = 0;
 	u32 start_adr = cpu->instruct_adr;
-	u32 opcode = 0;
+	u32 opcode = 0, prev_opcode = 0;
+	bool analysis_valid = true;
 	
 	bb_thumb = cpu->CPSR.bits.T;
 	bb_opcodesize = bb_thumb ? 2 : 4;
@@ -4075,6 +4664,12 @@ static u32 compile_basicblock()
 		return 1;
 	}
 
+#if (JIT_HOT_THRESHOLD > 0)
+	JIT_HOT_COUNTER(start_adr, PROCNUM) = JIT_HOT_THRESHOLD;
+#endif
+	if(hot)
+		analyze_flags<PROCNUM>(start_adr);
+
 #if LOG_JIT
 	fprintf(stderr, "adr %08Xh %s%c\n", start_adr, ARMPROC.CPSR.bits.T ? "THUMB":"ARM", PROCNUM?'7':'9');
 #endif
@@ -4092,6 +4687,27 @@ static u32 compile_basicblock()
 	bb_total_cycles = c.newGpVar(kX86VarTypeGpz);
 	c.mov(bb_total_cycles, 0);
 
+#if (JIT_HOT_THRESHOLD > 0)
+	if(!hot)
+	{
+		JIT_COMMENT("hot block counter");
+		GpVar counter = c.newGpVar(kX86VarTypeGpz);
+		Label cold = c.newLabel();
+		c.mov(counter, (uintptr_t)&JIT_HOT_COUNTER(start_adr, PROCNUM));
+		c.sub(word_ptr(counter), 1);
+		c.jnz(cold);
+		// the rest of this run completes normally; the next dispatch recompiles the block.
+		// recompiling from the dispatcher rather than from a stub in the table keeps
+		// compilation (and cache flushes) out of chained calls.
+		c.mov(counter, (uintptr_t)&JIT_HOT_PENDING(start_adr, PROCNUM));
+		c.mov(byte_ptr(counter), 1);
+		c.mov(counter, (uintptr_t)&JIT_COMPILED_FUNC(start_adr, PROCNUM));
+		c.mov(sysint_ptr(counter), 0);
+		c.bind(cold);
+		c.unuse(counter);
+	}
+#endif
+
 #if (PROFILER_JIT_LEVEL > 0)
 	JIT_COMMENT("Profiler ptr");
 	bb_profiler = c.newGpVar(kX86VarTypeGpz);
@@ -4102,6 +4718,7 @@ static u32 compile_basicblock()
 	for(u32 i=0, bEndBlock = 0; bEndBlock == 0; i++)
 	{
 		bb_adr = start_adr + (i * bb_opcodesize);
+		prev_opcode = opcode;
 		if(bb_thumb)
 			opcode = _MMU_read16<PROCNUM, MMU_AT_CODE>(bb_adr);
 		else
@@ -4119,6 +4736,10 @@ static u32 compile_basicblock()
 		u32 cycles = instr_cycles(opcode);
 
 		bEndBlock = instr_is_branch(opcode) || (i >= (CommonSettings.jit_max_block_size - 1));
+#ifdef HAVE_LUA
+		bEndBlock = bEndBlock || instr_is_exec_hooked(bb_next_instruction);
+		const bool execHooked = (i == 0) && instr_is_exec_hooked(bb_adr);
+#endif
 		
 #if LOG_JIT
 		if (instr_is_conditional(opcode) && (cycles > 1) || (cycles == 0))
@@ -4128,6 +4749,16 @@ static u32 compile_basicblock()
 
 		bb_constant_cycles += instr_is_conditional(opcode) ? 1 : cycles;
 
+		bb_flags_live = FLAGS_NZCV;
+		if(hot && i < bb_analyzed_count)
+		{
+			// code modified while the block was being interpreted invalidates the analysis
+			if(bb_analyzed_opcode[i] == opcode)
+				bb_flags_live = bb_analyzed_flags_live[i];
+			else
+				analysis_valid = false;
+		}
+
 		JIT_COMMENT("%s (PC:%08X)", disassemble(opcode), bb_adr);
 
 #if (PROFILER_JIT_LEVEL > 0)
@@ -4143,9 +4774,16 @@ static u32 compile_basicblock()
 			// another with the same condition, but merging them into a
 			// single branch has negligible effect on speed.
 			if(bEndBlock) sync_r15(opcode, 1, 1);
+#ifdef HAVE_LUA
+			// thumb instructions report to the hook whether their condition passes or not, arm ones only if it does
+			if(execHooked && bb_thumb) emit_lua_exec_hook(opcode);
+#endif
 			Label skip = c.newLabel();
 			emit_branch(CONDITION(opcode), skip);
 			if(!bEndBlock) sync_r15(opcode, 0, 0);
+#ifdef HAVE_LUA
+			if(execHooked && !bb_thumb) emit_lua_exec_hook(opcode);
+#endif
 			emit_armop_call(opcode);
 			
 			if(cycles == 0)
@@ -4164,6 +4802,9 @@ static u32 compile_basicblock()
 		else
 		{
 			sync_r15(opcode, bEndBlock, 0);
+#ifdef HAVE_LUA
+			if(execHooked) emit_lua_exec_hook(opcode);
+#endif
 			emit_armop_call(opcode);
 			if(cycles == 0)
 			{
@@ -4173,6 +4814,7 @@ static u32 compile_basicblock()
 		}
 		interpreted_cycles += op_decode[PROCNUM][bb_thumb]();
 	}
+	bb_flags_live = FLAGS_NZCV;
 	
 	if(!instr_does_prefetch(opcode))
 	{
@@ -4199,6 +4841,8 @@ static u32 compile_basicblock()
 	profiler_entry[PROCNUM][padr].addr = start_adr;
 #endif
 
+	emit_chain<PROCNUM>(opcode, prev_opcode);
+
 	c.ret(bb_total_cycles);
 #if LOG_JIT
 	fprintf(stderr, "cycles %d%s\n", bb_constant_cycles, has_variable_cycles ? " + variable" : "");
@@ -4211,12 +4855,26 @@ static u32 compile_basicblock()
 		fprintf(stderr, "JIT error at %s%c-%08X: %s\n", bb_thumb?"THUMB":"ARM", PROCNUM?'7':'9', start_adr, getErrorString(c.getError()));
 		f = op_decode[PROCNUM][bb_thumb];
 	}
+#if (JIT_HOT_THRESHOLD > 0)
+	else if(hot && analysis_valid && !jit_profile_fname.empty())
+		profile_add(PROCNUM, start_adr, bb_analyzed_opcode, bb_analyzed_count, bb_thumb);
+#endif
 #if LOG_JIT
 	uintptr_t baddr = (uintptr_t)f;
 	fprintf(stderr, "Block address %08lX\n\n", baddr);
 	fflush(stderr);
 #endif
 	
+	if(!analysis_valid)
+	{
+		// fall back to a tier 1 compile the next time the block is reached
+		JIT_COMPILED_FUNC(start_adr, PROCNUM) = 0;
+		return interpreted_cycles;
+	}
+
+#ifdef HAVE_STATIC_CODE_BUFFER
+	cache_add_block(start_adr, PROCNUM, (uintptr_t)f);
+#endif
 	JIT_COMPILED_FUNC(start_adr, PROCNUM) = (uintptr_t)f;
 	return interpreted_cycles;
 }
@@ -4228,6 +4886,14 @@ template<int PROCNUM> u32 arm_jit_compile()
 	// prevent endless recompilation of self-modifying code, which would be a memleak since we only free code all at once.
 	// also allows us to clear compiled_funcs[] while leaving it sparsely allocated, if the OS does memory overcommit.
 	u32 adr = cpu->instruct_adr;
+#if (JIT_HOT_THRESHOLD > 0)
+	if(JIT_HOT_PENDING(adr, PROCNUM))
+	{
+		JIT_HOT_PENDING(adr, PROCNUM) = 0;
+		arm_jit_cache_stats.blocks_promoted++;
+		return compile_basicblock<PROCNUM>(true);
+	}
+#endif
 	u32 mask_adr = (adr & 0x07FFFFFE) >> 4;
 	if(((recompile_counts[mask_adr >> 1] >> 4*(mask_adr & 1)) & 0xF) > 8)
 	{
@@ -4235,9 +4901,19 @@ template<int PROCNUM> u32 arm_jit_compile()
 		JIT_COMPILED_FUNC(adr, PROCNUM) = (uintptr_t)f;
 		return f();
 	}
+	if((recompile_counts[mask_adr >> 1] >> 4*(mask_adr & 1)) & 0xF)
+		arm_jit_cache_stats.blocks_recompiled++;
 	recompile_counts[mask_adr >> 1] += 1 << 4*(mask_adr & 1);
+#if (JIT_HOT_THRESHOLD > 0)
+	if(profile_is_hot<PROCNUM>(adr, cpu->CPSR.bits.T))
+	{
+		arm_jit_cache_stats.blocks_profiled++;
+		return compile_basicblock<PROCNUM>(true);
+	}
+#endif
+	arm_jit_cache_stats.blocks_compiled++;
 
-	return compile_basicblock<PROCNUM>();
+	return compile_basicblock<PROCNUM>(false);
 }
 
 template u32 arm_jit_compile<0>();
@@ -4250,8 +4926,9 @@ void arm_jit_reset(bool enable, bool suppress_msg)
 	freopen("desmume_jit.log", "w", stderr);
 #endif
 #ifdef HAVE_STATIC_CODE_BUFFER
-	scratchptr = scratchpad;
+	cache_reset();
 #endif
+	arm_jit_cache_stats.flushes++;
 	if (!suppress_msg)
 		printf("CPU mode: %s\n", enable?"JIT":"Interpreter");
 	saveBlockSizeJIT = CommonSettings.jit_max_block_size;
@@ -4276,6 +4953,9 @@ void arm_jit_reset(bool enable, bool suppress_msg)
 		#undef JITFREE
 
 		memset(recompile_counts, 0, sizeof(recompile_counts));
+#if (JIT_HOT_THRESHOLD > 0)
+		memset(hot_pending, 0, sizeof(hot_pending));
+#endif
 		init_jit_mem();
 #else
 		for(int i=0; i<sizeof(recompile_counts)/8; i++)
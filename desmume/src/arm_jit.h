@@ -31,6 +31,27 @@ void arm_jit_close();
 void arm_jit_sync();
 template<int PROCNUM> u32 arm_jit_compile();
 
+// cycles the cpu may run through chained blocks before returning to the dispatcher
+extern s32 arm_jit_chain_budget;
+
+// code cache counters, cumulative since startup
+struct JITCacheStats
+{
+	u32 blocks_compiled;	// tier 1 compiles
+	u32 blocks_recompiled;	// tier 1 compiles of code that had been invalidated (tracked per 16 bytes)
+	u32 blocks_promoted;	// tier 2 recompiles of hot blocks
+	u32 blocks_profiled;	// tier 2 compiles of blocks that were hot in a previous run
+	u32 blocks_evicted;		// blocks dropped when their cache generation was reused
+	u32 evictions;			// cache generations reused
+	u32 flushes;			// full resets of the code cache
+};
+extern JITCacheStats arm_jit_cache_stats;
+
+// hot blocks are remembered in a per game profile, key identifies the game.
+// loading a profile saves the previous one; pass NULL to stop using one.
+void arm_jit_profile_load(const char *fname, u32 key);
+void arm_jit_profile_save();
+
 //#define MAPPED_JIT_FUNCS: to define or not to define?
 //* x86 windows seems faster with NON-DEFINED
 //* x64 windows seems faster with DEFINED
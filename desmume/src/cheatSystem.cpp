@@ -15,6 +15,8 @@
 	along with the this software.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <algorithm>
+
 #include "cheatSystem.h"
 #include "bits.h"
 
@@ -35,6 +37,7 @@ CHEATSEARCH *cheatSearch = NULL;
 void CHEATS::clear()
 {
 	list.resize(0);
+	arProgram.resize(0);
 	currentGet = 0;
 }
 
@@ -73,56 +76,37 @@ BOOL CHEATS::update(u8 size, u32 address, u32 val, char *description, BOOL enabl
 	return TRUE;
 }
 
-void CHEATS::ARparser(CHEATS_LIST& list)
+//the AR codes go through a small interpreter with offset, datareg, a loop and an if flag.
+//decoding them is done once, up front: ARcompile() turns the code lines into a list of ops
+//and ARrun() runs that list, where a false condition jumps straight to wherever the if ends.
+
+void CHEATS::ARcompile(const CHEATS_LIST& list, CHEATS_AR_PROGRAM& prog)
 {
-	u8	type = 0;
-	u8	subtype = 0;
-	u32	hi = 0;
-	u32	lo = 0;
-	u32	addr = 0;
-	u32	val = 0;
-	// AR temporary vars & flags
-	u32	offset = 0;
-	u32	datareg = 0;
-	u32	loopcount = 0;
-	u32	counter = 0;
-	u32	if_flag = 0;
-	s32 loopbackline = 0;
-	u32 loop_flag = 0;
-	
-	for (int i=0; i < list.num; i++)
-	{
-		type = list.code[i][0] >> 28;
-		subtype = (list.code[i][0] >> 24) & 0x0F;
+	const int num = std::min<int>(std::max<int>(list.num, 0), MAX_XX_CODE);
+	int sourceLines = num;
 
-		hi = list.code[i][0] & 0x0FFFFFFF;
-		lo = list.code[i][1];
+	prog.op.clear();
+	prog.data.clear();
 
-		if (if_flag > 0) 
-		{
-			if ((type == 0x0E)) i += ((lo + 7) / 8);
-			if ( (type == 0x0D) && (subtype == 0)) if_flag--;	// ENDIF
-			if ( (type == 0x0D) && (subtype == 2))				// NEXT & Flush
-			{
-				if (loop_flag)
-					i = (loopbackline-1);
-				else
-				{
-					offset = 0;
-					datareg = 0;
-					loopcount = 0;
-					counter = 0;
-					if_flag = 0;
-					loop_flag = 0;
-				}
-			}
-			continue;
-		}
+	for (int i=0; i < num; i++)
+	{
+		const u8	type = list.code[i][0] >> 28;
+		const u8	subtype = (list.code[i][0] >> 24) & 0x0F;
+		const u32	hi = list.code[i][0] & 0x0FFFFFFF;
+		const u32	lo = list.code[i][1];
+
+		CHEATS_AR_OP op;
+		op.opcode = CHEATS_AR_NOP;
+		op.useOffset = 0;
+		op.isMainMem = 0;
+		op.addr = hi;
+		op.val = lo;
+		op.arg = 0;
+		op.skipEnd = 0;
 
 		switch (type)
 		{
 			case 0x00:
-			{
 				if (hi==0)
 				{
 					//manual hook
@@ -133,277 +117,269 @@ void CHEATS::ARparser(CHEATS_LIST& list)
 					//parameter bytes 9..10 for above code (padded with 00s)
 				}
 				else	// 0XXXXXXX YYYYYYYY   word[XXXXXXX+offset] = YYYYYYYY
-				{
-					addr = hi + offset;
-					_MMU_write32<ARMCPU_ARM7,MMU_AT_DEBUG>(addr, lo);
-				}
-			}
+					op.opcode = CHEATS_AR_WRITE32;
 			break;
 
 			case 0x01:	// 1XXXXXXX 0000YYYY   half[XXXXXXX+offset] = YYYY
-				addr = hi + offset;
-				_MMU_write16<ARMCPU_ARM7,MMU_AT_DEBUG>(addr, lo);
+				op.opcode = CHEATS_AR_WRITE16;
 			break;
 
 			case 0x02:	// 2XXXXXXX 000000YY   byte[XXXXXXX+offset] = YY
-				addr = hi + offset;
-				_MMU_write08<ARMCPU_ARM7,MMU_AT_DEBUG>(addr, lo);
+				op.opcode = CHEATS_AR_WRITE08;
 			break;
 
 			case 0x03:	// 3XXXXXXX YYYYYYYY   IF YYYYYYYY > word[XXXXXXX]   ;unsigned
-				if (hi == 0) hi = offset;	// V1.54+
-				val = _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(hi);
-				if ( lo > val )
-				{
-					if (if_flag > 0) if_flag--;
-				}
-				else
-				{
-					if_flag++;
-				}
-			break;
-
 			case 0x04:	// 4XXXXXXX YYYYYYYY   IF YYYYYYYY < word[XXXXXXX]   ;unsigned
-				if ((hi == 0x04332211) && (lo == 88776655))	//44332211 88776655   parameter bytes 1..8 for above code  (example)
-				{
+			case 0x05:	// 5XXXXXXX YYYYYYYY   IF YYYYYYYY = word[XXXXXXX]
+			case 0x06:	// 6XXXXXXX YYYYYYYY   IF YYYYYYYY <> word[XXXXXXX]
+			case 0x07:	// 7XXXXXXX ZZZZYYYY   IF YYYY > ((not ZZZZ) AND half[XXXXXXX])
+			case 0x08:	// 8XXXXXXX ZZZZYYYY   IF YYYY < ((not ZZZZ) AND half[XXXXXXX])
+			case 0x09:	// 9XXXXXXX ZZZZYYYY   IF YYYY = ((not ZZZZ) AND half[XXXXXXX])
+			case 0x0A:	// AXXXXXXX ZZZZYYYY   IF YYYY <> ((not ZZZZ) AND half[XXXXXXX])
+				if ((type == 0x04) && (hi == 0x04332211) && (lo == 88776655))	//44332211 88776655   parameter bytes 1..8 for above code  (example)
 					break;
-				}
-				if (hi == 0) hi = offset;	// V1.54+
-				val = _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(hi);
-				if ( lo < val )
-				{
-					if (if_flag > 0) if_flag--;
-				}
-				else
-				{
-					if_flag++;
-				}
-			break;
 
-			case 0x05:	// 5XXXXXXX YYYYYYYY   IF YYYYYYYY = word[XXXXXXX]
-				if (hi == 0) hi = offset;	// V1.54+
-				val = _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(hi);
-				if ( lo == val )
+				op.opcode = CHEATS_AR_IF_GREATER32 + (type - 0x03);
+				op.useOffset = (hi == 0);	// V1.54+
+				op.isMainMem = (hi != 0) && ((hi & 0x0F000000) == 0x02000000);
+				if (type >= 0x07)
 				{
-					if (if_flag > 0) if_flag--;
-				}
-				else
-				{
-					if_flag++;
+					op.val = lo & 0xFFFF;
+					op.arg = (~(lo >> 16)) & 0xFFFF;
 				}
 			break;
 
-			case 0x06:	// 6XXXXXXX YYYYYYYY   IF YYYYYYYY <> word[XXXXXXX]
-				if (hi == 0) hi = offset;	// V1.54+
-				val = _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(hi);
-				if ( lo != val )
-				{
-					if (if_flag > 0) if_flag--;
-				}
-				else
-				{
-					if_flag++;
-				}
+			case 0x0B:	// BXXXXXXX 00000000   offset = word[XXXXXXX+offset]
+				op.opcode = CHEATS_AR_LOAD_OFFSET;
 			break;
 
-			case 0x07:	// 7XXXXXXX ZZZZYYYY   IF YYYY > ((not ZZZZ) AND half[XXXXXXX])
-				if (hi == 0) hi = offset;	// V1.54+
-				val = _MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(hi);
-				if ( (lo & 0xFFFF) > ( (~(lo >> 16)) & val) )
-				{
-					if (if_flag > 0) if_flag--;
-				}
-				else
+			case 0x0C:
+				switch (subtype)
 				{
-					if_flag++;
+					case 0x0: op.opcode = CHEATS_AR_FOR; break;				// C0000000 YYYYYYYY   FOR loopcount=0 to YYYYYYYY  ;execute Y+1 times
+					case 0x4: op.opcode = CHEATS_AR_OFFSET_HERE; break;		// C4000000 00000000   offset = address of the C4000000 code ; V1.54
+					case 0x5: op.opcode = CHEATS_AR_IF_COUNTER; break;		// C5000000 XXXXYYYY   counter=counter+1, IF (counter AND YYYY) = XXXX ; V1.54
+					case 0x6: op.opcode = CHEATS_AR_STORE_OFFSET; break;	// C6000000 XXXXXXXX   [XXXXXXXX]=offset ; V1.54
 				}
 			break;
 
-			case 0x08:	// 8XXXXXXX ZZZZYYYY   IF YYYY < ((not ZZZZ) AND half[XXXXXXX])
-				if (hi == 0) hi = offset;	// V1.54+
-				val = _MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(hi);
-				if ( (lo & 0xFFFF) < ( (~(lo >> 16)) & val) )
-				{
-					if (if_flag > 0) if_flag--;
-				}
-				else
+			case 0x0D:
+				switch (subtype)
 				{
-					if_flag++;
+					case 0x0: op.opcode = CHEATS_AR_ENDIF; break;			// D0000000 00000000   ENDIF
+					case 0x1: op.opcode = CHEATS_AR_NEXT; break;			// D1000000 00000000   NEXT loopcount
+					case 0x2: op.opcode = CHEATS_AR_NEXT_FLUSH; break;		// D2000000 00000000   NEXT loopcount, and then FLUSH everything
+					case 0x3: op.opcode = CHEATS_AR_SET_OFFSET; break;		// D3000000 XXXXXXXX   offset = XXXXXXXX
+					case 0x4: op.opcode = CHEATS_AR_ADD_DATA; break;		// D4000000 XXXXXXXX   datareg = datareg + XXXXXXXX
+					case 0x5: op.opcode = CHEATS_AR_SET_DATA; break;		// D5000000 XXXXXXXX   datareg = XXXXXXXX
+					case 0x6: op.opcode = CHEATS_AR_STORE_DATA32; break;	// D6000000 XXXXXXXX   word[XXXXXXXX+offset]=datareg, offset=offset+4
+					case 0x7: op.opcode = CHEATS_AR_STORE_DATA16; break;	// D7000000 XXXXXXXX   half[XXXXXXXX+offset]=datareg, offset=offset+2
+					case 0x8: op.opcode = CHEATS_AR_STORE_DATA08; break;	// D8000000 XXXXXXXX   byte[XXXXXXXX+offset]=datareg, offset=offset+1
+					case 0x9: op.opcode = CHEATS_AR_LOAD_DATA32; break;		// D9000000 XXXXXXXX   datareg = word[XXXXXXXX+offset]
+					case 0xA: op.opcode = CHEATS_AR_LOAD_DATA16; break;		// DA000000 XXXXXXXX   datareg = half[XXXXXXXX+offset]
+					case 0xB: op.opcode = CHEATS_AR_LOAD_DATA08; break;		// DB000000 XXXXXXXX   datareg = byte[XXXXXXXX+offset] ;bugged on pre-v1.54
+					case 0xC: op.opcode = CHEATS_AR_ADD_OFFSET; break;		// DC000000 XXXXXXXX   offset = offset + XXXXXXXX
 				}
 			break;
 
-			case 0x09:	// 9XXXXXXX ZZZZYYYY   IF YYYY = ((not ZZZZ) AND half[XXXXXXX])
-				if (hi == 0) hi = offset;	// V1.54+
-				val = _MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(hi);
-				if ( (lo & 0xFFFF) == ( (~(lo >> 16)) & val) )
-				{
-					if (if_flag > 0) if_flag--;
-				}
-				else
-				{
-					if_flag++;
-				}
-			break;
+			case 0xE:		// EXXXXXXX YYYYYYYY   Copy YYYYYYYY parameter bytes to [XXXXXXXX+offset...]
+			{
+				u8	*tmp_code = (u8*)(list.code[i+1]);
+				u32 maxByteReadLocation = ((2 * 4) * (MAX_XX_CODE - i - 1)) - 1; // 2 = 2 array dimensions, 4 = 4 bytes per array element
 
-			case 0x0A:	// AXXXXXXX ZZZZYYYY   IF YYYY <> ((not ZZZZ) AND half[XXXXXXX])
-				if (hi == 0) hi = offset;	// V1.54+
-				val = _MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(hi);
-				if ( (lo & 0xFFFF) != ( (~(lo >> 16)) & val) )
-				{
-					if (if_flag > 0) if_flag--;
-				}
-				else
+				op.opcode = CHEATS_AR_PATCH;
+				op.arg = prog.data.size();
+				op.val = 0;
+				if ((i + 1 < MAX_XX_CODE) && (lo <= maxByteReadLocation))
 				{
-					if_flag++;
+					op.val = lo;
+					prog.data.insert(prog.data.end(), tmp_code, tmp_code + lo);
+					sourceLines = std::max<int>(sourceLines, i + 1 + ((lo + 7) / 8));
 				}
+
+				i += ((lo + 7) / 8);
+			}
 			break;
 
-			case 0x0B:	// BXXXXXXX 00000000   offset = word[XXXXXXX+offset]
-				addr = hi + offset;
-				offset = _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(addr);;
+			case 0xF:		// FXXXXXXX YYYYYYYY   Copy YYYYYYYY bytes from [offset..] to [XXXXXXX...]
+				op.opcode = CHEATS_AR_COPY;
 			break;
+		}
 
-			case 0x0C:
-				switch (subtype)
-				{
-					case 0x0:	// C0000000 YYYYYYYY   FOR loopcount=0 to YYYYYYYY  ;execute Y+1 times
-						if (loopcount < (lo+1))
-							loop_flag = 1;
-						else
-							loop_flag = 0;
-						loopcount++;
-						loopbackline = i;
-					break;
+		if (op.opcode != CHEATS_AR_NOP)
+			prog.op.push_back(op);
+	}
 
-					case 0x4:	// C4000000 00000000   offset = address of the C4000000 code ; V1.54
-						printf("AR: untested code C4\n");
-					break;
+	//while the if flag is up, everything up to the next ENDIF or NEXT & Flush is passed over
+	//(there is no nesting, an IF inside doesn't count)
+	u32 skipEnd = prog.op.size();
+	for (size_t i = prog.op.size(); i-- > 0; )
+	{
+		if ((prog.op[i].opcode == CHEATS_AR_ENDIF) || (prog.op[i].opcode == CHEATS_AR_NEXT_FLUSH))
+			skipEnd = i;
+		prog.op[i].skipEnd = skipEnd;
+	}
 
-					case 0x5:	// C5000000 XXXXYYYY   counter=counter+1, IF (counter AND YYYY) = XXXX ; V1.54
-						counter++;
-						if ( (counter & (lo & 0xFFFF)) == ((lo >> 8) & 0xFFFF) )
-						{
-							if (if_flag > 0) if_flag--;
-						}
-						else
-						{
-							if_flag++;
-						}
-					break;
+	prog.num = list.num;
+	prog.source.assign(&list.code[0][0], &list.code[0][0] + (sourceLines * 2));
+}
 
-					case 0x6:	// C6000000 XXXXXXXX   [XXXXXXXX]=offset ; V1.54
-						_MMU_write32<ARMCPU_ARM7,MMU_AT_DEBUG>(lo, offset);
-					break;
-				}
-			break;
+static FORCEINLINE u32 ARread32(const CHEATS_AR_OP &op, const u32 offset)
+{
+	if (op.isMainMem)
+		return T1ReadLong_guaranteedAligned(MMU.MAIN_MEM, op.addr & _MMU_MAIN_MEM_MASK32);
+	return _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(op.useOffset ? offset : op.addr);
+}
 
-			case 0x0D:
-			{
-				switch (subtype)
-				{
-					case 0x0:	// D0000000 00000000   ENDIF
-					break;
+static FORCEINLINE u32 ARread16(const CHEATS_AR_OP &op, const u32 offset)
+{
+	if (op.isMainMem)
+		return T1ReadWord_guaranteedAligned(MMU.MAIN_MEM, op.addr & _MMU_MAIN_MEM_MASK16);
+	return _MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(op.useOffset ? offset : op.addr);
+}
 
-					case 0x1:	// D1000000 00000000   NEXT loopcount
-						if (loop_flag)
-							i = (loopbackline-1);
-					break;
+void CHEATS::ARrun(const CHEATS_AR_PROGRAM& prog)
+{
+	// AR temporary vars & flags
+	u32	offset = 0;
+	u32	datareg = 0;
+	u32	loopcount = 0;
+	u32	counter = 0;
+	u32 loopbackline = 0;
+	u32 loop_flag = 0;
 
-					case 0x2:	// D2000000 00000000   NEXT loopcount, and then FLUSH everything
-						if (loop_flag)
-							i = (loopbackline-1);
-						else
-						{
-							offset = 0;
-							datareg = 0;
-							loopcount = 0;
-							counter = 0;
-							if_flag = 0;
-							loop_flag = 0;
-						}
-					break;
+	const CHEATS_AR_OP *ops = prog.op.empty() ? NULL : &prog.op[0];
+	const u32 count = prog.op.size();
+	u32 i = 0;
 
-					case 0x3:	// D3000000 XXXXXXXX   offset = XXXXXXXX
-						offset = lo;
-					break;
+	while (i < count)
+	{
+		const CHEATS_AR_OP &op = ops[i];
+		bool skip = false;
 
-					case 0x4:	// D4000000 XXXXXXXX   datareg = datareg + XXXXXXXX
-						datareg += lo;
-					break;
+		switch (op.opcode)
+		{
+			case CHEATS_AR_WRITE32: _MMU_write32<ARMCPU_ARM7,MMU_AT_DEBUG>(op.addr + offset, op.val); break;
+			case CHEATS_AR_WRITE16: _MMU_write16<ARMCPU_ARM7,MMU_AT_DEBUG>(op.addr + offset, op.val); break;
+			case CHEATS_AR_WRITE08: _MMU_write08<ARMCPU_ARM7,MMU_AT_DEBUG>(op.addr + offset, op.val); break;
+
+			case CHEATS_AR_IF_GREATER32: skip = !(op.val > ARread32(op, offset)); break;
+			case CHEATS_AR_IF_LESSER32: skip = !(op.val < ARread32(op, offset)); break;
+			case CHEATS_AR_IF_EQUAL32: skip = !(op.val == ARread32(op, offset)); break;
+			case CHEATS_AR_IF_NOT_EQUAL32: skip = !(op.val != ARread32(op, offset)); break;
+			case CHEATS_AR_IF_GREATER16: skip = !(op.val > (op.arg & ARread16(op, offset))); break;
+			case CHEATS_AR_IF_LESSER16: skip = !(op.val < (op.arg & ARread16(op, offset))); break;
+			case CHEATS_AR_IF_EQUAL16: skip = !(op.val == (op.arg & ARread16(op, offset))); break;
+			case CHEATS_AR_IF_NOT_EQUAL16: skip = !(op.val != (op.arg & ARread16(op, offset))); break;
+
+			case CHEATS_AR_LOAD_OFFSET:
+				offset = _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(op.addr + offset);
+			break;
 
-					case 0x5:	// D5000000 XXXXXXXX   datareg = XXXXXXXX
-						datareg = lo;
-					break;
+			case CHEATS_AR_FOR:
+				if (loopcount < (op.val+1))
+					loop_flag = 1;
+				else
+					loop_flag = 0;
+				loopcount++;
+				loopbackline = i;
+			break;
 
-					case 0x6:	// D6000000 XXXXXXXX   word[XXXXXXXX+offset]=datareg, offset=offset+4
-						addr = lo + offset;
-						_MMU_write32<ARMCPU_ARM7,MMU_AT_DEBUG>(addr, datareg);
-						offset += 4;
-					break;
+			case CHEATS_AR_OFFSET_HERE:
+				printf("AR: untested code C4\n");
+			break;
 
-					case 0x7:	// D7000000 XXXXXXXX   half[XXXXXXXX+offset]=datareg, offset=offset+2
-						addr = lo + offset;
-						_MMU_write16<ARMCPU_ARM7,MMU_AT_DEBUG>(addr, datareg);
-						offset += 2;
-					break;
+			case CHEATS_AR_IF_COUNTER:
+				counter++;
+				skip = !( (counter & (op.val & 0xFFFF)) == ((op.val >> 8) & 0xFFFF) );
+			break;
 
-					case 0x8:	// D8000000 XXXXXXXX   byte[XXXXXXXX+offset]=datareg, offset=offset+1
-						addr = lo + offset;
-						_MMU_write08<ARMCPU_ARM7,MMU_AT_DEBUG>(addr, datareg);
-						offset += 1;
-					break;
+			case CHEATS_AR_STORE_OFFSET:
+				_MMU_write32<ARMCPU_ARM7,MMU_AT_DEBUG>(op.val, offset);
+			break;
 
-					case 0x9:	// D9000000 XXXXXXXX   datareg = word[XXXXXXXX+offset]
-						addr = lo + offset;
-						datareg = _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(addr);
-					break;
+			case CHEATS_AR_NEXT:
+			case CHEATS_AR_NEXT_FLUSH:
+				if (loop_flag)
+				{
+					i = loopbackline;
+					continue;
+				}
+				if (op.opcode == CHEATS_AR_NEXT_FLUSH)
+				{
+					offset = 0;
+					datareg = 0;
+					loopcount = 0;
+					counter = 0;
+					loop_flag = 0;
+				}
+			break;
 
-					case 0xA:	// DA000000 XXXXXXXX   datareg = half[XXXXXXXX+offset]
-						addr = lo + offset;
-						datareg = _MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(addr);
-					break;
+			case CHEATS_AR_SET_OFFSET: offset = op.val; break;
+			case CHEATS_AR_ADD_DATA: datareg += op.val; break;
+			case CHEATS_AR_SET_DATA: datareg = op.val; break;
 
-					case 0xB:	// DB000000 XXXXXXXX   datareg = byte[XXXXXXXX+offset] ;bugged on pre-v1.54
-						addr = lo + offset;
-						datareg = _MMU_read08<ARMCPU_ARM7,MMU_AT_DEBUG>(addr);
-					break;
+			case CHEATS_AR_STORE_DATA32:
+				_MMU_write32<ARMCPU_ARM7,MMU_AT_DEBUG>(op.val + offset, datareg);
+				offset += 4;
+			break;
 
-					case 0xC:	// DC000000 XXXXXXXX   offset = offset + XXXXXXXX
-						offset += lo;
-					break;
-				}
-			}
+			case CHEATS_AR_STORE_DATA16:
+				_MMU_write16<ARMCPU_ARM7,MMU_AT_DEBUG>(op.val + offset, datareg);
+				offset += 2;
 			break;
 
-			case 0xE:		// EXXXXXXX YYYYYYYY   Copy YYYYYYYY parameter bytes to [XXXXXXXX+offset...]
+			case CHEATS_AR_STORE_DATA08:
+				_MMU_write08<ARMCPU_ARM7,MMU_AT_DEBUG>(op.val + offset, datareg);
+				offset += 1;
+			break;
+
+			case CHEATS_AR_LOAD_DATA32: datareg = _MMU_read32<ARMCPU_ARM7,MMU_AT_DEBUG>(op.val + offset); break;
+			case CHEATS_AR_LOAD_DATA16: datareg = _MMU_read16<ARMCPU_ARM7,MMU_AT_DEBUG>(op.val + offset); break;
+			case CHEATS_AR_LOAD_DATA08: datareg = _MMU_read08<ARMCPU_ARM7,MMU_AT_DEBUG>(op.val + offset); break;
+			case CHEATS_AR_ADD_OFFSET: offset += op.val; break;
+
+			case CHEATS_AR_PATCH:
 			{
-				u8	*tmp_code = (u8*)(list.code[i+1]);
-				u32 addr = hi+offset;
-				u32 maxByteReadLocation = ((2 * 4) * (MAX_XX_CODE - i - 1)) - 1; // 2 = 2 array dimensions, 4 = 4 bytes per array element
-				
-				if (lo <= maxByteReadLocation)
+				u32 addr = op.addr + offset;
+				for (u32 t = 0; t < op.val; t++)
 				{
-					for (u32 t = 0; t < lo; t++)
-					{
-						u8	tmp = tmp_code[t];
-						_MMU_write08<ARMCPU_ARM7,MMU_AT_DEBUG>(addr, tmp);
-						addr++;
-					}
+					_MMU_write08<ARMCPU_ARM7,MMU_AT_DEBUG>(addr, prog.data[op.arg + t]);
+					addr++;
 				}
-				
-				i += ((lo + 7) / 8);
 			}
 			break;
 
-			case 0xF:		// FXXXXXXX YYYYYYYY   Copy YYYYYYYY bytes from [offset..] to [XXXXXXX...]
-				for (u32 t = 0; t < lo; t++)
+			case CHEATS_AR_COPY:
+				for (u32 t = 0; t < op.val; t++)
 				{
 					u8 tmp = _MMU_read08<ARMCPU_ARM7,MMU_AT_DEBUG>(offset+t);
-					_MMU_write08<ARMCPU_ARM7,MMU_AT_DEBUG>(hi+t, tmp);
+					_MMU_write08<ARMCPU_ARM7,MMU_AT_DEBUG>(op.addr+t, tmp);
 				}
 			break;
-			default: PROGINFO("AR: ERROR unknown command 0x%2X at %08X:%08X\n", type, hi, lo); break;
 		}
+
+		if (!skip)
+		{
+			i++;
+			continue;
+		}
+
+		//a NEXT & Flush met while skipping still loops back, but stays skipping
+		u32 end = (i + 1 < count) ? ops[i + 1].skipEnd : count;
+		while ( (end < count) && (ops[end].opcode == CHEATS_AR_NEXT_FLUSH) && loop_flag )
+			end = ops[loopbackline].skipEnd;
+
+		if ( (end < count) && (ops[end].opcode == CHEATS_AR_NEXT_FLUSH) )
+		{
+			offset = 0;
+			datareg = 0;
+			loopcount = 0;
+			counter = 0;
+			loop_flag = 0;
+		}
+
+		i = end + 1;
 	}
 }
 
@@ -792,8 +768,19 @@ void CHEATS::process(int targetType)
 			} //end case 0 internal cheat system
 
 			case 1:		// Action Replay
-				ARparser(list[i]);
+			{
+				if (arProgram.size() < num)
+					arProgram.resize(num);
+
+				//rebuild the ops only when the code lines differ from the last time
+				CHEATS_AR_PROGRAM &prog = arProgram[i];
+				if ( (prog.num != list[i].num) ||
+				     (!prog.source.empty() && memcmp(&prog.source[0], list[i].code, prog.source.size() * sizeof(u32)) != 0) )
+					ARcompile(list[i], prog);
+
+				ARrun(prog);
 				break;
+			}
 			case 2:		// Codebreaker
 				break;
 			default: continue;
@@ -869,23 +856,234 @@ BOOL CHEATS::XXCodeFromString(CHEATS_LIST *cheatItem, const char *codeString)
 }
 
 // ========================================== search
+//the search works on candidates rather than addresses: candidate n is the value at address n*(_size+1).
+//whether each candidate is still in is one bit in statMem, which the search goes through 64 candidates
+//at a time, so that the bulk of RAM that has already been ruled out costs next to nothing. when few
+//enough candidates remain, they move over to a sorted address list which is cheaper still.
+
+#define CHEATSEARCH_RAM_SIZE			(4 * 1024 * 1024)
+#define CHEATSEARCH_SPARSE_THRESHOLD	0x10000
+
+static FORCEINLINE u32 CheatSearch_Read(u8 *buf, const u32 addr, const u32 size)
+{
+	switch (size)
+	{
+		case 0: return (u32)T1ReadByte(buf, addr);
+		case 1: return (u32)T1ReadWord(buf, addr);
+		case 2: return (u32)T1ReadLong(buf, addr) & 0x00FFFFFF;
+		case 3: return (u32)T1ReadLong(buf, addr);
+	}
+	return 0;
+}
+
+//values are compared as signed by sign extending them and then flipping the top bit,
+//which turns signed order into unsigned order
+static FORCEINLINE u32 CheatSearch_Order(const u32 val, const u32 size, const bool isSigned)
+{
+	if (!isSigned) return val;
+	const u32 signBit = 1U << (((size + 1) * 8) - 1);
+	return (val ^ signBit);
+}
+
+static FORCEINLINE bool CheatSearch_Test(const CHEATSEARCH::SearchPredicate &pred, const u32 cur, const u32 prev, const u32 size)
+{
+	switch (pred.kind)
+	{
+		case CHEATSEARCH::PREDICATE_EQUALS_VALUE: return (cur == pred.a);
+		case CHEATSEARCH::PREDICATE_GREATER_THAN: return (cur > prev);
+		case CHEATSEARCH::PREDICATE_LESSER_THAN: return (cur < prev);
+		case CHEATSEARCH::PREDICATE_EQUALS_TO: return (cur == prev);
+		case CHEATSEARCH::PREDICATE_NOT_EQUALS_TO: return (cur != prev);
+
+		case CHEATSEARCH::PREDICATE_RANGE:
+		{
+			const u32 val = CheatSearch_Order(cur, size, pred.isSigned);
+			return (val >= pred.a) && (val <= pred.b);
+		}
+
+		case CHEATSEARCH::PREDICATE_DELTA:
+		{
+			const u32 mask = (size == 3) ? 0xFFFFFFFF : ((1U << ((size + 1) * 8)) - 1);
+			const u32 val = CheatSearch_Order((cur - prev) & mask, size, true);
+			return (val >= pred.a) && (val <= pred.b);
+		}
+
+		default: return false;
+	}
+}
+
+//turns the range bounds of the predicate into ordered values of the search size
+//(see CheatSearch_Order). returns false if nothing can be in the range
+static bool CheatSearch_PrepareRange(CHEATSEARCH::SearchPredicate &pred, s64 min, s64 max, const u32 size, const bool isSigned)
+{
+	const u32 bits = (size + 1) * 8;
+	const s64 lowest = isSigned ? -((s64)1 << (bits - 1)) : 0;
+	const s64 highest = isSigned ? (((s64)1 << (bits - 1)) - 1) : (((s64)1 << bits) - 1);
+
+	min = std::max<s64>(min, lowest);
+	max = std::min<s64>(max, highest);
+	if (min > max)
+		return false;
+
+	pred.a = CheatSearch_Order((u32)min, size, isSigned);
+	pred.b = CheatSearch_Order((u32)max, size, isSigned);
+	if (bits < 32)
+	{
+		pred.a &= (1U << bits) - 1;
+		pred.b &= (1U << bits) - 1;
+	}
+	return true;
+}
+
+#ifdef ENABLE_SSE2
+template<int SIZE> struct CheatSearch_SSE2;
+
+template<> struct CheatSearch_SSE2<1>
+{
+	static FORCEINLINE __m128i set1(const u32 v) { return _mm_set1_epi8((s8)v); }
+	static FORCEINLINE __m128i cmpeq(const __m128i &a, const __m128i &b) { return _mm_cmpeq_epi8(a, b); }
+	static FORCEINLINE __m128i cmpgt(const __m128i &a, const __m128i &b) { return _mm_cmpgt_epi8(a, b); }
+	static FORCEINLINE __m128i sub(const __m128i &a, const __m128i &b) { return _mm_sub_epi8(a, b); }
+	static FORCEINLINE u32 movemask(const __m128i &m) { return (u32)_mm_movemask_epi8(m); }
+	static const u32 signBit = 0x80;
+};
+
+template<> struct CheatSearch_SSE2<2>
+{
+	static FORCEINLINE __m128i set1(const u32 v) { return _mm_set1_epi16((s16)v); }
+	static FORCEINLINE __m128i cmpeq(const __m128i &a, const __m128i &b) { return _mm_cmpeq_epi16(a, b); }
+	static FORCEINLINE __m128i cmpgt(const __m128i &a, const __m128i &b) { return _mm_cmpgt_epi16(a, b); }
+	static FORCEINLINE __m128i sub(const __m128i &a, const __m128i &b) { return _mm_sub_epi16(a, b); }
+	static FORCEINLINE u32 movemask(const __m128i &m) { return (u32)_mm_movemask_epi8(_mm_packs_epi16(m, _mm_setzero_si128())); }
+	static const u32 signBit = 0x8000;
+};
+
+template<> struct CheatSearch_SSE2<4>
+{
+	static FORCEINLINE __m128i set1(const u32 v) { return _mm_set1_epi32((s32)v); }
+	static FORCEINLINE __m128i cmpeq(const __m128i &a, const __m128i &b) { return _mm_cmpeq_epi32(a, b); }
+	static FORCEINLINE __m128i cmpgt(const __m128i &a, const __m128i &b) { return _mm_cmpgt_epi32(a, b); }
+	static FORCEINLINE __m128i sub(const __m128i &a, const __m128i &b) { return _mm_sub_epi32(a, b); }
+	static FORCEINLINE u32 movemask(const __m128i &m) { return (u32)_mm_movemask_ps(_mm_castsi128_ps(m)); }
+	static const u32 signBit = 0x80000000;
+};
+
+//tests 16 bytes worth of values at once. the ordered values of CheatSearch_Order are
+//unsigned, so they get their top bit flipped here to compare them with signed compares
+template<int SIZE>
+static FORCEINLINE __m128i CheatSearch_TestSSE2(const CHEATSEARCH::SearchPredicate &pred, const __m128i &cur, const __m128i &prev)
+{
+	typedef CheatSearch_SSE2<SIZE> V;
+	const __m128i flip = V::set1(V::signBit);
+
+	switch (pred.kind)
+	{
+		case CHEATSEARCH::PREDICATE_EQUALS_VALUE: return V::cmpeq(cur, V::set1(pred.a));
+		case CHEATSEARCH::PREDICATE_GREATER_THAN: return V::cmpgt(_mm_xor_si128(cur, flip), _mm_xor_si128(prev, flip));
+		case CHEATSEARCH::PREDICATE_LESSER_THAN: return V::cmpgt(_mm_xor_si128(prev, flip), _mm_xor_si128(cur, flip));
+		case CHEATSEARCH::PREDICATE_EQUALS_TO: return V::cmpeq(cur, prev);
+		case CHEATSEARCH::PREDICATE_NOT_EQUALS_TO: return _mm_andnot_si128(V::cmpeq(cur, prev), _mm_set1_epi32(-1));
+
+		case CHEATSEARCH::PREDICATE_RANGE:
+		case CHEATSEARCH::PREDICATE_DELTA:
+		{
+			__m128i val = (pred.kind == CHEATSEARCH::PREDICATE_RANGE) ? cur : V::sub(cur, prev);
+			//signed values get flipped once to order them and once more to compare them, which cancels out
+			if (pred.kind == CHEATSEARCH::PREDICATE_RANGE && !pred.isSigned)
+				val = _mm_xor_si128(val, flip);
+			const __m128i lo = _mm_xor_si128(V::set1(pred.a), flip);
+			const __m128i hi = _mm_xor_si128(V::set1(pred.b), flip);
+			const __m128i out = _mm_or_si128(V::cmpgt(lo, val), V::cmpgt(val, hi));
+			return _mm_andnot_si128(out, _mm_set1_epi32(-1));
+		}
+
+		default: return _mm_setzero_si128();
+	}
+}
+
+template<int SIZE>
+static u32 CheatSearch_DenseSSE2(const CHEATSEARCH::SearchPredicate &pred, u8 *ram, u8 *snapshot, u64 *alive, const u32 groupCount)
+{
+	u32 amount = 0;
+
+	for (u32 g = 0; g < groupCount; g++)
+	{
+		if (alive[g] == 0)
+			continue;
+
+		const u32 base = g * 64 * SIZE;
+		u64 result = 0;
+		for (u32 c = 0; c < 64 * SIZE; c += 16)
+		{
+			const __m128i cur = _mm_loadu_si128((const __m128i *)(ram + base + c));
+			const __m128i prev = _mm_loadu_si128((const __m128i *)(snapshot + base + c));
+			result |= (u64)CheatSearch_SSE2<SIZE>::movemask(CheatSearch_TestSSE2<SIZE>(pred, cur, prev)) << (c / SIZE);
+		}
+
+		alive[g] &= result;
+		for (u64 bits = alive[g]; bits != 0; bits &= bits - 1)
+			amount++;
+	}
+
+	return amount;
+}
+#endif
+
+static u32 CheatSearch_Dense(const CHEATSEARCH::SearchPredicate &pred, u8 *ram, u8 *snapshot, u64 *alive, const u32 groupCount, const u32 size)
+{
+	const u32 step = size + 1;
+	u32 amount = 0;
+
+	for (u32 g = 0; g < groupCount; g++)
+	{
+		if (alive[g] == 0)
+			continue;
+
+		u64 result = 0;
+		for (u32 n = 0; n < 64; n++)
+		{
+			if (!(alive[g] & ((u64)1 << n)))
+				continue;
+
+			const u32 addr = ((g * 64) + n) * step;
+			if (CheatSearch_Test(pred, CheatSearch_Read(ram, addr, size), CheatSearch_Read(snapshot, addr, size), size))
+			{
+				result |= ((u64)1 << n);
+				amount++;
+			}
+		}
+
+		alive[g] = result;
+	}
+
+	return amount;
+}
+
 BOOL CHEATSEARCH::start(u8 type, u8 size, u8 sign)
 {
 	if (statMem) return FALSE;
 	if (mem) return FALSE;
 
-	statMem = new u8 [ ( 4 * 1024 * 1024 ) / 8 ];
-	memset(statMem, 0xFF, ( 4 * 1024 * 1024 ) / 8);
+	const u32 candidates = (CHEATSEARCH_RAM_SIZE + size) / (size + 1);
+
+	statMem = new u8 [ CHEATSEARCH_RAM_SIZE / 8 ];
+	memset(statMem, 0, CHEATSEARCH_RAM_SIZE / 8);
+	memset(statMem, 0xFF, candidates / 8);
+	if (candidates & 7)
+		statMem[candidates / 8] = (1 << (candidates & 7)) - 1;
 
 	// comparative search type (need 8Mb RAM !!! (4+4))
-	mem = new u8 [ ( 4 * 1024 * 1024 ) ];
-	memcpy(mem, MMU.MMU_MEM[0][0x20], ( 4 * 1024 * 1024 ) );
+	mem = new u8 [ CHEATSEARCH_RAM_SIZE ];
+	memcpy(mem, MMU.MMU_MEM[0][0x20], CHEATSEARCH_RAM_SIZE );
 
 	_type = type;
 	_size = size;
 	_sign = sign;
 	amount = 0;
 	lastRecord = 0;
+	isSparse = false;
+	sparseAddr.clear();
+	sparseVal.clear();
 	
 	//INFO("Cheat search system is inited (type %s)\n", type?"comparative":"exact");
 	return TRUE;
@@ -906,208 +1104,144 @@ BOOL CHEATSEARCH::close()
 	}
 	amount = 0;
 	lastRecord = 0;
+	isSparse = false;
+	std::vector<u32>().swap(sparseAddr);
+	std::vector<u32>().swap(sparseVal);
 	//INFO("Cheat search system is closed\n");
 	return FALSE;
 }
 
-u32 CHEATSEARCH::search(u32 val)
+u32 CHEATSEARCH::searchWith(const SearchPredicate &pred, bool updateSnapshot)
 {
-	amount = 0;
+	u8 *ram = MMU.MMU_MEM[ARMCPU_ARM9][0x20];
 
-	switch (_size)
+	if (isSparse)
 	{
-		case 0:		// 1 byte
-			for (u32 i = 0; i < (4 * 1024 * 1024); i++)
+		size_t kept = 0;
+		for (size_t i = 0; i < sparseAddr.size(); i++)
+		{
+			const u32 cur = CheatSearch_Read(ram, sparseAddr[i], _size);
+			if (CheatSearch_Test(pred, cur, sparseVal[i], _size))
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (1<<offs))
-				{
-					if ( T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == val )
-					{
-						statMem[addr] |= (1<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(1<<offs);
-				}
+				sparseAddr[kept] = sparseAddr[i];
+				sparseVal[kept] = (updateSnapshot) ? cur : sparseVal[i];
+				kept++;
 			}
-		break;
+		}
 
-		case 1:		// 2 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=2)
-			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (3<<offs))
-				{
-					if ( T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == val )
-					{
-						statMem[addr] |= (3<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(3<<offs);
-				}
-			}
-		break;
+		sparseAddr.resize(kept);
+		sparseVal.resize(kept);
+		amount = (u32)kept;
+		return amount;
+	}
 
-		case 2:		// 3 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=3)
-			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (0x7<<offs))
-				{
-					if ( (T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) == val )
-					{
-						statMem[addr] |= (0x7<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(0x7<<offs);
-				}
-			}
-		break;
+	u64 *alive = (u64 *)statMem;
+	const u32 groupCount = CHEATSEARCH_RAM_SIZE / 8 / sizeof(u64);
+	const u32 step = _size + 1;
+
+#ifdef ENABLE_SSE2
+	//the vector search needs whole groups of 64 candidates to fit in RAM; with 1, 2 and 4 byte
+	//values there are exactly 4MB/size of them, so they do
+	switch (_size)
+	{
+		case 0: amount = CheatSearch_DenseSSE2<1>(pred, ram, mem, alive, groupCount / 1); break;
+		case 1: amount = CheatSearch_DenseSSE2<2>(pred, ram, mem, alive, groupCount / 2); break;
+		case 3: amount = CheatSearch_DenseSSE2<4>(pred, ram, mem, alive, groupCount / 4); break;
+		default: amount = CheatSearch_Dense(pred, ram, mem, alive, (((CHEATSEARCH_RAM_SIZE + _size) / step) + 63) / 64, _size); break;
+	}
+#else
+	amount = CheatSearch_Dense(pred, ram, mem, alive, (((CHEATSEARCH_RAM_SIZE + _size) / step) + 63) / 64, _size);
+#endif
+
+	if (updateSnapshot)
+		memcpy(mem, ram, CHEATSEARCH_RAM_SIZE );
+
+	if (amount <= CHEATSEARCH_SPARSE_THRESHOLD)
+	{
+		sparseAddr.reserve(amount);
+		sparseVal.reserve(amount);
 
-		case 3:		// 4 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=4)
+		const u32 candidates = (CHEATSEARCH_RAM_SIZE + _size) / step;
+		for (u32 g = 0; g < (candidates + 63) / 64; g++)
+		{
+			if (alive[g] == 0)
+				continue;
+
+			for (u32 n = 0; n < 64; n++)
 			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (0xF<<offs))
+				if (alive[g] & ((u64)1 << n))
 				{
-					if ( T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == val )
-					{
-						statMem[addr] |= (0xF<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(0xF<<offs);
+					const u32 addr = ((g * 64) + n) * step;
+					sparseAddr.push_back(addr);
+					sparseVal.push_back(CheatSearch_Read(mem, addr, _size));
 				}
 			}
-		break;
+		}
+
+		isSparse = true;
+		lastRecord = 0;
 	}
 
-	return (amount);
+	return amount;
+}
+
+u32 CHEATSEARCH::search(u32 val)
+{
+	SearchPredicate pred;
+	pred.kind = PREDICATE_EQUALS_VALUE;
+	pred.a = val;
+	pred.b = 0;
+	pred.isSigned = false;
+
+	//a value too big for the search size can't match anything
+	if (_size < 3 && val >= (1U << ((_size + 1) * 8)))
+		pred.kind = PREDICATE_NONE;
+
+	return searchWith(pred, false);
 }
 
 u32 CHEATSEARCH::search(u8 comp)
 {
-	BOOL	res = FALSE;
+	SearchPredicate pred;
+	pred.a = pred.b = 0;
+	pred.isSigned = false;
 
-	amount = 0;
-	
-	switch (_size)
+	switch (comp)
 	{
-		case 0:		// 1 byte
-			for (u32 i = 0; i < (4 * 1024 * 1024); i++)
-			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (1<<offs))
-				{
-					switch (comp)
-					{
-						case 0: res=(T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) > T1ReadByte(mem, i)); break;
-						case 1: res=(T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) < T1ReadByte(mem, i)); break;
-						case 2: res=(T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == T1ReadByte(mem, i)); break;
-						case 3: res=(T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) != T1ReadByte(mem, i)); break;
-						default: res = FALSE; break;
-					}
-					if ( res )
-					{
-						statMem[addr] |= (1<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(1<<offs);
-				}
-			}
-		break;
+		case 0: pred.kind = PREDICATE_GREATER_THAN; break;
+		case 1: pred.kind = PREDICATE_LESSER_THAN; break;
+		case 2: pred.kind = PREDICATE_EQUALS_TO; break;
+		case 3: pred.kind = PREDICATE_NOT_EQUALS_TO; break;
+		default: pred.kind = PREDICATE_NONE; break;
+	}
 
-		case 1:		// 2 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=2)
-			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (3<<offs))
-				{
-					switch (comp)
-					{
-						case 0: res=(T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) > T1ReadWord(mem, i)); break;
-						case 1: res=(T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) < T1ReadWord(mem, i)); break;
-						case 2: res=(T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == T1ReadWord(mem, i)); break;
-						case 3: res=(T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) != T1ReadWord(mem, i)); break;
-						default: res = FALSE; break;
-					}
-					if ( res )
-					{
-						statMem[addr] |= (3<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(3<<offs);
-				}
-			}
-		break;
+	return searchWith(pred, true);
+}
 
-		case 2:		// 3 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=3)
-			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (7<<offs))
-				{
-					switch (comp)
-					{
-						case 0: res=((T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) > (T1ReadLong(mem, i) & 0x00FFFFFF) ); break;
-						case 1: res=((T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) < (T1ReadLong(mem, i) & 0x00FFFFFF) ); break;
-						case 2: res=((T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) == (T1ReadLong(mem, i) & 0x00FFFFFF) ); break;
-						case 3: res=((T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF) != (T1ReadLong(mem, i) & 0x00FFFFFF) ); break;
-						default: res = FALSE; break;
-					}
-					if ( res )
-					{
-						statMem[addr] |= (7<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(7<<offs);
-				}
-			}
-		break;
+u32 CHEATSEARCH::searchRange(u32 min, u32 max)
+{
+	SearchPredicate pred;
+	pred.kind = PREDICATE_RANGE;
+	pred.isSigned = (_sign != 0);
 
-		case 3:		// 4 bytes
-			for (u32 i = 0; i < (4 * 1024 * 1024); i+=4)
-			{
-				u32	addr = (i >> 3);
-				u32	offs = (i % 8);
-				if (statMem[addr] & (0xF<<offs))
-				{
-					switch (comp)
-					{
-						case 0: res=(T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) > T1ReadLong(mem, i)); break;
-						case 1: res=(T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) < T1ReadLong(mem, i)); break;
-						case 2: res=(T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) == T1ReadLong(mem, i)); break;
-						case 3: res=(T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) != T1ReadLong(mem, i)); break;
-						default: res = FALSE; break;
-					}
-					if ( res )
-					{
-						statMem[addr] |= (0xF<<offs);
-						amount++;
-						continue;
-					}
-					statMem[addr] &= ~(0xF<<offs);
-				}
-			}
-		break;
-	}
+	const s64 min64 = pred.isSigned ? (s64)(s32)min : (s64)min;
+	const s64 max64 = pred.isSigned ? (s64)(s32)max : (s64)max;
+	if (!CheatSearch_PrepareRange(pred, min64, max64, _size, pred.isSigned))
+		pred.kind = PREDICATE_NONE;
 
-	memcpy(mem, MMU.MMU_MEM[0][0x20], ( 4 * 1024 * 1024 ) );
+	return searchWith(pred, false);
+}
 
-	return (amount);
+u32 CHEATSEARCH::searchDelta(s32 minDelta, s32 maxDelta)
+{
+	SearchPredicate pred;
+	pred.kind = PREDICATE_DELTA;
+	pred.isSigned = true;
+
+	if (!CheatSearch_PrepareRange(pred, minDelta, maxDelta, _size, true))
+		pred.kind = PREDICATE_NONE;
+
+	return searchWith(pred, true);
 }
 
 u32 CHEATSEARCH::getAmount()
@@ -1117,32 +1251,31 @@ u32 CHEATSEARCH::getAmount()
 
 BOOL CHEATSEARCH::getList(u32 *address, u32 *curVal)
 {
-	u8	step = (_size+1);
-	u8	stepMem = 1;
-	switch (_size)
+	if (isSparse)
 	{
-		case 1: stepMem = 0x3; break;
-		case 2: stepMem = 0x7; break;
-		case 3: stepMem = 0xF; break;
+		if (lastRecord < sparseAddr.size())
+		{
+			*address = sparseAddr[lastRecord];
+			*curVal = CheatSearch_Read(MMU.MMU_MEM[ARMCPU_ARM9][0x20], *address, _size);
+			lastRecord++;
+			return TRUE;
+		}
+
+		lastRecord = 0;
+		return FALSE;
 	}
 
-	for (u32 i = lastRecord; i < (4 * 1024 * 1024); i+=step)
+	const u32 step = (_size+1);
+	const u32 candidates = (CHEATSEARCH_RAM_SIZE + _size) / step;
+
+	for (u32 n = lastRecord / step; n < candidates; n++)
 	{
-		u32	addr = (i >> 3);
-		u32	offs = (i % 8);
-		if (statMem[addr] & (stepMem<<offs))
+		if (statMem[n >> 3] & (1 << (n & 7)))
 		{
-			*address = i;
-			lastRecord = i+step;
-			
-			switch (_size)
-			{
-				case 0: *curVal=(u32)T1ReadByte(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i); return TRUE;
-				case 1: *curVal=(u32)T1ReadWord(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i); return TRUE;
-				case 2: *curVal=(u32)T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i) & 0x00FFFFFF; return TRUE;
-				case 3: *curVal=(u32)T1ReadLong(MMU.MMU_MEM[ARMCPU_ARM9][0x20], i); return TRUE;
-				default: return TRUE;
-			}
+			*address = n * step;
+			lastRecord = *address + step;
+			*curVal = CheatSearch_Read(MMU.MMU_MEM[ARMCPU_ARM9][0x20], *address, _size);
+			return TRUE;
 		}
 	}
 	lastRecord = 0;
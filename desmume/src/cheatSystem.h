@@ -53,15 +53,77 @@ struct CHEATS_LIST
 	u8		size;
 };
 
+enum CHEATS_AR_OPCODE
+{
+	CHEATS_AR_NOP = 0,
+	CHEATS_AR_WRITE32,			// 0XXXXXXX YYYYYYYY
+	CHEATS_AR_WRITE16,			// 1XXXXXXX 0000YYYY
+	CHEATS_AR_WRITE08,			// 2XXXXXXX 000000YY
+	CHEATS_AR_IF_GREATER32,		// 3XXXXXXX YYYYYYYY
+	CHEATS_AR_IF_LESSER32,		// 4XXXXXXX YYYYYYYY
+	CHEATS_AR_IF_EQUAL32,		// 5XXXXXXX YYYYYYYY
+	CHEATS_AR_IF_NOT_EQUAL32,	// 6XXXXXXX YYYYYYYY
+	CHEATS_AR_IF_GREATER16,		// 7XXXXXXX ZZZZYYYY
+	CHEATS_AR_IF_LESSER16,		// 8XXXXXXX ZZZZYYYY
+	CHEATS_AR_IF_EQUAL16,		// 9XXXXXXX ZZZZYYYY
+	CHEATS_AR_IF_NOT_EQUAL16,	// AXXXXXXX ZZZZYYYY
+	CHEATS_AR_LOAD_OFFSET,		// BXXXXXXX 00000000
+	CHEATS_AR_FOR,				// C0000000 YYYYYYYY
+	CHEATS_AR_OFFSET_HERE,		// C4000000 00000000
+	CHEATS_AR_IF_COUNTER,		// C5000000 XXXXYYYY
+	CHEATS_AR_STORE_OFFSET,		// C6000000 XXXXXXXX
+	CHEATS_AR_ENDIF,			// D0000000 00000000
+	CHEATS_AR_NEXT,				// D1000000 00000000
+	CHEATS_AR_NEXT_FLUSH,		// D2000000 00000000
+	CHEATS_AR_SET_OFFSET,		// D3000000 XXXXXXXX
+	CHEATS_AR_ADD_DATA,			// D4000000 XXXXXXXX
+	CHEATS_AR_SET_DATA,			// D5000000 XXXXXXXX
+	CHEATS_AR_STORE_DATA32,		// D6000000 XXXXXXXX
+	CHEATS_AR_STORE_DATA16,		// D7000000 XXXXXXXX
+	CHEATS_AR_STORE_DATA08,		// D8000000 XXXXXXXX
+	CHEATS_AR_LOAD_DATA32,		// D9000000 XXXXXXXX
+	CHEATS_AR_LOAD_DATA16,		// DA000000 XXXXXXXX
+	CHEATS_AR_LOAD_DATA08,		// DB000000 XXXXXXXX
+	CHEATS_AR_ADD_OFFSET,		// DC000000 XXXXXXXX
+	CHEATS_AR_PATCH,			// EXXXXXXX YYYYYYYY
+	CHEATS_AR_COPY				// FXXXXXXX YYYYYYYY
+};
+
+// one Action Replay code line, decoded
+struct CHEATS_AR_OP
+{
+	u8		opcode;
+	u8		useOffset;		// conditions on address 0 test the word at offset instead
+	u8		isMainMem;		// conditions on a fixed main RAM address read it straight from MMU.MAIN_MEM
+	u32		addr;
+	u32		val;
+	u32		arg;			// 16 bit conditions: the mask; EXXXXXXX: where the bytes start in data
+	u32		skipEnd;		// the first ENDIF or NEXT & Flush from this op on, which a false condition skips to
+};
+
+// an Action Replay code list, decoded once so that it doesn't have to be every frame
+struct CHEATS_AR_PROGRAM
+{
+	CHEATS_AR_PROGRAM()
+		: num(-1)
+	{}
+	int num;
+	std::vector<u32> source;		// the code lines this was built from, to tell when the list has changed
+	std::vector<CHEATS_AR_OP> op;
+	std::vector<u8> data;
+};
+
 class CHEATS
 {
 private:
 	std::vector<CHEATS_LIST> list;
+	std::vector<CHEATS_AR_PROGRAM> arProgram;	// parallel to list
 	u8					filename[MAX_PATH];
 	u32					currentGet;
 
 	void	clear();
-	void	ARparser(CHEATS_LIST& cheat);
+	void	ARcompile(const CHEATS_LIST& cheat, CHEATS_AR_PROGRAM& prog);
+	void	ARrun(const CHEATS_AR_PROGRAM& prog);
 	char	*clearCode(char *s);
 
 public:
@@ -100,9 +162,29 @@ public:
 
 class CHEATSEARCH
 {
+public:
+	enum PREDICATE
+	{
+		PREDICATE_NONE = 0,
+		PREDICATE_EQUALS_VALUE,		// cur == a
+		PREDICATE_GREATER_THAN,		// cur > prev
+		PREDICATE_LESSER_THAN,		// cur < prev
+		PREDICATE_EQUALS_TO,		// cur == prev
+		PREDICATE_NOT_EQUALS_TO,	// cur != prev
+		PREDICATE_RANGE,			// a <= cur <= b
+		PREDICATE_DELTA				// a <= (cur - prev) <= b
+	};
+
+	struct SearchPredicate
+	{
+		PREDICATE kind;
+		u32 a, b;
+		bool isSigned;
+	};
+
 private:
-	u8	*statMem;
-	u8	*mem;
+	u8	*statMem;	// one bit for each candidate; candidate n is the value at address n*(_size+1)
+	u8	*mem;		// main RAM as of the last comparative search
 	u32	amount;
 	u32	lastRecord;
 
@@ -110,15 +192,25 @@ private:
 	u32	_size;
 	u32	_sign;
 
+	//once only a few candidates remain, they are kept here as a sorted list instead of statMem,
+	//along with each one's value as of the last comparative search (instead of mem)
+	bool isSparse;
+	std::vector<u32> sparseAddr;
+	std::vector<u32> sparseVal;
+
+	u32 searchWith(const SearchPredicate &pred, bool updateSnapshot);
+
 public:
 	CHEATSEARCH()
-			: statMem(0), mem(0), amount(0), lastRecord(0), _type(0), _size(0), _sign(0) 
+			: statMem(0), mem(0), amount(0), lastRecord(0), _type(0), _size(0), _sign(0), isSparse(false)
 	{}
 	~CHEATSEARCH() { close(); }
 	BOOL start(u8 type, u8 size, u8 sign);
 	BOOL close();
 	u32 search(u32 val);
 	u32 search(u8 comp);
+	u32 searchRange(u32 min, u32 max);				// keeps values within [min, max], signed or not as given to start()
+	u32 searchDelta(s32 minDelta, s32 maxDelta);	// keeps values that changed by [minDelta, maxDelta] since the last comparative search
 	u32 getAmount();
 	BOOL getList(u32 *address, u32 *curVal);
 	void getListReset();
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <stdio.h>
+#include <stdlib.h>
 #include "commandline.h"
 #include "types.h"
 #include "movie.h"
@@ -49,14 +50,21 @@ CommandLine::CommandLine()
 , _spu_sync_method(-1)
 , _spu_advanced(0)
 , _num_cores(-1)
+, _thread_spin(0)
+, _thread_affinity(NULL)
+, _3d_pipelined(0)
+, _gpu_parallel(0)
 , _rigorous_timing(0)
 , _advanced_timing(-1)
+, _idle_loop_skip(0)
+, _fastmem(0)
 , _slot1(NULL)
 , _slot1_fat_dir(NULL)
 , _slot1_fat_dir_type(false)
 #ifdef HAVE_JIT
 , _cpu_mode(-1)
 , _jit_size(-1)
+, _jit_profile(0)
 #endif
 , _console_type(NULL)
 , _advanscene_import(NULL)
@@ -92,10 +100,16 @@ static std::string strtoupper(const std::string& str)
 static const char* help_string = \
 "Arguments affecting overall emulator behaviour: (`user settings`):" ENDL
 " --num-cores N              Override numcores detection and use this many" ENDL
+" --thread-spin              Let idle worker threads spin before sleeping" ENDL
+" --thread-affinity MASK     Run worker threads only on the cores in this hex mask" ENDL
 " --spu-synch                Use SPU synch (crackles; helps streams; default ON)" ENDL
 " --spu-method N             Select SPU synch method: 0:N, 1:Z, 2:P; default 0" ENDL
 " --3d-render [SW|AUTOGL|GL|OLDGL]" ENDL
 "                            Select 3d renderer; default SW" ENDL
+" --3d-pipelined             Overlap 3d rendering with the next frame (adds a" ENDL
+"                            frame of 3d latency); default OFF" ENDL
+" --gpu-parallel             Render the two 2d engines on separate threads;" ENDL
+"                            default OFF" ENDL
 #ifndef HOST_WINDOWS 
 " --disable-sound            Disables the sound output" ENDL
 " --disable-limiter          Disables the 60fps limiter" ENDL
@@ -106,9 +120,12 @@ ENDL
 #ifdef HAVE_JIT
 " --jit-enable               Formerly --cpu-mode; default OFF" ENDL
 " --jit-size N               JIT block size 1-100; 1:accurate 100:fast (default)" ENDL
+" --jit-profile              Remember hot JIT blocks per game to speed up later runs" ENDL
 #endif
 " --advanced-timing          Use advanced bus-level timing; default ON" ENDL
 " --rigorous-timing          Use more realistic component timings; default OFF" ENDL
+" --idle-loop-skip           Skip the time spent in polling loops; default OFF" ENDL
+" --fastmem                  Read WRAM, ITCM and VRAM through a page table; default OFF" ENDL
 " --spu-advanced             Enable advanced SPU capture functions (reverb)" ENDL
 " --backupmem-db             Use DB for autodetecting backup memory type" ENDL
 ENDL
@@ -160,6 +177,7 @@ ENDL
 //https://github.com/mono/mono/blob/b7a308f660de8174b64697a422abfc7315d07b8c/eglib/test/driver.c
 
 #define OPT_NUMCORES 1
+#define OPT_THREAD_AFFINITY 4
 #define OPT_SPU_METHOD 2
 #define OPT_3D_RENDER 3
 #define OPT_JIT_SIZE 100
@@ -206,9 +224,13 @@ bool CommandLine::parse(int argc,char **argv)
 
 			//user settings
 			{ "num-cores", required_argument, NULL, OPT_NUMCORES },
+			{ "thread-spin", no_argument, &_thread_spin, 1},
+			{ "thread-affinity", required_argument, NULL, OPT_THREAD_AFFINITY },
 			{ "spu-synch", no_argument, &_spu_sync_mode, 1 },
 			{ "spu-method", required_argument, NULL, OPT_SPU_METHOD },
 			{ "3d-render", required_argument, NULL, OPT_3D_RENDER },
+			{ "3d-pipelined", no_argument, &_3d_pipelined, 1},
+			{ "gpu-parallel", no_argument, &_gpu_parallel, 1},
 			#ifndef HOST_WINDOWS 
 				{ "disable-sound", no_argument, &disable_sound, 1},
 				{ "disable-limiter", no_argument, &disable_limiter, 1},
@@ -219,9 +241,12 @@ bool CommandLine::parse(int argc,char **argv)
 			#ifdef HAVE_JIT
 				{ "jit-enable", no_argument, &_cpu_mode, 1},
 				{ "jit-size", required_argument, &_jit_size}, 
+				{ "jit-profile", no_argument, &_jit_profile, 1},
 			#endif
 			{ "rigorous-timing", no_argument, &_spu_advanced, 1},
 			{ "advanced-timing", no_argument, &_rigorous_timing, 1},
+			{ "idle-loop-skip", no_argument, &_idle_loop_skip, 1},
+			{ "fastmem", no_argument, &_fastmem, 1},
 			{ "spu-advanced", no_argument, &_advanced_timing, 1},
 			{ "backupmem-db", no_argument, &autodetect_method, 1},
 
@@ -277,6 +302,7 @@ bool CommandLine::parse(int argc,char **argv)
 
 		//user settings
 		case OPT_NUMCORES: _num_cores = atoi(optarg); break;
+		case OPT_THREAD_AFFINITY: _thread_affinity = optarg; break;
 		case OPT_SPU_METHOD: _spu_sync_method = atoi(optarg); break;
 		case OPT_3D_RENDER: _render3d = optarg; break;
 
@@ -326,8 +352,14 @@ bool CommandLine::parse(int argc,char **argv)
 
 	if(_load_to_memory != -1) CommonSettings.loadToMemory = (_load_to_memory == 1)?true:false;
 	if(_num_cores != -1) CommonSettings.num_cores = _num_cores;
+	if(_thread_spin) CommonSettings.thread_spin = true;
+	if(_thread_affinity) CommonSettings.thread_affinity = strtoull(_thread_affinity, NULL, 16);
+	if(_3d_pipelined) CommonSettings.GFX3D_Renderer_Pipelined = true;
+	if(_gpu_parallel) CommonSettings.GPU_ParallelEngines = true;
 	if(_rigorous_timing) CommonSettings.rigorous_timing = true;
 	if(_advanced_timing != -1) CommonSettings.advanced_timing = _advanced_timing==1;
+	if(_idle_loop_skip) CommonSettings.idle_loop_skip = true;
+	if(_fastmem) CommonSettings.fastmem = true;
 
 #ifdef HAVE_JIT
 	if(_cpu_mode != -1) CommonSettings.use_jit = (_cpu_mode==1);
@@ -338,6 +370,7 @@ bool CommandLine::parse(int argc,char **argv)
 		else
 			CommonSettings.jit_max_block_size = _jit_size;
 	}
+	if(_jit_profile) CommonSettings.jit_profile = true;
 #endif
 	if(depth_threshold != -1)
 		CommonSettings.GFX3D_Zelda_Shadow_Depth_Hack = depth_threshold;
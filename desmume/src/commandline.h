@@ -95,11 +95,18 @@ private:
 	int _bios_swi;
 	int _spu_advanced;
 	int _num_cores;
+	int _thread_spin;
+	char* _thread_affinity;
+	int _3d_pipelined;
+	int _gpu_parallel;
 	int _rigorous_timing;
 	int _advanced_timing;
+	int _idle_loop_skip;
+	int _fastmem;
 #ifdef HAVE_JIT
 	int _cpu_mode;
 	int _jit_size;
+	int _jit_profile;
 #endif
 	char* _slot1;
 	char *_slot1_fat_dir;
@@ -21,7 +21,7 @@
 
 
 // This function is called when running a filter in multithreaded mode.
-static void* RunVideoFilterTask(void *arg);
+static void RunVideoFilterTask(void *arg, size_t index);
 
 // Attributes list of known video filters, indexed using VideoFilterTypeID.
 // Use VideoFilter::GetAttributesByID() to retrieve a filter's attributes.
@@ -114,7 +114,7 @@ VideoFilter::VideoFilter(size_t srcWidth,
 	ThreadLockInit(&_lockAttributes);
 	ThreadCondInit(&_condRunning);
 	
-	// Create all threads
+	// Set up the per-thread slices; the filtering itself runs on the shared task pool
 	_vfThread.resize(threadCount);
 	
 	for (size_t i = 0; i < threadCount; i++)
@@ -122,9 +122,6 @@ VideoFilter::VideoFilter(size_t srcWidth,
 		_vfThread[i].param.srcSurface = _vfSrcSurface;
 		_vfThread[i].param.dstSurface = _vfDstSurface;
 		_vfThread[i].param.filterFunction = NULL;
-		
-		_vfThread[i].task = new Task;
-		_vfThread[i].task->start(false);
 	}
 	
 	_vfFunc = _vfAttributes.filterFunction;
@@ -136,15 +133,7 @@ VideoFilter::VideoFilter(size_t srcWidth,
  ********************************************************************************************/
 VideoFilter::~VideoFilter()
 {
-	// Destroy all threads first
-	for (size_t i = 0; i < _vfThread.size(); i++)
-	{
-		_vfThread[i].task->finish();
-		_vfThread[i].task->shutdown();
-		
-		delete _vfThread[i].task;
-	}
-	
+	// RunFilter() doesn't return before all the slices are done, so there's nothing to wait for here
 	_vfThread.clear();
 	
 	// Destroy everything else
@@ -483,15 +472,7 @@ uint32_t* VideoFilter::RunFilter()
 		const size_t threadCount = this->_vfThread.size();
 		if (threadCount > 0)
 		{
-			for (size_t i = 0; i < threadCount; i++)
-			{
-				this->_vfThread[i].task->execute(&RunVideoFilterTask, &this->_vfThread[i].param);
-			}
-			
-			for (size_t i = 0; i < threadCount; i++)
-			{
-				this->_vfThread[i].task->finish();
-			}
+			TaskPool::parallelFor(threadCount, &RunVideoFilterTask, &this->_vfThread[0]);
 		}
 		else
 		{
@@ -994,13 +975,11 @@ void VideoFilter::SetFilterParameterf(VideoFilterParamID paramID, float value)
 }
 
 // Task function for multithreaded filtering
-static void* RunVideoFilterTask(void *arg)
+static void RunVideoFilterTask(void *arg, size_t index)
 {
-	VideoFilterThreadParam *param = (VideoFilterThreadParam *)arg;
+	VideoFilterThreadParam *param = &((VideoFilterThread *)arg)[index].param;
 	
 	param->filterFunction(param->srcSurface, param->dstSurface);
-	
-	return NULL;
 }
 
 #ifdef HOST_WINDOWS 
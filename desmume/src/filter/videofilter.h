@@ -122,7 +122,6 @@ typedef struct
 
 typedef struct
 {
-	Task *task;
 	VideoFilterThreadParam param;
 } VideoFilterThread;
 
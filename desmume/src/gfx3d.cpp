@@ -671,6 +671,33 @@ static void GEM_TransformVertex(const s32 *matrix, s32 *vecPtr)
 	vecPtr[2] = GEM_SaturateAndShiftdown36To32(GEM_Mul32x32To64(x,matrix[2]) + GEM_Mul32x32To64(y,matrix[6]) + GEM_Mul32x32To64(z,matrix[10]) + GEM_Mul32x32To64(w,matrix[14]));
 	vecPtr[3] = GEM_SaturateAndShiftdown36To32(GEM_Mul32x32To64(x,matrix[3]) + GEM_Mul32x32To64(y,matrix[7]) + GEM_Mul32x32To64(z,matrix[11]) + GEM_Mul32x32To64(w,matrix[15]));
 }
+
+#ifdef ENABLE_AVX2
+//Same as GEM_TransformVertex(), but computes all 4 components at once. Each input component
+//comes in broadcast to every 32-bit lane, and each output component is returned in the low
+//32 bits of its own 64-bit lane, ready to be broadcast again for the next transform.
+//The 64-bit sums are the same as the scalar ones, so the results are identical.
+static FORCEINLINE __m256i GEM_TransformVertex_AVX2(const s32 *matrix, const __m256i &x, const __m256i &y, const __m256i &z, const __m256i &w)
+{
+	const __m256i col0 = _mm256_cvtepi32_epi64( _mm_loadu_si128((__m128i *)(matrix +  0)) );
+	const __m256i col1 = _mm256_cvtepi32_epi64( _mm_loadu_si128((__m128i *)(matrix +  4)) );
+	const __m256i col2 = _mm256_cvtepi32_epi64( _mm_loadu_si128((__m128i *)(matrix +  8)) );
+	const __m256i col3 = _mm256_cvtepi32_epi64( _mm_loadu_si128((__m128i *)(matrix + 12)) );
+	
+	__m256i sum = _mm256_add_epi64( _mm256_add_epi64(_mm256_mul_epi32(x, col0), _mm256_mul_epi32(y, col1)),
+	                                _mm256_add_epi64(_mm256_mul_epi32(z, col2), _mm256_mul_epi32(w, col3)) );
+	
+	const __m256i saturateHi = _mm256_cmpgt_epi64(sum, _mm256_set1_epi64x(0x000007FFFFFFFFFFLL));
+	const __m256i saturateLo = _mm256_cmpgt_epi64(_mm256_set1_epi64x((s64)0xFFFFF80000000000ULL), sum);
+	
+	//there's no 64-bit arithmetic shift in AVX2, but only the low 32 bits of the result are kept, so a logical shift will do
+	sum = _mm256_srli_epi64(sum, 12);
+	sum = _mm256_blendv_epi8(sum, _mm256_set1_epi64x(0x7FFFFFFF), saturateHi);
+	sum = _mm256_blendv_epi8(sum, _mm256_set1_epi64x(0x80000000), saturateLo);
+	
+	return sum;
+}
+#endif
 //---------------
 
 
@@ -706,8 +733,14 @@ static void SetVertex()
 	if(polylist->count >= POLYLIST_SIZE) 
 			return;
 
+#ifdef ENABLE_AVX2
+	__m256i v = GEM_TransformVertex_AVX2(mtxCurrent[1], _mm256_set1_epi32(coordTransformed[0]), _mm256_set1_epi32(coordTransformed[1]), _mm256_set1_epi32(coordTransformed[2]), _mm256_set1_epi32(coordTransformed[3])); //modelview
+	v = GEM_TransformVertex_AVX2(mtxCurrent[0], _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(0)), _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(2)), _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(4)), _mm256_permutevar8x32_epi32(v, _mm256_set1_epi32(6))); //projection
+	_mm_store_si128( (__m128i *)coordTransformed, _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6))) );
+#else
 	GEM_TransformVertex(mtxCurrent[1],coordTransformed); //modelview
 	GEM_TransformVertex(mtxCurrent[0],coordTransformed); //projection
+#endif
 
 	//TODO - culling should be done here.
 	//TODO - viewport transform?
@@ -2171,6 +2204,83 @@ static bool gfx3d_ysort_compare(int num1, int num2)
 	return original;
 }
 
+//maps a float to a u32 that sorts in the same order
+static FORCEINLINE u32 gfx3d_ysort_key(const float f)
+{
+	union { float f; u32 u; } bits;
+	bits.f = f + 0.0f; //turns -0 into +0, so that they compare equal like the floats do
+	return (bits.u & 0x80000000) ? ~bits.u : (bits.u | 0x80000000);
+}
+
+//Sorts a list of polygon indexes into the same order as gfx3d_ysort_compare(), which
+//is by maxy, then miny, then by the original order of the polygons. This is done with
+//an LSD radix sort on the float bits, in 11-bit digits, first on miny and then on maxy.
+//The lists come in already ordered by polygon index, and every pass is stable, so ties
+//keep the game's ordering. Whatever replaces this has to stay stable as well: polygons that
+//tie on both y values must keep the order the game sent them in, or else advance wars DOR
+//will flicker in the main map mode.
+static void gfx3d_ysort(int *list, const size_t count)
+{
+	static u32 sortKey[2][POLYLIST_SIZE];
+	static int sortTemp[POLYLIST_SIZE];
+	
+	//the bucket passes cost more than they save on short lists
+	if (count < 256)
+	{
+		std::stable_sort(list, list + count, gfx3d_ysort_compare);
+		return;
+	}
+	
+	for (size_t i = 0; i < count; i++)
+	{
+		const POLY &poly = polylist->list[list[i]];
+		sortKey[0][list[i]] = gfx3d_ysort_key(poly.miny);
+		sortKey[1][list[i]] = gfx3d_ysort_key(poly.maxy);
+	}
+	
+	int *src = list;
+	int *dst = sortTemp;
+	
+	for (size_t k = 0; k < 2; k++)
+	{
+		const u32 *key = sortKey[k];
+		
+		for (u32 shift = 0; shift < 32; shift += 11)
+		{
+			size_t bucket[2048];
+			memset(bucket, 0, sizeof(bucket));
+			
+			for (size_t i = 0; i < count; i++)
+				bucket[(key[src[i]] >> shift) & 0x7FF]++;
+			
+			//nothing to do if every key has the same digit
+			if (bucket[(key[src[0]] >> shift) & 0x7FF] == count)
+				continue;
+			
+			size_t total = 0;
+			for (size_t b = 0; b < 2048; b++)
+			{
+				const size_t n = bucket[b];
+				bucket[b] = total;
+				total += n;
+			}
+			
+			for (size_t i = 0; i < count; i++)
+				dst[bucket[(key[src[i]] >> shift) & 0x7FF]++] = src[i];
+			
+			std::swap(src, dst);
+		}
+	}
+	
+	if (src != list)
+		memcpy(list, src, count * sizeof(int));
+	
+#ifndef NDEBUG
+	for (size_t i = 1; i < count; i++)
+		assert(gfx3d_ysort_compare(list[i-1], list[i]));
+#endif
+}
+
 static void gfx3d_doFlush()
 {
 	gfx3d.render3DFrameCount++;
@@ -2210,6 +2320,32 @@ static void gfx3d_doFlush()
 	//TODO - this _MUST_ be moved later in the pipeline, after clipping.
 	//the w-division here is just an approximation to fix the shop in harvest moon island of happiness
 	//also the buttons in the knights in the nightmare frontend depend on this
+#ifdef ENABLE_SSE2
+	// Do the w-divisions for all of a polygon's vertices at once. Triangles repeat their first
+	// vertex in the last lane, which doesn't change the min or max.
+	for (size_t i = 0; i < polycount; i++)
+	{
+		POLY &poly = polylist->list[i];
+		const VERT &v0 = vertlist->list[poly.vertIndexes[0]];
+		const VERT &v1 = vertlist->list[poly.vertIndexes[1]];
+		const VERT &v2 = vertlist->list[poly.vertIndexes[2]];
+		const VERT &v3 = (poly.type == POLYGON_TYPE_QUAD) ? vertlist->list[poly.vertIndexes[3]] : v0;
+		
+		const __m128 verty = _mm_setr_ps(v0.y, v1.y, v2.y, v3.y);
+		__m128 vertw = _mm_setr_ps(v0.w, v1.w, v2.w, v3.w);
+		vertw = _mm_or_ps( _mm_andnot_ps(_mm_cmpeq_ps(vertw, _mm_setzero_ps()), vertw), _mm_and_ps(_mm_cmpeq_ps(vertw, _mm_setzero_ps()), _mm_set1_ps(0.00000001f)) );
+		
+		const __m128 y = _mm_sub_ps( _mm_set1_ps(1.0f), _mm_div_ps(_mm_add_ps(verty, vertw), _mm_add_ps(vertw, vertw)) );
+		
+		__m128 ymin = _mm_min_ps(y, _mm_shuffle_ps(y, y, 0x4E));
+		__m128 ymax = _mm_max_ps(y, _mm_shuffle_ps(y, y, 0x4E));
+		ymin = _mm_min_ss(ymin, _mm_shuffle_ps(ymin, ymin, 0xB1));
+		ymax = _mm_max_ss(ymax, _mm_shuffle_ps(ymax, ymax, 0xB1));
+		
+		poly.miny = _mm_cvtss_f32(ymin);
+		poly.maxy = _mm_cvtss_f32(ymax);
+	}
+#else
 	for (size_t i = 0; i < polycount; i++)
 	{
 		// TODO: Possible divide by zero with the w-coordinate.
@@ -2232,6 +2368,7 @@ static void gfx3d_doFlush()
 		}
 
 	}
+#endif
 
 	//we need to sort the poly list with alpha polys last
 	//first, look for opaque polys
@@ -2252,7 +2389,8 @@ static void gfx3d_doFlush()
 			gfx3d.indexlist.list[ctr++] = i;
 	}
 	
-	//NOTE: the use of the stable_sort below must be here as a workaround for some compilers on osx and linux.
+	//NOTE: this sort must be stable (gfx3d_ysort is; short lists still go through std::stable_sort).
+	//stable_sort was originally chosen as a workaround for some compilers on osx and linux.
 	//we're hazy on the exact behaviour of the resulting bug, all thats known is the list gets mangled somehow.
 	//it should not in principle be relevant since the predicate results in no ties.
 	//perhaps the compiler is buggy. perhaps the predicate is wrong.
@@ -2260,13 +2398,13 @@ static void gfx3d_doFlush()
 	//now we have to sort the opaque polys by y-value.
 	//(test case: harvest moon island of happiness character cretor UI)
 	//should this be done after clipping??
-	std::stable_sort(gfx3d.indexlist.list, gfx3d.indexlist.list + opaqueCount, gfx3d_ysort_compare);
+	gfx3d_ysort(gfx3d.indexlist.list, opaqueCount);
 	
 	if (!gfx3d.state.sortmode)
 	{
 		//if we are autosorting translucent polys, we need to do this also
 		//TODO - this is unverified behavior. need a test case
-		std::stable_sort(gfx3d.indexlist.list + opaqueCount, gfx3d.indexlist.list + polycount, gfx3d_ysort_compare);
+		gfx3d_ysort(gfx3d.indexlist.list + opaqueCount, polycount - opaqueCount);
 	}
 
 	//switch to the new lists
@@ -2287,6 +2425,15 @@ static void gfx3d_doFlush()
 
 void gfx3d_VBlankSignal()
 {
+	// When pipelining, the render that began at the last vblank end is allowed to run
+	// through this entire frame, while the GPU keeps displaying the frame before it.
+	// The render works directly out of the lists and render state that were committed
+	// by the last flush, so it has to finish here before the next flush replaces them.
+	if (CommonSettings.GFX3D_Renderer_Pipelined && CurrentRenderer->GetRenderNeedsFinish())
+	{
+		GPU->FinishRender3D(true, true);
+	}
+	
 	if (isSwapBuffers)
 	{
 #ifndef FLUSHMODE_HACK
@@ -2301,9 +2448,7 @@ void gfx3d_VBlankEndSignal(bool skipFrame)
 {
 	if (CurrentRenderer->GetRenderNeedsFinish())
 	{
-		GPU->ForceRender3DFinishAndFlush(false);
-		CurrentRenderer->SetRenderNeedsFinish(false);
-		GPU->GetEventHandler()->DidRender3DEnd();
+		GPU->FinishRender3D(false, false);
 	}
 	
 	if (!drawPending) return;
@@ -2325,6 +2470,7 @@ void gfx3d_VBlankEndSignal(bool skipFrame)
 	{
 		memset(GPU->GetEngineMain()->Get3DFramebufferRGBA6665(), 0, GPU->GetCustomFramebufferWidth() * GPU->GetCustomFramebufferHeight() * sizeof(FragmentColor));
 		memset(GPU->GetEngineMain()->Get3DFramebufferRGBA5551(), 0, GPU->GetCustomFramebufferWidth() * GPU->GetCustomFramebufferHeight() * sizeof(u16));
+		memset(GPU->GetEngineMain()->Get3DFramebufferPipelined(), 0, GPU->GetCustomFramebufferWidth() * GPU->GetCustomFramebufferHeight() * sizeof(FragmentColor));
 		CurrentRenderer->SetRenderNeedsFinish(false);
 		GPU->GetEventHandler()->DidRender3DEnd();
 	}
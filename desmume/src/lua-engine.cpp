@@ -5406,6 +5406,7 @@ void CloseLuaContext(int uid)
 
 
 TieredRegion hookedRegions [LUAMEMHOOK_COUNT];
+bool hookedExecRegionsChanged = false;
 
 
 // currently disabled for desmume,
@@ -5444,6 +5445,8 @@ static void CalculateMemHookRegions(LuaMemHookType hookType)
 		++iter;
 	}
 	hookedRegions[hookType].Calculate(hookedBytes);
+	if(hookType == LUAMEMHOOK_EXEC)
+		hookedExecRegionsChanged = true;
 }
 
 
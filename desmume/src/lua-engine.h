@@ -116,6 +116,7 @@ void DontWorryLua();
 
 #include <vector>
 #include <algorithm>
+#include <string.h>
 
 // the purpose of this structure is to provide a way of
 // QUICKLY determining whether a memory address range has a hook associated with it,
@@ -126,60 +127,43 @@ void DontWorryLua();
 // but this is an intentional tradeoff to obtain a high speed of checking during later execution
 struct TieredRegion
 {
-	template<unsigned int maxGap>
-	struct Region
+	struct Island
 	{
-		struct Island
-		{
-			unsigned int start;
-			unsigned int end;
-			FORCEINLINE bool Contains(unsigned int address, int size) const { return address < end && address+size > start; }
-		};
-		std::vector<Island> islands;
-
-		void Calculate(const std::vector<unsigned int>& bytes)
-		{
-			islands.clear();
-
-			unsigned int lastEnd = ~0;
-
-			std::vector<unsigned int>::const_iterator iter = bytes.begin();
-			std::vector<unsigned int>::const_iterator end = bytes.end();
-			for(; iter != end; ++iter)
-			{
-				unsigned int addr = *iter;
-				if(addr < lastEnd || addr > lastEnd + (long long)maxGap)
-				{
-					islands.push_back(Island());
-					islands.back().start = addr;
-				}
-				islands.back().end = addr+1;
-				lastEnd = addr+1;
-			}
-		}
-
-		bool Contains(unsigned int address, int size) const
-		{
-			typename std::vector<Island>::const_iterator iter = islands.begin();
-			typename std::vector<Island>::const_iterator end = islands.end();
-			for(; iter != end; ++iter)
-				if(iter->Contains(address, size))
-					return true;
-			return false;
-		}
+		unsigned int start;
+		unsigned int last; // inclusive, so that an island can reach the top of the address space
 	};
 
-	Region<0xFFFFFFFF> broad;
-	Region<0x1000> mid;
-	Region<0> narrow;
+	// the hooked bytes, merged into sorted islands that neither overlap nor touch
+	std::vector<Island> islands;
+
+	// one bit per 64KB page that has any hooked byte in it.
+	// almost every access can be turned away by this alone, without looking at the islands
+	enum { PAGE_SHIFT = 16 };
+	u32 pages[(0x100000000ULL >> PAGE_SHIFT) / 32];
 
 	void Calculate(std::vector<unsigned int>& bytes)
 	{
 		std::sort(bytes.begin(), bytes.end());
 
-		broad.Calculate(bytes);
-		mid.Calculate(bytes);
-		narrow.Calculate(bytes);
+		islands.clear();
+		memset(pages, 0, sizeof(pages));
+
+		std::vector<unsigned int>::const_iterator iter = bytes.begin();
+		std::vector<unsigned int>::const_iterator end = bytes.end();
+		for(; iter != end; ++iter)
+		{
+			unsigned int addr = *iter;
+			if(islands.empty() || addr > islands.back().last + 1ULL)
+			{
+				islands.push_back(Island());
+				islands.back().start = addr;
+			}
+			islands.back().last = addr;
+		}
+
+		for(size_t i = 0; i < islands.size(); i++)
+			for(unsigned int page = islands[i].start >> PAGE_SHIFT; page <= (islands[i].last >> PAGE_SHIFT); page++)
+				pages[page >> 5] |= 1 << (page & 31);
 	}
 
 	TieredRegion()
@@ -190,19 +174,44 @@ struct TieredRegion
 
 	FORCEINLINE int NotEmpty()
 	{
-		return broad.islands.size();
+		return islands.size();
+	}
+
+	FORCEINLINE bool PageHooked(unsigned int address) const
+	{
+		return (pages[address >> (PAGE_SHIFT + 5)] >> ((address >> PAGE_SHIFT) & 31)) & 1;
+	}
+
+	// binary search for the first island that doesn't end before first
+	bool ContainsRange(unsigned int first, unsigned int last) const
+	{
+		size_t lo = 0, hi = islands.size();
+		while(lo < hi)
+		{
+			size_t mid = (lo + hi) >> 1;
+			if(islands[mid].last < first)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo < islands.size() && islands[lo].start <= last;
 	}
 
 	// note: it is illegal to call this if NotEmpty() returns 0
 	FORCEINLINE bool Contains(unsigned int address, int size)
 	{
-		return broad.islands[0].Contains(address,size) &&
-		       mid.Contains(address,size) &&
-			   narrow.Contains(address,size);
+		// accesses are at most a few bytes, so the pages of the first and last byte cover them
+		const unsigned int last = address + size - 1;
+		if(!PageHooked(address) && !PageHooked(last))
+			return false;
+		return ContainsRange(address, last);
 	}
 };
 extern TieredRegion hookedRegions [LUAMEMHOOK_COUNT];
 
+// set whenever the exec hooks change, since the JIT builds them into the blocks it compiles
+extern bool hookedExecRegionsChanged;
+
 void CallRegisteredLuaMemHook_LuaMatch(unsigned int address, int size, unsigned int value, LuaMemHookType hookType);
 
 FORCEINLINE void CallRegisteredLuaMemHook(unsigned int address, int size, unsigned int value, LuaMemHookType hookType)
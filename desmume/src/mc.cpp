@@ -21,6 +21,12 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
+#include <algorithm>
+
+#ifdef HOST_WINDOWS
+#include <windows.h>
+#endif
 
 #include "common.h"
 #include "armcpu.h"
@@ -31,6 +37,7 @@
 #include "NDSSystem.h"
 #include "path.h"
 #include "utils/advanscene.h"
+#include "utils/task.h"
 
 //#define _DONT_SAVE_BACKUP
 //#define _MCLOG
@@ -67,6 +74,45 @@
 #define MCLOG(...)
 #endif
 
+//the save file gets written out after the game hasn't written to it for this many frames,
+//or after this many frames in any case if the game keeps writing
+#define BACKUP_FLUSH_IDLE_FRAMES 30
+#define BACKUP_FLUSH_MAX_FRAMES 600
+
+//the in-memory save file image. it keeps track of which range has changed since the last flush,
+//so that only that part needs to be copied for the flush task.
+class BackupImage : public EMUFILE_MEMORY
+{
+public:
+	BackupImage() : writeCount(0) { clearDirty(); }
+
+	u32 writeCount;
+	s32 dirtyBegin, dirtyEnd;
+
+	bool isDirty() const { return dirtyBegin < dirtyEnd; }
+	void clearDirty() { dirtyBegin = INT_MAX; dirtyEnd = 0; }
+
+	void markDirty(s32 begin, s32 end)
+	{
+		dirtyBegin = std::min(dirtyBegin, begin);
+		dirtyEnd = std::max(dirtyEnd, end);
+		writeCount++;
+	}
+
+	virtual size_t fwrite(const void *ptr, size_t bytes)
+	{
+		//writing past the end also fills the gap up to pos
+		markDirty(std::min(pos, len), pos + (s32)bytes);
+		return EMUFILE_MEMORY::fwrite(ptr, bytes);
+	}
+
+	virtual void truncate(s32 length)
+	{
+		markDirty(std::min(length, len), std::max(length, len));
+		EMUFILE_MEMORY::truncate(length);
+	}
+};
+
 static const char* DESMUME_BACKUP_FOOTER_TXT = "|<--Snip above here to create a raw sav by excluding this DeSmuME savedata footer:";
 static const char* kDesmumeSaveCookie = "|-DESMUME SAVE-|";
 
@@ -216,6 +262,9 @@ BackupDevice::BackupDevice()
 	fsize = 0;
 	addr_size = 0;
 	isMovieMode = false;
+	isBuffered = false;
+	flushTask = NULL;
+	lastWriteCount = idleFrames = dirtyFrames = 0;
 
 	//default for most games; will be altered where appropriate
 	//usually 0xFF, but occasionally others. If these exceptions could be related to a particular backup memory type, that would be helpful.
@@ -328,14 +377,30 @@ BackupDevice::BackupDevice()
 		delete fpTmp;
 	}
 
-	fpMC = new EMUFILE_FILE(filename, fexists?"rb+":"wb+");
-	const bool fileCanReadWrite = (fpMC->get_fp() != NULL);
-	if (!fileCanReadWrite)
+	BackupImage *image = new BackupImage();
+	fpMC = image;
+
+	EMUFILE_FILE *fpFile = new EMUFILE_FILE(filename, fexists?"rb+":"wb+");
+	const bool fileCanReadWrite = (fpFile->get_fp() != NULL);
+	if (fileCanReadWrite)
+	{
+		const u32 sz = fpFile->size();
+		if (sz > 0)
+		{
+			image->truncate(sz);
+			fpFile->fread(image->buf(), sz);
+		}
+
+		//what's on disk now is what the flush task would write
+		flushImage.assign(image->buf(), image->buf() + sz);
+		image->clearDirty();
+		isBuffered = true;
+	}
+	else
 	{
-		delete fpMC;
-		fpMC = new EMUFILE_MEMORY();
 		printf("BackupDevice: WARNING! Failed to get read/write access to the save file! Will operate in RAM instead.\n");
 	}
+	delete fpFile;
 	
 	if (!fpMC->fail())
 	{
@@ -411,10 +476,102 @@ BackupDevice::BackupDevice()
 
 BackupDevice::~BackupDevice()
 {
+	flush(true);
+	delete flushTask;
+	flushTask = NULL;
+
 	delete fpMC;
 	fpMC = NULL;
 }
 
+//copies the changed part of the save file to flushImage and has the flush task write it out.
+//the file is written to a temporary file first and then renamed over the save file, so that
+//there is always a complete save file on disk even if we die in the middle of writing.
+void BackupDevice::flush(bool wait)
+{
+	if (!isBuffered || isMovieMode) return;
+
+	BackupImage *image = (BackupImage *)fpMC;
+	if (image->isDirty())
+	{
+		if (flushTask == NULL)
+		{
+			flushTask = new Task();
+			flushTask->start(false);
+		}
+		else
+			flushTask->finish();
+
+		const s32 len = image->size();
+		const s32 dirtyEnd = std::min(image->dirtyEnd, len);
+		flushImage.resize(len);
+		if (image->dirtyBegin < dirtyEnd)
+			memcpy(&flushImage[image->dirtyBegin], image->buf() + image->dirtyBegin, dirtyEnd - image->dirtyBegin);
+		image->clearDirty();
+
+		flushTask->execute(&BackupDevice::flushProc, this);
+	}
+
+	if (wait && flushTask != NULL)
+		flushTask->finish();
+
+	lastWriteCount = image->writeCount;
+	idleFrames = dirtyFrames = 0;
+}
+
+void* BackupDevice::flushProc(void *arg)
+{
+	BackupDevice *dev = (BackupDevice *)arg;
+	const std::string tmpFilename = dev->filename + ".tmp";
+
+	FILE *fp = fopen(tmpFilename.c_str(), "wb");
+	if (!fp)
+	{
+		printf("BackupDevice: Could not create %s to write the save file.\n", tmpFilename.c_str());
+		return NULL;
+	}
+
+	bool ok = dev->flushImage.empty() || (fwrite(&dev->flushImage[0], 1, dev->flushImage.size(), fp) == dev->flushImage.size());
+	ok = (fclose(fp) == 0) && ok;
+
+	if (ok)
+	{
+#ifdef HOST_WINDOWS
+		ok = (MoveFileExA(tmpFilename.c_str(), dev->filename.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0);
+#else
+		ok = (rename(tmpFilename.c_str(), dev->filename.c_str()) == 0);
+#endif
+	}
+
+	if (!ok)
+	{
+		printf("BackupDevice: Error writing the save file.\n");
+		remove(tmpFilename.c_str());
+	}
+
+	return NULL;
+}
+
+void BackupDevice::autoFlush()
+{
+	if (!isBuffered || isMovieMode) return;
+
+	BackupImage *image = (BackupImage *)fpMC;
+	if (!image->isDirty()) return;
+
+	if (image->writeCount != lastWriteCount)
+	{
+		lastWriteCount = image->writeCount;
+		idleFrames = 0;
+	}
+	else
+		idleFrames++;
+	dirtyFrames++;
+
+	if (idleFrames >= BACKUP_FLUSH_IDLE_FRAMES || dirtyFrames >= BACKUP_FLUSH_MAX_FRAMES)
+		flush(false);
+}
+
 int BackupDevice::readFooter()
 {
 	// Check if the footer data exists.
@@ -572,7 +729,7 @@ void BackupDevice::seek(u32 pos)
 
 void BackupDevice::flushBackup()
 {
-	fpMC->fflush();
+	flush(false);
 }
 
 bool BackupDevice::saveBuffer(u8 *data, u32 size, bool _rewind, bool _truncate)
@@ -591,6 +748,7 @@ bool BackupDevice::saveBuffer(u8 *data, u32 size, bool _rewind, bool _truncate)
 
 void BackupDevice::movie_mode()
 {
+	flush(true);
 	isMovieMode = true;
 	reset();
 }
@@ -641,9 +799,10 @@ void BackupDevice::reset()
 
 void BackupDevice::close_rom()
 {
-	fpMC->fflush();
+	flush(true);
 	delete fpMC;
 	fpMC = NULL;
+	isBuffered = false;
 }
 
 //todo - this function is horrible. it's only needed due to our big disorganization between save types and sizes.
@@ -721,9 +880,6 @@ void BackupDevice::checkReset()
 	{
 		//printf("MC  : reset command\n");
 
-		if(com == BM_CMD_WRITELOW || com == BM_CMD_WRITEHIGH)
-			fpMC->fflush();
-		
 		com = 0;
 		reset_command_state = false;
 	}
@@ -49,6 +49,7 @@
 #define MC_SIZE_512MBITS                0x4000000
 
 class EMUFILE;
+class Task;
 
 //This "backup device" represents a typical retail NDS save memory accessible via AUXSPI.
 //It is managed as a core emulator service for historical reasons which are bad,
@@ -87,6 +88,9 @@ public:
 	void seek(u32 pos);
 
 	void flushBackup();
+
+	//called once per frame. writes the save file out once the game has stopped writing to it for a while
+	void autoFlush();
 	
 	u8 searchFileSaveType(u32 size);
 
@@ -147,6 +151,15 @@ private:
 	EMUFILE *fpMC;
 	std::string filename;
 	u32	fsize;
+
+	//the save file is edited in memory (fpMC) and written to disk by a background task.
+	//flushImage is the copy that the task writes out, so that fpMC can keep changing meanwhile
+	bool isBuffered;
+	Task *flushTask;
+	std::vector<u8> flushImage;
+	u32 lastWriteCount, idleFrames, dirtyFrames;
+	void flush(bool wait);
+	static void* flushProc(void *arg);
 	int readFooter();
 	bool write(u8 val);
 	u8	read();
@@ -336,9 +336,15 @@ protected:
 	
 public:
 	bool _debug_thisPoly;
-	int SLI_MASK;
+	int SLI_SHIFT;
+	int SLI_COUNT;
 	int SLI_VALUE;
 	
+	// Indices of the clipped polygons that touch at least one of this unit's tile rows,
+	// in submission order. Filled in by SoftRasterizerRenderer::performPolygonBinning().
+	u16 *binnedPolyList;
+	size_t binnedPolyCount;
+	
 	void SetRenderer(SoftRasterizerRenderer *theRenderer)
 	{
 		this->_softRender = theRenderer;
@@ -776,6 +782,98 @@ public:
 			width = framebufferWidth - x;
 		}
 		
+#ifdef ENABLE_SSE2
+		// Run the perspective divide and the depth test on groups of 4 fragments at once,
+		// and only shade the fragments that pass. Each lane still accumulates its step the
+		// same way that the scalar loop does, so that every fragment sees exactly the same
+		// interpolant values.
+		//
+		// Shadow polygons and the depth-equal test have side effects on a failed depth test
+		// (or a tolerance window), so those always take the per-fragment path.
+		if (!ISSHADOWPOLYGON && !polyAttr.enableDepthEqualTest)
+		{
+			const u32 *dstDepth = this->_softRender->_framebufferAttributes->depth;
+			const bool useWBuffer = gfx3d.renderState.wbuffer;
+			const __m128i signBit = _mm_set1_epi32(0x80000000);
+			
+			const __m128 dInterp = _mm_setr_ps(dinvw_dx, du_dx, dv_dx, dz_dx);
+			const __m128 dColor = _mm_setr_ps(dc_dx[0], dc_dx[1], dc_dx[2], 0.0f);
+			__m128 interp = _mm_setr_ps(invw, u, v, z);
+			__m128 rgb = _mm_setr_ps(color[0], color[1], color[2], 0.0f);
+			
+			CACHE_ALIGN float lane[7][4];
+			CACHE_ALIGN u32 tailDepth[4];
+			
+			while (width > 0)
+			{
+				// Step each fragment's {invw, u, v, z} and {r, g, b} in turn, then transpose so that
+				// each vector holds one interpolant for all 4 fragments.
+				__m128 i0 = interp;
+				__m128 i1 = interp = _mm_add_ps(interp, dInterp);
+				__m128 i2 = interp = _mm_add_ps(interp, dInterp);
+				__m128 i3 = interp = _mm_add_ps(interp, dInterp);
+				interp = _mm_add_ps(interp, dInterp);
+				
+				__m128 c0 = rgb;
+				__m128 c1 = rgb = _mm_add_ps(rgb, dColor);
+				__m128 c2 = rgb = _mm_add_ps(rgb, dColor);
+				__m128 c3 = rgb = _mm_add_ps(rgb, dColor);
+				rgb = _mm_add_ps(rgb, dColor);
+				
+				_MM_TRANSPOSE4_PS(i0, i1, i2, i3);
+				_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+				
+				const __m128 w_vec128 = _mm_div_ps(_mm_set1_ps(1.0f), i0);
+				const __m128i newDepth_vec128 = (useWBuffer) ? _mm_cvttps_epi32(_mm_mul_ps(w_vec128, _mm_set1_ps(4096.0f))) :
+				                                               _mm_slli_epi32(_mm_cvttps_epi32(_mm_mul_ps(i3, _mm_set1_ps((float)0x7FFF))), 9);
+				
+				// Don't read past the end of the depth buffer on the last group of a span.
+				const size_t count = (width < 4) ? width : 4;
+				__m128i dstDepth_vec128;
+				if (count == 4)
+				{
+					dstDepth_vec128 = _mm_loadu_si128((__m128i *)(dstDepth + adr));
+				}
+				else
+				{
+					for (size_t i = 0; i < count; i++)
+					{
+						tailDepth[i] = dstDepth[adr + i];
+					}
+					dstDepth_vec128 = _mm_load_si128((__m128i *)tailDepth);
+				}
+				
+				// The depth values are unsigned, so flip the sign bits before the signed compare.
+				int passBits = _mm_movemask_ps( _mm_castsi128_ps(_mm_cmpgt_epi32(_mm_xor_si128(dstDepth_vec128, signBit), _mm_xor_si128(newDepth_vec128, signBit))) );
+				passBits &= (1 << count) - 1;
+				
+				if (passBits != 0)
+				{
+					_mm_store_ps(lane[0], c0);
+					_mm_store_ps(lane[1], c1);
+					_mm_store_ps(lane[2], c2);
+					_mm_store_ps(lane[3], i1);
+					_mm_store_ps(lane[4], i2);
+					_mm_store_ps(lane[5], w_vec128);
+					_mm_store_ps(lane[6], i3);
+					
+					for (size_t i = 0; i < count; i++)
+					{
+						if (passBits & (1 << i))
+						{
+							pixel<ISSHADOWPOLYGON>(polyAttr, adr + i, dstColor[adr + i], lane[0][i], lane[1][i], lane[2][i], lane[3][i], lane[4][i], lane[5][i], lane[6][i]);
+						}
+					}
+				}
+				
+				adr += count;
+				width -= count;
+			}
+			
+			return;
+		}
+#endif
+		
 		while (width-- > 0)
 		{
 			pixel<ISSHADOWPOLYGON>(polyAttr, adr, dstColor[adr], color[0], color[1], color[2], u, v, 1.0f/invw, z);
@@ -805,13 +903,13 @@ public:
 		//HACK: special handling for horizontal line poly
 		if (lineHack && left->Height == 0 && right->Height == 0 && left->Y<framebufferHeight && left->Y>=0)
 		{
-			bool draw = (!SLI || (left->Y & SLI_MASK) == SLI_VALUE);
+			bool draw = (!SLI || ((left->Y >> SLI_SHIFT) % SLI_COUNT) == SLI_VALUE);
 			if(draw) drawscanline<ISSHADOWPOLYGON>(polyAttr, dstColor, framebufferWidth, framebufferHeight, left,right,lineHack);
 		}
 
 		while(Height--)
 		{
-			bool draw = (!SLI || (left->Y & SLI_MASK) == SLI_VALUE);
+			bool draw = (!SLI || ((left->Y >> SLI_SHIFT) % SLI_COUNT) == SLI_VALUE);
 			if(draw) drawscanline<ISSHADOWPOLYGON>(polyAttr, dstColor, framebufferWidth, framebufferHeight, left,right,lineHack);
 			const int xl = left->X;
 			const int xr = right->X;
@@ -995,7 +1093,8 @@ public:
 	template<bool SLI>
 	FORCEINLINE void mainLoop()
 	{
-		const size_t polyCount = this->_softRender->_clippedPolyCount;
+		// When rendering multithreaded, only walk the polygons that were binned to this unit.
+		const size_t polyCount = (SLI) ? this->binnedPolyCount : this->_softRender->_clippedPolyCount;
 		if (polyCount == 0)
 		{
 			return;
@@ -1016,8 +1115,9 @@ public:
 		sampler.setup(lastTexKey, firstPoly.texParam);
 
 		//iterate over polys
-		for (size_t i = 0; i < polyCount; i++)
+		for (size_t n = 0; n < polyCount; n++)
 		{
+			const size_t i = (SLI) ? this->binnedPolyList[n] : n;
 			if (!RENDERER) _debug_thisPoly = (i == this->_softRender->_debug_drawClippedUserPoly);
 			if (!this->_softRender->polyVisible[i]) continue;
 			polynum = i;
@@ -1063,6 +1163,11 @@ public:
 }; //rasterizerUnit
 
 #define _MAX_CORES 16
+
+// When multithreaded, the framebuffer is split into full-width tile rows that are dealt
+// out to the rasterizer units round-robin. This is the tile row height in native lines.
+#define RASTERIZER_TILE_HEIGHT 8
+
 static Task rasterizerUnitTask[_MAX_CORES];
 static RasterizerUnit<true> rasterizerUnit[_MAX_CORES];
 static RasterizerUnit<false> _HACK_viewer_rasterizerUnit;
@@ -1112,12 +1217,30 @@ static void* SoftRasterizer_RunClearFramebuffer(void *arg)
 	return NULL;
 }
 
-static void* SoftRasterizer_RunRenderEdgeMarkAndFog(void *arg)
+static void SoftRasterizer_RunRenderEdgeMarkAndFog(void *arg, size_t index)
 {
 	SoftRasterizerPostProcessParams *params = (SoftRasterizerPostProcessParams *)arg;
-	params->renderer->RenderEdgeMarkingAndFog(*params);
+	params[index].renderer->RenderEdgeMarkingAndFog(params[index]);
+}
+
+static void SoftRasterizer_SetupTileRows(const size_t framebufferHeight)
+{
+	// Scale the tile row height with the framebuffer so that custom resolutions bin
+	// polygons the same way as the native resolution does.
+	const size_t tileLines = (RASTERIZER_TILE_HEIGHT * framebufferHeight) / GPU_FRAMEBUFFER_NATIVE_HEIGHT;
+	int tileShift = 0;
 	
-	return NULL;
+	while ( ((size_t)2 << tileShift) <= tileLines )
+	{
+		tileShift++;
+	}
+	
+	for (size_t i = 0; i < rasterizerCores; i++)
+	{
+		rasterizerUnit[i].SLI_SHIFT = tileShift;
+		rasterizerUnit[i].SLI_COUNT = (int)rasterizerCores;
+		rasterizerUnit[i].SLI_VALUE = (int)i;
+	}
 }
 
 void _HACK_Viewer_ExecUnit()
@@ -1229,8 +1352,11 @@ SoftRasterizerRenderer::SoftRasterizerRenderer()
 	if (!rasterizerUnitTasksInited)
 	{
 		_HACK_viewer_rasterizerUnit._debug_thisPoly = false;
-		_HACK_viewer_rasterizerUnit.SLI_MASK = 1;
+		_HACK_viewer_rasterizerUnit.SLI_SHIFT = 0;
+		_HACK_viewer_rasterizerUnit.SLI_COUNT = 1;
 		_HACK_viewer_rasterizerUnit.SLI_VALUE = 0;
+		_HACK_viewer_rasterizerUnit.binnedPolyList = NULL;
+		_HACK_viewer_rasterizerUnit.binnedPolyCount = 0;
 		
 		rasterizerCores = CommonSettings.num_cores;
 		
@@ -1241,8 +1367,11 @@ SoftRasterizerRenderer::SoftRasterizerRenderer()
 		{
 			rasterizerCores = 1;
 			rasterizerUnit[0]._debug_thisPoly = false;
-			rasterizerUnit[0].SLI_MASK = 0;
+			rasterizerUnit[0].SLI_SHIFT = 0;
+			rasterizerUnit[0].SLI_COUNT = 1;
 			rasterizerUnit[0].SLI_VALUE = 0;
+			rasterizerUnit[0].binnedPolyList = NULL;
+			rasterizerUnit[0].binnedPolyCount = 0;
 			
 			postprocessParam = new SoftRasterizerPostProcessParams[rasterizerCores];
 			postprocessParam[0].renderer = this;
@@ -1261,8 +1390,8 @@ SoftRasterizerRenderer::SoftRasterizerRenderer()
 			for (size_t i = 0; i < rasterizerCores; i++)
 			{
 				rasterizerUnit[i]._debug_thisPoly = false;
-				rasterizerUnit[i].SLI_MASK = (rasterizerCores - 1);
-				rasterizerUnit[i].SLI_VALUE = i;
+				rasterizerUnit[i].binnedPolyList = new u16[POLYLIST_SIZE*2];
+				rasterizerUnit[i].binnedPolyCount = 0;
 				rasterizerUnitTask[i].start(false);
 				
 				postprocessParam[i].renderer = this;
@@ -1273,6 +1402,8 @@ SoftRasterizerRenderer::SoftRasterizerRenderer()
 				postprocessParam[i].fogColor = 0x80FFFFFF;
 				postprocessParam[i].fogAlphaOnly = false;
 			}
+			
+			SoftRasterizer_SetupTileRows(_framebufferHeight);
 		}
 		
 		rasterizerUnitTasksInited = true;
@@ -1292,6 +1423,10 @@ SoftRasterizerRenderer::~SoftRasterizerRenderer()
 		{
 			rasterizerUnitTask[i].finish();
 			rasterizerUnitTask[i].shutdown();
+			
+			delete[] rasterizerUnit[i].binnedPolyList;
+			rasterizerUnit[i].binnedPolyList = NULL;
+			rasterizerUnit[i].binnedPolyCount = 0;
 		}
 	}
 	
@@ -1417,6 +1552,65 @@ void SoftRasterizerRenderer::performCoordAdjustment()
 	}
 }
 
+void SoftRasterizerRenderer::performPolygonBinning()
+{
+	const size_t framebufferHeight = this->_framebufferHeight;
+	const int tileShift = rasterizerUnit[0].SLI_SHIFT;
+	
+	for (size_t u = 0; u < rasterizerCores; u++)
+	{
+		rasterizerUnit[u].binnedPolyCount = 0;
+	}
+	
+	for (size_t i = 0; i < this->_clippedPolyCount; i++)
+	{
+		if (!this->polyVisible[i])
+		{
+			continue;
+		}
+		
+		const GFX3D_Clipper::TClippedPoly &clippedPoly = clippedPolys[i];
+		const PolygonType type = clippedPoly.type;
+		const VERT *verts = &clippedPoly.clipVerts[0];
+		
+		// The vertex coordinates are already in 28.4 fixed point at this point. The shape
+		// engine draws the scanlines from Ceil28_4(top) up to and including Ceil28_4(bottom)
+		// (for the horizontal line hack), so use the same bounds here.
+		fixed28_4 yMin = (fixed28_4)verts[0].y;
+		fixed28_4 yMax = (fixed28_4)verts[0].y;
+		for (size_t j = 1; j < type; j++)
+		{
+			yMin = min(yMin, (fixed28_4)verts[j].y);
+			yMax = max(yMax, (fixed28_4)verts[j].y);
+		}
+		
+		size_t lineTop = (size_t)max(0, Ceil28_4(yMin));
+		size_t lineBottom = (size_t)max(0, Ceil28_4(yMax));
+		if (lineTop >= framebufferHeight) lineTop = framebufferHeight - 1;
+		if (lineBottom >= framebufferHeight) lineBottom = framebufferHeight - 1;
+		
+		const size_t rowTop = lineTop >> tileShift;
+		const size_t rowBottom = lineBottom >> tileShift;
+		
+		if ((rowBottom - rowTop + 1) >= rasterizerCores)
+		{
+			for (size_t u = 0; u < rasterizerCores; u++)
+			{
+				rasterizerUnit[u].binnedPolyList[rasterizerUnit[u].binnedPolyCount++] = (u16)i;
+			}
+		}
+		else
+		{
+			// Spans fewer rows than there are units, so each row maps to a distinct unit.
+			for (size_t row = rowTop; row <= rowBottom; row++)
+			{
+				RasterizerUnit<true> &unit = rasterizerUnit[row % rasterizerCores];
+				unit.binnedPolyList[unit.binnedPolyCount++] = (u16)i;
+			}
+		}
+	}
+}
+
 void SoftRasterizerRenderer::setupTextures()
 {
 	if (this->_clippedPolyCount == 0)
@@ -1603,6 +1797,8 @@ Render3DError SoftRasterizerRenderer::RenderGeometry(const GFX3D_State &renderSt
 	// Render the geometry
 	if (rasterizerCores > 1)
 	{
+		this->performPolygonBinning();
+		
 		for (size_t i = 0; i < rasterizerCores; i++)
 		{
 			rasterizerUnitTask[i].execute(&execRasterizerUnit, (void *)i);
@@ -2035,15 +2231,9 @@ Render3DError SoftRasterizerRenderer::RenderFinish()
 			this->postprocessParam[i].enableFog = this->currentRenderState->enableFog;
 			this->postprocessParam[i].fogColor = this->currentRenderState->fogColor;
 			this->postprocessParam[i].fogAlphaOnly = this->currentRenderState->enableFogAlphaOnly;
-			
-			rasterizerUnitTask[i].execute(&SoftRasterizer_RunRenderEdgeMarkAndFog, &this->postprocessParam[i]);
 		}
 		
-		// Allow for post-processing to finish.
-		for (size_t i = 0; i < rasterizerCores; i++)
-		{
-			rasterizerUnitTask[i].finish();
-		}
+		TaskPool::parallelFor(rasterizerCores, &SoftRasterizer_RunRenderEdgeMarkAndFog, this->postprocessParam);
 	}
 	
 	FragmentColor *framebufferMain = (this->_outputFormat == NDSColorFormat_BGR888_Rev) ? GPU->GetEngineMain()->Get3DFramebufferRGBA6665() : NULL;
@@ -2078,6 +2268,8 @@ Render3DError SoftRasterizerRenderer::SetFramebufferSize(size_t w, size_t h)
 			postprocessParam[i].startLine = i * linesPerThread;
 			postprocessParam[i].endLine = (i < rasterizerCores - 1) ? (i + 1) * linesPerThread : h;
 		}
+		
+		SoftRasterizer_SetupTileRows(h);
 	}
 		
 	return RENDER3DERROR_NOERR;
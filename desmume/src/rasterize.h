@@ -110,6 +110,7 @@ public:
 	template<bool CUSTOM> void performViewportTransforms();
 	void performBackfaceTests();
 	void performCoordAdjustment();
+	void performPolygonBinning();
 	void setupTextures();
 	Render3DError UpdateEdgeMarkColorTable(const u16 *edgeMarkColorTable);
 	Render3DError UpdateFogTable(const u8 *fogDensityTable);
@@ -21,7 +21,7 @@
 #ifdef HAVE_LIBZ
 #include <zlib.h>
 #endif
-#include <stack>
+#include <deque>
 #include <set>
 #include <stdio.h>
 #include <string.h>
@@ -1169,6 +1169,10 @@ static void loadstate()
     for (int i = 0; i < 0xA; i++)
        _MMU_write08<ARMCPU_ARM9>(0x04000240+i, _MMU_read08<ARMCPU_ARM9>(0x04000240+i));
 
+    // VRAM and main memory contents came straight from the savestate, so nothing copied out of them before can be trusted
+    MMU_VRAMmarkAllDirty();
+    MMU_mainMemMarkAllDirty();
+
     // This should regenerate the graphics power control register
     _MMU_write16<ARMCPU_ARM9>(0x04000304, _MMU_read16<ARMCPU_ARM9>(0x04000304));
 
@@ -1282,11 +1286,78 @@ bool savestate_load(const char *file_name)
 	return savestate_load(&f);
 }
 
-static std::stack<EMUFILE_MEMORY*> rewindFreeList;
-static std::vector<EMUFILE_MEMORY*> rewindbuffer;
+//The rewind buffer keeps the newest state in full, and every state before it as the XOR
+//of itself with the state after it. Consecutive states differ in very little, so these
+//deltas are almost entirely zeroes, and they're stored as runs of unchanged and changed
+//words. Rewinding applies the newest delta to the current state in place, and trimming
+//the buffer just drops the oldest delta.
+struct RewindDelta
+{
+	u32 size; //size of the state that this delta reconstructs
+	std::vector<u32> data;
+};
+
+static std::deque<RewindDelta*> rewindbuffer;
+static size_t rewindbufferBytes = 0;
+static std::vector<u8> rewindCurrent;
+static u32 rewindCurrentSize = 0;
+static EMUFILE_MEMORY rewindScratch;
+static std::vector<u32> rewindEncodeBuffer;
+
+int rewindstates = 15*60*5; //five minutes of rewind at one state every 4th frame, if it fits
+int rewindinterval = 4; //front ends may lower this; a state every frame costs a full savestate per frame
+int rewindbuffersize = 256; //in megabytes, not counting the current state
 
-int rewindstates = 16;
-int rewindinterval = 4;
+//zero-fills a state buffer from the end of the state up to the padded size used for a delta
+static void rewind_pad(std::vector<u8> &buf, const size_t size, const size_t paddedSize)
+{
+	if (buf.size() < paddedSize)
+		buf.resize(paddedSize);
+	memset(&buf[0] + size, 0, paddedSize - size);
+}
+
+//encodes older^newer as a list of [unchanged word count][changed word count][changed words...]
+static void rewind_encode(std::vector<u32> &out, const u32 *older, const u32 *newer, const size_t numWords)
+{
+	out.clear();
+
+	size_t i = 0;
+	while (i < numWords)
+	{
+		const size_t sameStart = i;
+		while (i < numWords && older[i] == newer[i])
+			i++;
+
+		//don't break a run of changed words for a single unchanged one, since the two count words
+		//that would take cost more than the one word that they'd save
+		const size_t diffStart = i;
+		while (i < numWords && (older[i] != newer[i] || (i+1 < numWords && older[i+1] != newer[i+1])))
+			i++;
+
+		out.push_back((u32)(diffStart - sameStart));
+		out.push_back((u32)(i - diffStart));
+		for (size_t j = diffStart; j < i; j++)
+			out.push_back(older[j] ^ newer[j]);
+	}
+}
+
+static void rewind_apply(u32 *buf, const std::vector<u32> &delta)
+{
+	size_t pos = 0;
+	size_t i = 0;
+	while (i < delta.size())
+	{
+		pos += delta[i++];
+		const size_t count = delta[i++];
+		for (size_t j = 0; j < count; j++)
+			buf[pos++] ^= delta[i++];
+	}
+}
+
+static size_t rewind_deltaBytes(const RewindDelta *delta)
+{
+	return sizeof(RewindDelta) + delta->data.size() * sizeof(u32);
+}
 
 void rewindsave () {
 
@@ -1295,23 +1366,40 @@ void rewindsave () {
 
 	//printf("rewindsave"); printf("%d%s", currFrameCounter, "\n");
 
-	
-	EMUFILE_MEMORY *ms;
-	if(!rewindFreeList.empty()) {
-		ms = rewindFreeList.top();
-		rewindFreeList.pop();
-	} else {
-		ms = new EMUFILE_MEMORY(1024*1024*12);
+	rewindScratch.truncate(0);
+	rewindScratch.fseek(0, SEEK_SET);
+	if(!savestate_save(&rewindScratch, Z_NO_COMPRESSION))
+		return;
+
+	const u32 newSize = rewindScratch.size();
+	std::vector<u8> &newState = *rewindScratch.get_vec();
+
+	if (rewindCurrentSize != 0)
+	{
+		const size_t numWords = (std::max<u32>(newSize, rewindCurrentSize) + 3) / 4;
+		rewind_pad(rewindCurrent, rewindCurrentSize, numWords * 4);
+		rewind_pad(newState, newSize, numWords * 4);
+
+		rewind_encode(rewindEncodeBuffer, (u32 *)&rewindCurrent[0], (u32 *)&newState[0], numWords);
+
+		RewindDelta *delta = new RewindDelta();
+		delta->size = rewindCurrentSize;
+		delta->data = rewindEncodeBuffer;
+		rewindbuffer.push_back(delta);
+		rewindbufferBytes += rewind_deltaBytes(delta);
 	}
 
-	if(!savestate_save(ms, Z_NO_COMPRESSION))
-		return;
+	//the new state becomes the current one, and the old current buffer gets reused for the next save
+	rewindCurrent.swap(newState);
+	rewindCurrentSize = newSize;
 
-	rewindbuffer.push_back(ms);
-	
-	if((int)rewindbuffer.size() > rewindstates) {
-		delete *rewindbuffer.begin();
-		rewindbuffer.erase(rewindbuffer.begin());
+	const size_t maxBytes = (size_t)rewindbuffersize * 1024 * 1024;
+	while (!rewindbuffer.empty() && ((int)rewindbuffer.size() >= rewindstates || rewindbufferBytes > maxBytes))
+	{
+		RewindDelta *oldest = rewindbuffer.front();
+		rewindbufferBytes -= rewind_deltaBytes(oldest);
+		delete oldest;
+		rewindbuffer.pop_front();
 	}
 }
 
@@ -1322,25 +1410,30 @@ void dorewind()
 
 	//printf("rewind\n");
 
-	int size = rewindbuffer.size();
-
-	if(size < 1) {
+	if(rewindCurrentSize == 0) {
 		printf("rewind buffer empty\n");
 		return;
 	}
 
-	printf("%d", size);
+	EMUFILE_MEMORY loadms(&rewindCurrent);
+	loadms.fseek(32, SEEK_SET);
 
-	EMUFILE_MEMORY* loadms = rewindbuffer[size-1];
-	loadms->fseek(32, SEEK_SET);
-
-	ReadStateChunks(loadms,loadms->size()-32);
+	ReadStateChunks(&loadms,rewindCurrentSize-32);
 	loadstate();
 
-	if(rewindbuffer.size()>1)
+	//step back to the state before this one, so that it's ready for the next rewind.
+	//the oldest state stays put, so that holding rewind keeps returning to it.
+	if(!rewindbuffer.empty())
 	{
-		rewindFreeList.push(loadms);
+		RewindDelta *delta = rewindbuffer.back();
+		const size_t numWords = (std::max<u32>(delta->size, rewindCurrentSize) + 3) / 4;
+		rewind_pad(rewindCurrent, rewindCurrentSize, numWords * 4);
+
+		rewind_apply((u32 *)&rewindCurrent[0], delta->data);
+		rewindCurrentSize = delta->size;
+
+		rewindbufferBytes -= rewind_deltaBytes(delta);
+		delete delta;
 		rewindbuffer.pop_back();
 	}
-
 }
@@ -69,4 +69,8 @@ bool savestate_save(class EMUFILE* outstream, int compressionLevel);
 void dorewind();
 void rewindsave();
 
+extern int rewindstates;
+extern int rewindinterval;
+extern int rewindbuffersize;
+
 #endif
@@ -63,6 +63,7 @@ public:
 		u32 len;
 		u8* ptr;
 		u32 ofs; //offset within the memspan
+		u32 slot; //the texture or texture palette slot that this item was mapped from
 	} items[MAXSIZE];
 
 	int size;
@@ -85,6 +86,19 @@ public:
 		return 0;
 	}
 
+	//checks whether any of the VRAM that this memspan covers was written to, or whether any of its
+	//slots were remapped, since the given VRAM write stamp was taken
+	bool changedSince(const u64 stamp, const u64 *slotStamps) const
+	{
+		for(int i=0;i<numItems;i++)
+		{
+			const Item &item = items[i];
+			if(slotStamps[item.slot] >= stamp) return true;
+			if(MMU_VRAMchangedSince(item.ptr, item.len, stamp)) return true;
+		}
+		return false;
+	}
+
 	//TODO - get rid of duplication between these two methods.
 
 	//dumps the memspan to the specified buffer
@@ -149,6 +163,7 @@ static MemSpan MemSpan_TexMem(u32 ofs, u32 len)
 		u32 slot = (ofs>>17)&3; //slots will wrap around
 		curr.len = min(len,0x20000-curr.start);
 		curr.ofs = currofs;
+		curr.slot = slot;
 		len -= curr.len;
 		ofs += curr.len;
 		currofs += curr.len;
@@ -179,6 +194,7 @@ static MemSpan MemSpan_TexPalette(u32 ofs, u32 len, bool silent)
 		}
 		curr.len = min(len,0x4000-curr.start);
 		curr.ofs = currofs;
+		curr.slot = slot;
 		len -= curr.len;
 		ofs += curr.len;
 		//if(len != 0) 
@@ -392,6 +408,7 @@ TextureStore::TextureStore()
 	_suspectedInvalid = false;
 	_assumedInvalid = false;
 	_isLoadNeeded = false;
+	_vramStamp = 0;
 	
 	_cacheSize = 0;
 	_cacheAge = 0;
@@ -409,6 +426,7 @@ TextureStore::TextureStore(const u32 texAttributes, const u32 palAttributes)
 	_textureAttributes = texAttributes;
 	_paletteAttributes = palAttributes;
 	_cacheKey = TextureCache::GenerateKey(texAttributes, palAttributes);
+	_vramStamp = MMU_VRAMnewStamp();
 	
 	_sizeS = (8 << ((texAttributes >> 20) & 0x07));
 	_sizeT = (8 << ((texAttributes >> 23) & 0x07));
@@ -744,6 +762,7 @@ void TextureStore::Update()
 	
 	this->SetTextureData(currentPackedTexDataMS, currentPackedTexIndexMS);
 	this->SetTexturePalette(currentPaletteMS);
+	this->_vramStamp = MMU_VRAMnewStamp();
 	
 	this->_assumedInvalid = false;
 	this->_suspectedInvalid = false;
@@ -755,11 +774,30 @@ void TextureStore::VRAMCompareAndUpdate()
 	bool needUpdateTexData = false;
 	bool needUpdatePalette = false;
 	
+	MemSpan currentPaletteMS = MemSpan_TexPalette(this->_paletteAddress, this->_paletteSize, false);
+	MemSpan currentPackedTexDataMS = MemSpan_TexMem(this->_packAddress, this->_packSize);
+	MemSpan currentPackedTexIndexMS;
+	if (this->_packFormat == TEXMODE_4X4)
+	{
+		//determine the location for 4x4 index data
+		currentPackedTexIndexMS = MemSpan_TexMem(this->_packIndexAddress, this->_packIndexSize);
+	}
+	
+	//if nothing that this texture was copied from has been written to or remapped since we last
+	//checked it, then our copy is still good and there's no need to compare it against VRAM
+	if ( !currentPaletteMS.changedSince(this->_vramStamp, vram_texpalslot_stamp) &&
+	     !currentPackedTexDataMS.changedSince(this->_vramStamp, vram_texslot_stamp) &&
+	     !currentPackedTexIndexMS.changedSince(this->_vramStamp, vram_texslot_stamp) )
+	{
+		this->_suspectedInvalid = false;
+		return;
+	}
+	
+	this->_vramStamp = MMU_VRAMnewStamp();
+	
 	//dump the palette to a temp buffer, so that we don't have to worry about memory mapping.
 	//this isnt such a problem with texture memory, because we read sequentially from it.
 	//however, we read randomly from palette memory, so the mapping is more costly.
-	MemSpan currentPaletteMS = MemSpan_TexPalette(this->_paletteAddress, this->_paletteSize, false);
-	
 	CACHE_ALIGN u16 currentPalette[256];
 #ifdef WORDS_BIGENDIAN
 	currentPaletteMS.dump16(currentPalette);
@@ -776,9 +814,6 @@ void TextureStore::VRAMCompareAndUpdate()
 		needUpdatePalette = true;
 	}
 	
-	//analyze the texture memory mapping and the specifications of this texture
-	MemSpan currentPackedTexDataMS = MemSpan_TexMem(this->_packAddress, this->_packSize);
-	
 	//when the texture data doesn't match
 	if ( (this->_packSize > 0) && currentPackedTexDataMS.memcmp(this->_packData, this->_packSize) )
 	{
@@ -786,12 +821,8 @@ void TextureStore::VRAMCompareAndUpdate()
 	}
 	
 	//if the texture is 4x4 then the index data must match
-	MemSpan currentPackedTexIndexMS;
 	if (this->GetPackFormat() == TEXMODE_4X4)
 	{
-		//determine the location for 4x4 index data
-		currentPackedTexIndexMS = MemSpan_TexMem(this->_packIndexAddress, this->_packIndexSize);
-		
 		if ( (this->_packIndexSize > 0) && currentPackedTexIndexMS.memcmp(this->_packIndexData, this->_packIndexSize) )
 		{
 			needUpdateTexData = true;
@@ -111,6 +111,7 @@ protected:
 	bool _suspectedInvalid;
 	bool _assumedInvalid;
 	bool _isLoadNeeded;
+	u64 _vramStamp; // The VRAM write stamp taken when the pack data was last read from VRAM
 	
 	TextureCacheKey _cacheKey;
 	size_t _cacheSize;
@@ -85,11 +85,41 @@
 		#define ENABLE_AVX2
 	#endif
 
+	#ifdef __AVX512F__
+		#define ENABLE_AVX512_0
+	#endif
+
+	#ifdef __AVX512BW__
+		#define ENABLE_AVX512_1
+	#endif
+
 	#ifdef __ALTIVEC__
 		#define ENABLE_ALTIVEC
 	#endif
 #endif
 
+// GCC and Clang can build single functions for a wider instruction set than the
+// rest of the program. This lets an SSE2 build carry the AVX2 and AVX-512 paths
+// and choose between them at runtime, depending on what the host CPU supports.
+// Other compilers only get the wider paths when the whole build targets them.
+#if defined(ENABLE_SSE2) && (defined(__clang__) || (__GNUC__ >= 5))
+	#define ENABLE_AVX2_DISPATCH
+	#define ENABLE_AVX512_DISPATCH
+	#define FUNCTARGET_AVX2 __attribute__((target("avx2")))
+	#define FUNCTARGET_AVX512 __attribute__((target("avx2,avx512f,avx512bw")))
+#else
+	#ifdef ENABLE_AVX2
+		#define ENABLE_AVX2_DISPATCH
+	#endif
+
+	#ifdef ENABLE_AVX512_1
+		#define ENABLE_AVX512_DISPATCH
+	#endif
+
+	#define FUNCTARGET_AVX2
+	#define FUNCTARGET_AVX512
+#endif
+
 #ifdef _MSC_VER 
 	#include <compat/msvc.h>
 
@@ -267,6 +297,20 @@ typedef __m256i v256u32;
 typedef __m256i v256s32;
 #endif
 
+#ifdef ENABLE_AVX512_0
+#include <immintrin.h>
+typedef __m512i v512u8;
+typedef __m512i v512s8;
+typedef __m512i v512u16;
+typedef __m512i v512s16;
+typedef __m512i v512u32;
+typedef __m512i v512s32;
+#endif
+
+#if defined(ENABLE_AVX2_DISPATCH) || defined(ENABLE_AVX512_DISPATCH)
+#include <immintrin.h>
+#endif
+
 /*---------- GPU3D fixed-points types -----------*/
 
 typedef s32 f32;
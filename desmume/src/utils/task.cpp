@@ -16,6 +16,9 @@
 */
 
 #include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <vector>
 
 #include "types.h"
 #include "task.h"
@@ -26,6 +29,7 @@
 #else
 	#if defined HOST_LINUX
 		#include <unistd.h>
+		#include <sched.h>
 	#elif defined HOST_BSD || defined HOST_DARWIN
 		#include <sys/sysctl.h>
 	#endif
@@ -51,88 +55,450 @@ int getOnlineCores (void)
 #endif
 }
 
-class Task::Impl {
-private:
-	sthread_t* _thread;
-	bool _isThreadRunning;
-	
+
+//sets the cores the calling thread may run on. there's no way to do this on the other hosts
+//(darwin only takes affinity hints), so the mask is ignored there.
+static void setThreadAffinity(u64 affinity)
+{
+#ifdef HOST_WINDOWS
+	SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)affinity);
+#elif defined HOST_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	for (int i = 0; i < 64 && i < CPU_SETSIZE; i++)
+		if (affinity & (1ULL << i))
+			CPU_SET(i, &set);
+	sched_setaffinity(0, sizeof(set), &set);
+#else
+	(void)affinity;
+#endif
+}
+
+//how long a waiting thread polls before going to sleep, when spinning is on
+#define TASK_SPIN_COUNT 20000
+
+struct TaskJob
+{
+	Task::TWork work;
+	void *param;
+	void *ret;
+	volatile bool done;
+	size_t queue; //the pool thread whose queue it was put on
+};
+
+class TaskPoolImpl
+{
 public:
-	Impl();
-	~Impl();
+	TaskPoolImpl();
 
-	void start(bool spinlock);
-	void execute(const TWork &work, void *param);
-	void* finish();
+	void configure(int threads, bool spin, u64 affinity);
 	void shutdown();
 
-	slock_t *mutex;
-	scond_t *condWork;
-	TWork workFunc;
-	void *workFuncParam;
-	void *ret;
-	bool exitThread;
+	//queues the job, on the calling thread's own queue if it's a pool thread
+	void submit(TaskJob *job);
+
+	//waits for the job to complete, running it here if it hasn't been picked up yet
+	void* join(TaskJob *job, bool spin);
+
+private:
+	struct Worker
+	{
+		TaskPoolImpl *pool;
+		size_t index;
+		sthread_t *thread;
+		slock_t *lock;
+		std::deque<TaskJob*> jobs;
+	};
+
+	static const size_t NONE = (size_t)-1;
+
+	void start();
+	size_t self();
+	TaskJob* take(size_t index);
+	bool reclaim(TaskJob *job);
+	bool anyQueued();
+	void run(TaskJob *job);
+	void waitDone(TaskJob *job, bool spin);
+	static void workerProc(void *arg);
+
+	std::vector<Worker*> workers;
+	slock_t *lock; //guards starting and stopping the threads, and their sleeping and waking
+	scond_t *condWake; //idle threads wait on this for more work
+	scond_t *condDone; //joins wait on this for their job to complete
+	int sleeping;
+	bool exiting;
+	volatile u32 generation; //changes whenever work is queued, so spinning threads notice it without the lock
+	size_t next; //the queue that work from outside the pool goes on next
+
+	int numThreads;
+	bool spin;
+	u64 affinity;
 };
 
-static void taskProc(void *arg)
+TaskPoolImpl::TaskPoolImpl()
+	: sleeping(0), exiting(false), generation(0), next(0)
+	, numThreads(0), spin(false), affinity(0)
+{
+	lock = slock_new();
+	condWake = scond_new();
+	condDone = scond_new();
+}
+
+//never freed, so that Tasks elsewhere can still be synched with while the program exits
+static TaskPoolImpl *pool = new TaskPoolImpl();
+
+void TaskPoolImpl::configure(int threads, bool spin, u64 affinity)
+{
+	shutdown();
+
+	slock_lock(this->lock);
+	this->numThreads = threads;
+	this->spin = spin;
+	this->affinity = affinity;
+	slock_unlock(this->lock);
+}
+
+//called with the lock held. the threads wait for the lock before they start taking work,
+//so they all get to see the whole of the worker list.
+void TaskPoolImpl::start()
+{
+	const size_t count = (this->numThreads > 0) ? this->numThreads : std::max(getOnlineCores(), 1);
+
+	this->exiting = false;
+	this->next = 0;
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Worker *worker = new Worker();
+		worker->pool = this;
+		worker->index = i;
+		worker->lock = slock_new();
+		this->workers.push_back(worker);
+	}
+
+	for (size_t i = 0; i < count; i++)
+		this->workers[i]->thread = sthread_create(&TaskPoolImpl::workerProc, this->workers[i]);
+}
+
+void TaskPoolImpl::shutdown()
+{
+	slock_lock(this->lock);
+
+	if (this->workers.empty())
+	{
+		slock_unlock(this->lock);
+		return;
+	}
+
+	this->exiting = true;
+	scond_broadcast(this->condWake);
+
+	slock_unlock(this->lock);
+
+	//the threads only leave once the queues are empty
+	for (size_t i = 0; i < this->workers.size(); i++)
+		sthread_join(this->workers[i]->thread);
+
+	slock_lock(this->lock);
+
+	for (size_t i = 0; i < this->workers.size(); i++)
+	{
+		slock_free(this->workers[i]->lock);
+		delete this->workers[i];
+	}
+	this->workers.clear();
+	this->exiting = false;
+
+	slock_unlock(this->lock);
+}
+
+size_t TaskPoolImpl::self()
 {
-	Task::Impl *ctx = (Task::Impl *)arg;
+	for (size_t i = 0; i < this->workers.size(); i++)
+		if (sthread_isself(this->workers[i]->thread))
+			return i;
 
-	do {
-		slock_lock(ctx->mutex);
+	return NONE;
+}
 
-		while (ctx->workFunc == NULL && !ctx->exitThread) {
-			scond_wait(ctx->condWork, ctx->mutex);
+//the newest work on the thread's own queue, or else the oldest work on someone else's
+TaskJob* TaskPoolImpl::take(size_t index)
+{
+	const size_t count = this->workers.size();
+
+	for (size_t i = 0; i < count; i++)
+	{
+		Worker *worker = this->workers[(index + i) % count];
+		TaskJob *job = NULL;
+
+		slock_lock(worker->lock);
+		if (!worker->jobs.empty())
+		{
+			if (i == 0)
+			{
+				job = worker->jobs.back();
+				worker->jobs.pop_back();
+			}
+			else
+			{
+				job = worker->jobs.front();
+				worker->jobs.pop_front();
+			}
 		}
+		slock_unlock(worker->lock);
+
+		if (job != NULL)
+			return job;
+	}
 
-		if (ctx->workFunc != NULL) {
-			ctx->ret = ctx->workFunc(ctx->workFuncParam);
-		} else {
-			ctx->ret = NULL;
+	return NULL;
+}
+
+//takes the job back off its queue, if nobody has taken it yet
+bool TaskPoolImpl::reclaim(TaskJob *job)
+{
+	Worker *worker = this->workers[job->queue];
+
+	slock_lock(worker->lock);
+	std::deque<TaskJob*>::iterator it = std::find(worker->jobs.begin(), worker->jobs.end(), job);
+	const bool found = (it != worker->jobs.end());
+	if (found)
+		worker->jobs.erase(it);
+	slock_unlock(worker->lock);
+
+	return found;
+}
+
+//called with the lock held
+bool TaskPoolImpl::anyQueued()
+{
+	for (size_t i = 0; i < this->workers.size(); i++)
+	{
+		slock_lock(this->workers[i]->lock);
+		const bool empty = this->workers[i]->jobs.empty();
+		slock_unlock(this->workers[i]->lock);
+
+		if (!empty)
+			return true;
+	}
+
+	return false;
+}
+
+void TaskPoolImpl::run(TaskJob *job)
+{
+	void *ret = job->work(job->param);
+
+	slock_lock(this->lock);
+	job->ret = ret;
+	job->done = true;
+	scond_broadcast(this->condDone);
+	slock_unlock(this->lock);
+}
+
+void TaskPoolImpl::waitDone(TaskJob *job, bool spin)
+{
+	if (spin || this->spin)
+	{
+		for (int i = 0; i < TASK_SPIN_COUNT && !job->done; i++) {}
+	}
+
+	//even when the spinning saw it, the lock is what makes the job's results visible here
+	slock_lock(this->lock);
+	while (!job->done)
+		scond_wait(this->condDone, this->lock);
+	slock_unlock(this->lock);
+}
+
+void TaskPoolImpl::submit(TaskJob *job)
+{
+	slock_lock(this->lock);
+
+	if (this->workers.empty())
+		start();
+
+	size_t index = self();
+	if (index == NONE)
+		index = this->next++ % this->workers.size();
+
+	job->ret = NULL;
+	job->done = false;
+	job->queue = index;
+
+	Worker *worker = this->workers[index];
+	slock_lock(worker->lock);
+	worker->jobs.push_back(job);
+	slock_unlock(worker->lock);
+
+	this->generation++;
+	if (this->sleeping > 0)
+		scond_signal(this->condWake);
+
+	slock_unlock(this->lock);
+}
+
+void* TaskPoolImpl::join(TaskJob *job, bool spin)
+{
+	if (reclaim(job))
+	{
+		run(job);
+		return job->ret;
+	}
+
+	//a pool thread keeps working through the queues while it waits, so that work which
+	//waits on other work can't end up with every thread asleep
+	const size_t index = self();
+	if (index != NONE)
+	{
+		while (!job->done)
+		{
+			TaskJob *other = take(index);
+			if (other == NULL)
+				break;
+			run(other);
 		}
+	}
+
+	waitDone(job, spin);
+	return job->ret;
+}
+
+void TaskPoolImpl::workerProc(void *arg)
+{
+	Worker *worker = (Worker *)arg;
+	TaskPoolImpl *pool = worker->pool;
 
-		ctx->workFunc = NULL;
-		scond_signal(ctx->condWork);
+	slock_lock(pool->lock);
+	const u64 affinity = pool->affinity;
+	slock_unlock(pool->lock);
 
-		slock_unlock(ctx->mutex);
+	if (affinity != 0)
+		setThreadAffinity(affinity);
 
-	} while(!ctx->exitThread);
+	for (;;)
+	{
+		TaskJob *job = pool->take(worker->index);
+		if (job != NULL)
+		{
+			pool->run(job);
+			continue;
+		}
+
+		if (pool->spin)
+		{
+			const u32 seen = pool->generation;
+			for (int i = 0; i < TASK_SPIN_COUNT && pool->generation == seen; i++) {}
+			if (pool->generation != seen)
+				continue;
+		}
+
+		slock_lock(pool->lock);
+
+		const bool idle = !pool->anyQueued();
+		if (idle && pool->exiting)
+		{
+			slock_unlock(pool->lock);
+			break;
+		}
+
+		if (idle)
+		{
+			pool->sleeping++;
+			scond_wait(pool->condWake, pool->lock);
+			pool->sleeping--;
+		}
+
+		slock_unlock(pool->lock);
+	}
 }
 
-Task::Impl::Impl()
+void TaskPool::configure(int threads, bool spin, u64 affinity) { pool->configure(threads, spin, affinity); }
+void TaskPool::shutdown() { pool->shutdown(); }
+
+struct TaskRange
+{
+	TaskJob job;
+	TaskPool::TRangeWork work;
+	void *param;
+	size_t index;
+};
+
+static void* runTaskRange(void *arg)
 {
-	_isThreadRunning = false;
-	workFunc = NULL;
-	workFuncParam = NULL;
-	ret = NULL;
-	exitThread = false;
+	TaskRange *range = (TaskRange *)arg;
+	range->work(range->param, range->index);
+	return NULL;
+}
 
+void TaskPool::parallelFor(size_t count, TRangeWork work, void *param)
+{
+	if (count == 0)
+		return;
+
+	//the calling thread does the first one itself
+	std::vector<TaskRange> ranges(count);
+	for (size_t i = 1; i < count; i++)
+	{
+		ranges[i].job.work = &runTaskRange;
+		ranges[i].job.param = &ranges[i];
+		ranges[i].work = work;
+		ranges[i].param = param;
+		ranges[i].index = i;
+		pool->submit(&ranges[i].job);
+	}
+
+	work(param, 0);
+
+	for (size_t i = 1; i < count; i++)
+		pool->join(&ranges[i].job, false);
+}
+
+class Task::Impl {
+public:
+	Impl();
+	~Impl();
+
+	void start(bool spinlock);
+	void execute(const TWork &work, void *param);
+	void* finish();
+	void shutdown();
+
+	slock_t *mutex;
+	TaskJob job;
+	bool isRunning; //between start() and shutdown()
+	bool isPending; //work has been handed to the pool and not synched with yet
+	bool spinlock;
+};
+
+Task::Impl::Impl()
+{
 	mutex = slock_new();
-	condWork = scond_new();
+	job.work = NULL;
+	job.param = NULL;
+	job.ret = NULL;
+	job.done = true;
+	job.queue = 0;
+	isRunning = false;
+	isPending = false;
+	spinlock = false;
 }
 
 Task::Impl::~Impl()
 {
 	shutdown();
 	slock_free(mutex);
-	scond_free(condWork);
 }
 
 void Task::Impl::start(bool spinlock)
 {
 	slock_lock(this->mutex);
 
-	if (this->_isThreadRunning) {
-		slock_unlock(this->mutex);
-		return;
+	if (!this->isRunning)
+	{
+		this->spinlock = spinlock;
+		this->isRunning = true;
 	}
 
-	this->workFunc = NULL;
-	this->workFuncParam = NULL;
-	this->ret = NULL;
-	this->exitThread = false;
-	this->_thread = sthread_create(&taskProc,this);
-	this->_isThreadRunning = true;
-
 	slock_unlock(this->mutex);
 }
 
@@ -140,37 +506,33 @@ void Task::Impl::execute(const TWork &work, void *param)
 {
 	slock_lock(this->mutex);
 
-	if ((work == NULL) || (this->workFunc != NULL) || !this->_isThreadRunning)
+	if ((work == NULL) || this->isPending || !this->isRunning)
 	{
 		slock_unlock(this->mutex);
 		return;
 	}
 
-	this->workFunc = work;
-	this->workFuncParam = param;
-	scond_signal(this->condWork);
+	this->job.work = work;
+	this->job.param = param;
+	this->isPending = true;
+	pool->submit(&this->job);
 
 	slock_unlock(this->mutex);
 }
 
 void* Task::Impl::finish()
 {
-	void *returnValue = NULL;
-
 	slock_lock(this->mutex);
+	const bool pending = this->isPending;
+	slock_unlock(this->mutex);
 
-	if ((this->workFunc == NULL) || !this->_isThreadRunning) {
-		slock_unlock(this->mutex);
-		return returnValue;
-	}
-
-	while (this->workFunc != NULL)
-	{
-		scond_wait(this->condWork, this->mutex);
-	}
+	if (!pending)
+		return NULL;
 
-	returnValue = this->ret;
+	void *returnValue = pool->join(&this->job, this->spinlock);
 
+	slock_lock(this->mutex);
+	this->isPending = false;
 	slock_unlock(this->mutex);
 
 	return returnValue;
@@ -178,23 +540,10 @@ void* Task::Impl::finish()
 
 void Task::Impl::shutdown()
 {
-	slock_lock(this->mutex);
-
-	if (!this->_isThreadRunning) {
-		slock_unlock(this->mutex);
-		return;
-	}
-
-	this->workFunc = NULL;
-	this->exitThread = true;
-	scond_signal(this->condWork);
-
-	slock_unlock(this->mutex);
-
-	sthread_join(this->_thread);
+	finish();
 
 	slock_lock(this->mutex);
-	this->_isThreadRunning = false;
+	this->isRunning = false;
 	slock_unlock(this->mutex);
 }
 
@@ -205,4 +554,3 @@ Task::~Task() { delete impl; }
 void Task::execute(const TWork &work, void* param) { impl->execute(work,param); }
 void* Task::finish() { return impl->finish(); }
 
-
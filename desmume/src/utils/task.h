@@ -18,17 +18,23 @@
 #ifndef _TASK_H_
 #define _TASK_H_
 
-//Sort of like a single-thread thread pool.
-//You hand it a worker function and then call finish() to synch with its completion
+#include <stddef.h>
+
+#include "types.h"
+
+//One piece of work at a time on the shared task pool (fork and join).
+//You hand it a worker function and then call finish() to synch with its completion.
+//A Task doesn't own a thread; if no pool thread has picked the work up by the time
+//finish() is called, the work is run right there instead.
 class Task
 {
 public:
 	Task();
 	~Task();
-	
+
 	typedef void * (*TWork)(void *);
 
-	// initialize task runner
+	// initialize task runner. with spinlock, finish() spins for a while before going to sleep
 	void start(bool spinlock);
 
 	//execute some work
@@ -45,6 +51,23 @@ public:
 
 };
 
+//The threads that all Tasks run on. Each thread has its own queue of work and takes
+//work from the others' queues when it runs out.
+namespace TaskPool
+{
+	//sets up the pool with this many threads (<= 0: one per online core). with spin, idle threads
+	//spin for a while before going to sleep. affinity is a mask of the cores the threads may run on,
+	//or 0 for any. if the pool is already running, it's stopped first, so nothing may be using it then.
+	void configure(int threads, bool spin, u64 affinity);
+
+	//waits for the queued work to be done and stops the threads. the pool starts again when it's next used.
+	void shutdown();
+
+	//runs work(param, i) for every i in [0, count) across the pool, and returns once they're all done
+	typedef void (*TRangeWork)(void *param, size_t index);
+	void parallelFor(size_t count, TRangeWork work, void *param);
+}
+
 int getOnlineCores (void);
 
 #endif
@@ -85,7 +85,10 @@
 	#define DESMUME_CPUEXT_PRIMARY_STRING " AltiVec"
 #endif
 
-#if defined(ENABLE_AVX2)
+#if defined(ENABLE_AVX512_1)
+	#undef DESMUME_CPUEXT_SECONDARY_STRING
+	#define DESMUME_CPUEXT_SECONDARY_STRING "+AVX-512"
+#elif defined(ENABLE_AVX2)
 	#undef DESMUME_CPUEXT_SECONDARY_STRING
 	#define DESMUME_CPUEXT_SECONDARY_STRING "+AVX2"
 #elif defined(ENABLE_AVX)
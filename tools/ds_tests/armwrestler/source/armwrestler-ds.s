@@ -1200,6 +1200,25 @@ Test2:
 	cmp 	r0,#0x80
 	orrne 	r1,r1,#BAD_Rd
 
+	@ The carry is only used by the address here. Loop so that a
+	@ recompiler sees this often, and check the written back address.
+	ldr 	r3,=0xfffffffc
+	mov 	r5,#0x200
+ldr_rrx_loop:
+	ldr 	r2,=romvar
+	add 	r2,r2,#2
+	adds 	r4,r2,#0		@ clear carry
+	orrcs 	r1,r1,#1
+	adds 	r4,r3,r3		@ set carry
+	ldr 	r0,[r2,r3, rrx]!
+	cmp 	r0,#0x80
+	orrne 	r1,r1,#BAD_Rd
+	ldr 	r4,=romvar
+	cmp 	r2,r4
+	orrne 	r1,r1,#BAD_Rn
+	subs 	r5,r5,#1
+	bne 	ldr_rrx_loop
+
 	@ Test non word-aligned load
 	ldr 	r0,=romvar2
 	mov 	r2,#2